@@ -31,10 +31,8 @@ int main(int argc, char *argv[]) {
   struct dicm_key key;
   int done = 0;
   /* value */
-  char buf[4096];
   uint32_t size;
   int res;
-  const size_t buflen = sizeof buf;
   struct dicm_src *src;
   FILE *stream = NULL;
 
@@ -81,14 +79,9 @@ int main(int argc, char *argv[]) {
     case DICM_VALUE_EVENT:
       res = dicm_parser_get_size(parser, &size);
       assert(res == 0);
-      /* do/while loop trigger at least one event (even in the case where
-       * value_length is exactly 0) */
-      do {
-        const size_t len = size < buflen ? size : buflen;
-        res = dicm_parser_read_bytes(parser, buf, len);
-        assert(res == 0);
-        size -= len;
-      } while (size != 0);
+      /* value is not used, move past it */
+      res = dicm_parser_skip_value(parser);
+      assert(res == 0);
       break;
     }
 
@@ -141,6 +141,54 @@ dicm_src_stream_create(struct dicm_src **pself, void *data,
                        int64_t (*fp_seek)(struct dicm_src *, int64_t, int))
     DICM_NONNULL(1, 2, 3);
 
+/** Access pattern hints for file descriptor backed sources. */
+enum dicm_advice_type {
+  /** No particular access pattern */
+  DICM_ADVICE_NORMAL = 0,
+  /** Data will be accessed sequentially (header scan) */
+  DICM_ADVICE_SEQUENTIAL,
+  /** Data will be accessed in the near future (prefetch) */
+  DICM_ADVICE_WILLNEED,
+};
+
+/* memory-mapped file descriptor, the descriptor must refer to a regular file
+ * opened for reading. The mapping does not take ownership of fd, which may be
+ * closed once the source has been created. */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_src_mmap_create(struct dicm_src **pself, int fd, int advice)
+    DICM_NONNULL();
+
+/* file descriptor read with pread(2) starting at offset, the descriptor must
+ * refer to a regular file or a block device. The source keeps its own
+ * position and never moves the file position of fd, several sources may
+ * read the same descriptor from different threads. Positions of seeks are
+ * relative to the start of the file. The source does not take ownership of
+ * fd. */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_src_fd_create(struct dicm_src **pself, int fd, int64_t offset,
+                   int advice) DICM_NONNULL();
+
+/* file descriptor read ahead with io_uring (Linux): `depth` reads of
+ * `block_size` bytes are kept in flight ahead of the current position, use 0
+ * for the defaults. Falls back to dicm_src_fd_create() when io_uring is not
+ * available. Same requirements on fd as dicm_src_fd_create(), the source
+ * does not take ownership of fd. */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_src_uring_create(struct dicm_src **pself, int fd, int64_t offset,
+                      unsigned depth, size_t block_size) DICM_NONNULL();
+
+/* read-ahead buffer on top of any source: small reads (keys, value lengths)
+ * are decoded from a window of `size` bytes filled in one go, large reads
+ * bypass the window. Use 0 for the default window size. The buffered source
+ * does not take ownership of src. */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_src_buffered_create(struct dicm_src **pself, struct dicm_src *src,
+                         size_t size) DICM_NONNULL();
+
 struct dicm_dst_vtable;
 struct dicm_dst {
   struct dicm_dst_vtable const *vtable;
@@ -157,6 +205,25 @@ DICM_CHECK_RETURN
 DICM_DECLARE(int)
 dicm_dst_file_create(struct dicm_dst **pself, FILE *stream) DICM_NONNULL();
 
+/* file descriptor written with pwrite(2) starting at offset, see
+ * dicm_src_fd_create(). Values are sent along with their header in a single
+ * pwritev(2) call. The destination does not take ownership of fd. */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_dst_fd_create(struct dicm_dst **pself, int fd, int64_t offset)
+    DICM_NONNULL();
+
+/* file descriptor written asynchronously with io_uring (Linux): writes are
+ * gathered in blocks of `block_size` bytes, up to `depth` blocks are in
+ * flight, use 0 for the defaults. A write only waits when no block is free.
+ * Seeks and dicm_delete() wait for all blocks, dicm_delete() reports a
+ * failed write. Falls back to dicm_dst_fd_create() when io_uring is not
+ * available. The destination does not take ownership of fd. */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_dst_uring_create(struct dicm_dst **pself, int fd, int64_t offset,
+                      unsigned depth, size_t block_size) DICM_NONNULL();
+
 /* buffer - simple contiguous buffer*/
 DICM_CHECK_RETURN
 DICM_DECLARE(int)
@@ -173,6 +240,17 @@ dicm_dst_stream_create(struct dicm_dst **pself, void *data,
                        int64_t (*fp_seek)(struct dicm_dst *, int64_t, int))
     DICM_NONNULL(1, 2, 3);
 
+/* write-combining buffer on top of any destination: small writes (keys,
+ * value lengths, short values) are merged into blocks of `size` bytes, large
+ * writes bypass the buffer. Use 0 for the default buffer size. Pending bytes
+ * are written on seek and when the object is deleted, dicm_delete() then
+ * reports a failure. The buffered destination does not take ownership of
+ * dst. */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_dst_buffered_create(struct dicm_dst **pself, struct dicm_dst *dst,
+                         size_t size) DICM_NONNULL();
+
 /** @} */
 
 /**
@@ -184,6 +262,10 @@ dicm_dst_stream_create(struct dicm_dst **pself, void *data,
 enum dicm_event_type {
   /* negative value are reserved for errors */
 
+  /** Push mode only: the input ends before the event, feed more bytes and
+   * call again. */
+  DICM_NEED_MORE_DATA = -2,
+
   /** A DOCUMENT-START event. */
   DICM_DOCUMENT_START_EVENT = 0,
   /** A DOCUMENT-END event. */
@@ -208,6 +290,8 @@ enum dicm_event_type {
 };
 
 struct dicm_parser;
+struct dicm_index;
+struct dicm_private_dict;
 
 /** Structure types. */
 enum dicm_structure_type {
@@ -219,6 +303,8 @@ enum dicm_structure_type {
   DICM_STRUCTURE_EXPLICIT_LE, /* aka EVRLE */
   /** Explicit VR Big Endian */
   DICM_STRUCTURE_EXPLICIT_BE, /* aka EVRBE */
+  /** DICOM File: preamble, File Meta Information then data set */
+  DICM_STRUCTURE_PART10, /* Transfer Syntax read from (0002,0010) */
 };
 
 struct dicm_key {
@@ -240,11 +326,253 @@ DICM_CHECK_RETURN
 DICM_DECLARE(int)
 dicm_parser_create(struct dicm_parser **pself) DICM_NONNULL();
 
+/**
+ * Set the input of a parser
+ *
+ * With DICM_STRUCTURE_PART10 the 128-byte preamble and the "DICM" prefix are
+ * consumed, then the File Meta Information is read in one go (bounded by its
+ * Group Length). Its elements are reported as regular root level events, and
+ * the data set that follows is parsed according to the Transfer Syntax UID.
+ * Deflated transfer syntaxes and private (non-standard) Transfer Syntax UIDs
+ * are rejected.
+ *
+ * @param[in]       self    A parser object.
+ * @param[in]       structure_type  One of dicm_structure_type.
+ * @param[in]       src     Input source, not owned by the parser.
+ *
+ * @returns @c 0 if the function succeeded, @c -1 on error.
+ */
 DICM_CHECK_RETURN
 DICM_DECLARE(int)
 dicm_parser_set_input(struct dicm_parser *self, int structure_type,
                       struct dicm_src *src) DICM_NONNULL();
 
+/**
+ * Set the input of a parser, specialized for one structure
+ *
+ * Same as dicm_parser_set_input() with respectively
+ * DICM_STRUCTURE_ENCAPSULATED, DICM_STRUCTURE_IMPLICIT,
+ * DICM_STRUCTURE_EXPLICIT_LE and DICM_STRUCTURE_EXPLICIT_BE, except that the
+ * keys are then read with direct calls instead of going through the generic
+ * level parser interface. Meant for scanning large numbers of data sets.
+ *
+ * @param[in]       self    A parser object.
+ * @param[in]       src     Input source, not owned by the parser.
+ *
+ * @returns @c 0 if the function succeeded, @c -1 on error (including when the
+ * structure was disabled at build time).
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_parser_set_input_encap_fast(struct dicm_parser *self, struct dicm_src *src)
+    DICM_NONNULL();
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_parser_set_input_ivrle_fast(struct dicm_parser *self, struct dicm_src *src)
+    DICM_NONNULL();
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_parser_set_input_evrle_fast(struct dicm_parser *self, struct dicm_src *src)
+    DICM_NONNULL();
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_parser_set_input_evrbe_fast(struct dicm_parser *self, struct dicm_src *src)
+    DICM_NONNULL();
+
+/**
+ * Set a push input
+ *
+ * Instead of being read from a dicm_src, the input is fed in chunks of any
+ * size with dicm_parser_feed(), so that a parser can be driven from an event
+ * loop. When the bytes fed so far end in the middle of a key or of a value,
+ * dicm_parser_next_event(), dicm_parser_read_bytes(),
+ * dicm_parser_borrow_bytes(), dicm_parser_skip_value() and
+ * dicm_parser_skip_sequence() return DICM_NEED_MORE_DATA and leave the parser
+ * unchanged (the last two discard what is available), the call is then
+ * repeated after the next dicm_parser_feed(). Frame access
+ * (dicm_parser_seek_frame()) requires the fragments to be fed already.
+ *
+ * @param[in]       self    A parser object.
+ * @param[in]       structure_type  One of dicm_structure_type.
+ *
+ * @returns @c 0 if the function succeeded, @c -1 on error.
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_parser_set_push_input(struct dicm_parser *self, int structure_type)
+    DICM_NONNULL();
+
+/**
+ * Feed bytes to a push input
+ *
+ * The bytes are copied. Pointers returned by dicm_parser_borrow_bytes() are
+ * valid until the next call.
+ *
+ * @param[in]       self    A parser object, see dicm_parser_set_push_input().
+ * @param[in]       ptr     Next bytes of the input.
+ * @param[in]       len     Number of bytes, @c 0 marks the end of the input.
+ *
+ * @returns @c 0 if the function succeeded, @c -1 on error.
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_parser_feed(struct dicm_parser *self, const void *ptr, size_t len)
+    DICM_NONNULL(1);
+
+/**
+ * Stop parsing after a given tag
+ *
+ * Data elements are stored in ascending tag order, so once a root level key
+ * greater than @p tag is read the document is ended early
+ * (DICM_DOCUMENT_END_EVENT) and the remaining bytes are never read. Use
+ * @c 0xffffffff to parse the whole document (default).
+ *
+ * @param[in]       self    A parser object.
+ * @param[in]       tag     Last tag of interest, e.g. @c 0x7fe00010.
+ *
+ * @returns @c 0 if the function succeeded, @c -1 on error.
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_parser_set_max_tag(struct dicm_parser *self, uint32_t tag) DICM_NONNULL();
+
+/**
+ * Restrict parsing to a set of root level tags
+ *
+ * Root level data elements not in @p tags are skipped without being reported,
+ * as long as they have a defined length and are not a sequence. The document
+ * is ended early once the last wanted tag has been passed. The array is not
+ * copied and must outlive the parser use. Use a @p count of @c 0 to reset.
+ *
+ * @param[in]       self    A parser object.
+ * @param[in]       tags    Array of tags sorted in strictly ascending order.
+ * @param[in]       count   Number of tags.
+ *
+ * @returns @c 0 if the function succeeded, @c -1 if @p tags is not sorted.
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_parser_set_wanted_tags(struct dicm_parser *self, const uint32_t *tags,
+                            size_t count) DICM_NONNULL(1);
+
+/**
+ * Skip a whole defined length sequence
+ *
+ * Must be called right after DICM_SEQUENCE_START_EVENT. The content of the
+ * sequence is skipped with a single seek (or discarded on a non-seekable
+ * source) and the next event is DICM_SEQUENCE_END_EVENT. Sequences of
+ * undefined length cannot be skipped without parsing them. In push mode, the
+ * call is repeated after each dicm_parser_feed() until the end of the
+ * sequence has been fed.
+ *
+ * @param[in]       self    A parser object.
+ *
+ * @returns @c 0 if the function succeeded, DICM_NEED_MORE_DATA in push mode,
+ * @c -1 on error or if the sequence has an undefined length.
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_parser_skip_sequence(struct dicm_parser *self) DICM_NONNULL();
+
+/**
+ * Record the offsets of data elements while parsing
+ *
+ * Every reported data element, at any nesting level, is recorded in @p index
+ * keyed by its tag path. Offsets are relative to the position of the source
+ * when dicm_parser_set_input() was called (absolute for a Part 10 file read
+ * from its beginning). The index is cleared by dicm_parser_set_input(), and
+ * is not owned by the parser. Use @c NULL to stop recording. An index opened
+ * with dicm_index_load() becomes writable again once cleared.
+ *
+ * @param[in]       self    A parser object.
+ * @param[in]       index   An index object or @c NULL.
+ *
+ * @returns @c 0 if the function succeeded, @c -1 on error.
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_parser_set_index(struct dicm_parser *self, struct dicm_index *index)
+    DICM_NONNULL(1);
+
+/**
+ * Resolve private data elements with a private dictionary
+ *
+ * Private creator values are recorded as they are read or skipped, per group
+ * and per item. Private data elements of an implicit VR structure then report
+ * the VR found in @p dict for their creator, a private sequence of defined
+ * length is reported as a sequence. The dictionary is not owned by the
+ * parser. Use @c NULL to stop resolving.
+ *
+ * @param[in]       self    A parser object.
+ * @param[in]       dict    A private dictionary object or @c NULL.
+ *
+ * @returns @c 0 if the function succeeded, @c -1 on error.
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_parser_set_private_dict(struct dicm_parser *self,
+                             struct dicm_private_dict *dict) DICM_NONNULL(1);
+
+/**
+ * Number of frames of the current encapsulated Pixel Data
+ *
+ * Must be called right after the DICM_SEQUENCE_START_EVENT of an
+ * encapsulated Pixel Data, or later between its fragments. The first call
+ * consumes the Basic Offset Table. When the Basic Offset Table is empty the
+ * root level Extended Offset Table (7FE0,0001) is read back instead. Without
+ * any offset table, frames are recovered from the fragments starting with a
+ * JPEG, JPEG-LS or JPEG 2000 codestream. Both fallbacks require a seekable
+ * source.
+ *
+ * @param[in]       self    A parser object.
+ * @param[out]      count   Number of frames.
+ *
+ * @returns @c 0 if the function succeeded, @c -1 when frames cannot be
+ * located.
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_parser_get_frame_count(struct dicm_parser *self, uint32_t *count)
+    DICM_NONNULL();
+
+/**
+ * Jump to the first fragment of a frame
+ *
+ * Same calling conditions as dicm_parser_get_frame_count(). The fragments
+ * in between are skipped with a single seek (or discarded on a non-seekable
+ * source), and the next event is the DICM_FRAGMENT_EVENT of the first
+ * fragment of @p frame. Seeking backward requires a seekable source.
+ *
+ * @param[in]       self    A parser object.
+ * @param[in]       frame   Zero-based frame number.
+ *
+ * @returns @c 0 if the function succeeded, @c -1 on error.
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_parser_seek_frame(struct dicm_parser *self, uint32_t frame)
+    DICM_NONNULL();
+
+/**
+ * Copy the frame offsets of the current encapsulated Pixel Data
+ *
+ * Same calling conditions as dicm_parser_get_frame_count(). Offsets are
+ * relative to the first fragment following the Basic Offset Table, as in a
+ * Basic or Extended Offset Table, so that a recovered table can be cached
+ * and stored along with the file.
+ *
+ * @param[in]       self    A parser object.
+ * @param[out]      offsets Array of at least @p count elements.
+ * @param[in]       count   Number of frames, as reported by
+ *                          dicm_parser_get_frame_count().
+ *
+ * @returns @c 0 if the function succeeded, @c -1 on error.
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_parser_get_frame_offsets(struct dicm_parser *self, uint64_t *offsets,
+                              uint32_t count) DICM_NONNULL();
+
 DICM_CHECK_RETURN
 DICM_DECLARE(int)
 dicm_parser_next_event(struct dicm_parser *self) DICM_NONNULL();
@@ -263,6 +591,151 @@ DICM_DECLARE(int)
 dicm_parser_read_bytes(struct dicm_parser *self, void *ptr, size_t len)
     DICM_NONNULL();
 
+/**
+ * Read values in host byte order
+ *
+ * When enabled, numbers of binary VRs (AT, FL, FD, OD, OF, OL, OV, OW, SL,
+ * SS, SV, UL, US, UV) returned by dicm_parser_read_bytes() are converted to
+ * the host byte order, typically for Explicit VR Big Endian on a little
+ * endian host. A value may be read in several calls of any length, a number
+ * split by the end of a call is completed by the next one. In the middle of
+ * such a number, dicm_parser_borrow_bytes() fails while
+ * dicm_parser_skip_value() is fine. Other values, fragments and
+ * dicm_parser_borrow_bytes() are not converted. Disabled by default.
+ *
+ * @param[in]       self    A parser object.
+ * @param[in]       enable  Non-zero to convert values.
+ *
+ * @returns @c 0 if the function succeeded, @c -1 on error.
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_parser_set_host_byte_order(struct dicm_parser *self, int enable)
+    DICM_NONNULL();
+
+/**
+ * Borrow value bytes without copying
+ *
+ * Same as dicm_parser_read_bytes() but instead of copying, @p pptr is set to
+ * point directly into the source memory (memory and memory-mapped sources).
+ * For other sources the bytes are read into an internal buffer. The returned
+ * pointer has no alignment guarantee and is only valid until the next call on
+ * the parser (or for the lifetime of the underlying buffer for contiguous
+ * sources).
+ *
+ * @param[in]       self    A parser object.
+ * @param[out]      pptr    Pointer to the borrowed bytes.
+ * @param[in]       len     Maximum number of bytes to consume.
+ *
+ * @returns @c 0 if the function succeeded, @c -1 on error.
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_parser_borrow_bytes(struct dicm_parser *self, const void **pptr,
+                         size_t len) DICM_NONNULL();
+
+/**
+ * Skip the remaining bytes of the current value
+ *
+ * The value is skipped using a single seek when the source is seekable,
+ * otherwise the bytes are discarded (without copy for contiguous sources).
+ * Since a seek past the end of a file does not fail, a value truncated by the
+ * end of a seekable source is not detected by this function.
+ *
+ * @param[in]       self    A parser object.
+ *
+ * @returns @c 0 if the function succeeded, @c -1 on error.
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_parser_skip_value(struct dicm_parser *self) DICM_NONNULL();
+
+/**
+ * Callbacks of dicm_parser_run()
+ *
+ * Any callback may be NULL. A callback returns @c 0 to continue, any other
+ * value stops dicm_parser_run() which then returns it.
+ */
+struct dicm_handlers {
+  int (*fp_document_start)(void *ctx);
+  int (*fp_document_end)(void *ctx);
+  /** @p size is the value length, undefined length is @c 0xffffffff */
+  int (*fp_key)(void *ctx, const struct dicm_key *key, uint32_t size);
+  int (*fp_fragment)(void *ctx, uint32_t size);
+  /** A value is delivered in one or more chunks, @p remaining is the number
+   * of bytes left after this chunk. Values are skipped when NULL. */
+  int (*fp_value)(void *ctx, const void *ptr, size_t len, uint32_t remaining);
+  int (*fp_item_start)(void *ctx);
+  int (*fp_item_end)(void *ctx);
+  int (*fp_sequence_start)(void *ctx);
+  int (*fp_sequence_end)(void *ctx);
+};
+
+/**
+ * Parse the document, invoking callbacks
+ *
+ * Drives the parser up to the DICM_DOCUMENT_END_EVENT. Values are borrowed
+ * in one chunk from contiguous sources, and in chunks of the internal buffer
+ * size from other sources. May be called after dicm_parser_next_event() to
+ * process the rest of the document. In push mode a DICM_NEED_MORE_DATA is
+ * returned as is, and the parse resumes (in the middle of a value if needed)
+ * on the next call.
+ *
+ * @param[in]       self      A parser object.
+ * @param[in]       handlers  Callbacks.
+ * @param[in]       ctx       Passed to all callbacks.
+ *
+ * @returns @c 0 at the end of the document, the value returned by a callback
+ * that stopped the parse, DICM_NEED_MORE_DATA, or @c -1 on error.
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_parser_run(struct dicm_parser *self, const struct dicm_handlers *handlers,
+                void *ctx) DICM_NONNULL(1, 2);
+
+/** Compact event record, see dicm_parser_next_events() */
+struct dicm_event {
+  /** One of dicm_event_type */
+  int32_t type;
+  /** Key of KEY, VALUE and SEQUENCE-START/END events, item or fragment tag
+   * for ITEM-START and FRAGMENT events, otherwise @c 0 */
+  uint32_t tag;
+  uint32_t vr;
+  /** Value length, @c 0xffffffff when undefined */
+  uint32_t vl;
+  /** Number of enclosing sequences */
+  uint32_t depth;
+  /** Absolute input position of the value for KEY, FRAGMENT and VALUE
+   * events, input position after the event otherwise */
+  uint64_t offset;
+  /** VALUE events only: the value bytes when at most @c inline_max bytes,
+   * otherwise @c NULL (the value was skipped) */
+  const void *value;
+};
+
+/**
+ * Fill an array of events
+ *
+ * Same as calling dicm_parser_next_event() up to @p count times, stopping
+ * after a DICM_DOCUMENT_END_EVENT. Values are consumed by this call: small
+ * values are borrowed from memory and memory-mapped sources, or copied into
+ * an internal buffer valid until the next call for other sources, larger
+ * ones are skipped and can be read later at their offset. Not available in
+ * push mode.
+ *
+ * @param[in]       self       A parser object.
+ * @param[out]      events     Array of at least @p count elements.
+ * @param[in]       count      Maximum number of events.
+ * @param[in]       inline_max Largest value reported with its bytes.
+ *
+ * @returns the number of events, @c 0 once the document has ended, or @c -1
+ * on error.
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_parser_next_events(struct dicm_parser *self, struct dicm_event *events,
+                        size_t count, uint32_t inline_max) DICM_NONNULL();
+
 /** @} */
 
 /**
@@ -301,6 +774,262 @@ dicm_emitter_write_bytes(struct dicm_emitter *self, const void *buf, size_t len)
 
 /** @} */
 
+/**
+ * @defgroup index Offset index
+ * @{
+ */
+
+/* location of a data element */
+struct dicm_index_entry {
+  /** offset of the key */
+  uint64_t key_offset;
+  /** offset of the value (first item for a sequence) */
+  uint64_t value_offset;
+  /** value length, may be undefined for a sequence or Pixel Data */
+  uint32_t vl;
+  uint32_t vr;
+};
+
+/**
+ * Create an offset index
+ *
+ * An application is responsible for destroying the object using the
+ * dicm_delete() function.
+ *
+ * @param[out]      pself   An empty index object.
+ *
+ * @returns @c 0 if the function succeeded, @c -1 on error.
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_index_create(struct dicm_index **pself) DICM_NONNULL();
+
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_index_get_count(const struct dicm_index *self, size_t *count)
+    DICM_NONNULL();
+
+/**
+ * Look up a data element by tag path
+ *
+ * A tag path alternates tags and zero-based item numbers, and ends with the
+ * tag of the data element. For example @c {0x00081140,1,0x00081155} is
+ * Referenced SOP Instance UID in the second item of Referenced Image
+ * Sequence, @c {0x00100010} is Patient's Name at root level.
+ *
+ * @param[in]       self    An index object.
+ * @param[in]       path    Tag path.
+ * @param[in]       len     Number of elements in @p path.
+ * @param[out]      entry   Location of the data element.
+ *
+ * @returns @c 0 if the function succeeded, @c -1 if not found.
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_index_find(const struct dicm_index *self, const uint32_t *path,
+                size_t len, struct dicm_index_entry *entry) DICM_NONNULL();
+
+/**
+ * Write an index as a sidecar image
+ *
+ * The image is versioned and checksummed, and uses the host byte order so
+ * that it can later be memory-mapped and used in place with
+ * dicm_index_load(). It carries the identity of the indexed source when
+ * dicm_index_set_source() was called.
+ *
+ * @param[in]       self    An index object.
+ * @param[in]       dst     Output destination.
+ *
+ * @returns @c 0 if the function succeeded, @c -1 on error.
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_index_write(const struct dicm_index *self, struct dicm_dst *dst)
+    DICM_NONNULL();
+
+/**
+ * Open a sidecar image in place
+ *
+ * The image is not copied: @p ptr (typically a read-only memory mapping of
+ * the sidecar file) must be 8-byte aligned and outlive the index. Opening
+ * only checks the header, so that it costs a page fault regardless of the
+ * image size. Pass a non-zero @p verify to also check the checksum and
+ * every entry, which is required for an image that is not trusted.
+ *
+ * A valid image may still describe another version of the file: offsets are
+ * only meaningful for the source it was built from. Call
+ * dicm_index_check_source() with the file before using the index, a sidecar
+ * written without a source identity is then rejected as well.
+ *
+ * @param[out]      pself   A read-only index object.
+ * @param[in]       ptr     Sidecar image.
+ * @param[in]       size    Size of the image in bytes.
+ * @param[in]       verify  Verify checksum and entries.
+ *
+ * @returns @c 0 if the function succeeded, @c -1 if the image is invalid.
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_index_load(struct dicm_index **pself, const void *ptr, size_t size,
+                int verify) DICM_NONNULL();
+
+/**
+ * Record the identity of the indexed source
+ *
+ * The identity is the size of @p src and a checksum of its first and last 4
+ * KiB, it is written along with the index by dicm_index_write(). The source
+ * must be seekable, its position is restored. The identity is forgotten when
+ * the index is cleared (see dicm_parser_set_index()).
+ *
+ * @param[in]       self    An index object.
+ * @param[in]       src     Indexed source, typically once parsed.
+ *
+ * @returns @c 0 if the function succeeded, @c -1 on error.
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_index_set_source(struct dicm_index *self, struct dicm_src *src)
+    DICM_NONNULL();
+
+/**
+ * Check that an index was built from a source
+ *
+ * Compares the identity recorded by dicm_index_set_source() (or loaded from a
+ * sidecar image) with the one of @p src, so that a stale sidecar is not used
+ * after the file was modified or replaced. The source must be seekable, its
+ * position is restored.
+ *
+ * @param[in]       self    An index object.
+ * @param[in]       src     Source about to be accessed through the index.
+ *
+ * @returns @c 0 if the identities match, @c -1 if they do not, if the index
+ * has no identity or on error.
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_index_check_source(const struct dicm_index *self, struct dicm_src *src)
+    DICM_NONNULL();
+
+/** @} */
+
+/**
+ * @defgroup dictionary Data dictionary
+ * @{
+ */
+
+/* public attribute of the data dictionary */
+struct dicm_dict_entry {
+  uint32_t tag;
+  /** VR used in Implicit VR Little Endian: when the standard lists several,
+   * OW for "OB or OW" and "US or OW", US for "US or SS" */
+  uint32_t vr;
+  /** value multiplicity, e.g. @c "1-n" */
+  const char *vm;
+  const char *keyword;
+};
+
+/**
+ * Find an attribute by tag
+ *
+ * Lookup is done in constant time in a table generated at build time from
+ * PS3.6 (Tables 6-1, 7-1 and 8-1) and the PS3.7 command fields, retired
+ * attributes included. Repeating groups, group lengths other than the command
+ * and file meta ones, and private attributes are not part of the dictionary.
+ *
+ * @param[in]       tag     Attribute tag, e.g. @c 0x00100010.
+ * @param[out]      entry   Dictionary entry.
+ *
+ * @returns @c 0 if the function succeeded, @c -1 if not found.
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_dict_find_tag(uint32_t tag, struct dicm_dict_entry *entry) DICM_NONNULL();
+
+/**
+ * Find an attribute by keyword
+ *
+ * @param[in]       keyword Attribute keyword, e.g. @c "PatientName".
+ * @param[out]      entry   Dictionary entry.
+ *
+ * @returns @c 0 if the function succeeded, @c -1 if not found.
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_dict_find_keyword(const char *keyword, struct dicm_dict_entry *entry)
+    DICM_NONNULL();
+
+/**
+ * Create a private dictionary
+ *
+ * An application is responsible for destroying the object using the
+ * dicm_delete() function.
+ *
+ * @param[out]      pself   An empty private dictionary object.
+ *
+ * @returns @c 0 if the function succeeded, @c -1 on error.
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_private_dict_create(struct dicm_private_dict **pself) DICM_NONNULL();
+
+/**
+ * Add a private attribute
+ *
+ * The block byte of @p tag is ignored: @c 0x00291008 stands for (0029,xx08)
+ * in whatever block @p creator reserved. Padding of @p creator is ignored.
+ *
+ * @param[in]       self    A private dictionary object.
+ * @param[in]       creator Private creator, e.g. @c "SIEMENS CSA HEADER".
+ * @param[in]       tag     Private tag.
+ * @param[in]       vr      VR of the attribute, e.g. @c "US".
+ *
+ * @returns @c 0 if the function succeeded, @c -1 on error (duplicate
+ * attribute, invalid tag or VR, dictionary opened with
+ * dicm_private_dict_load()).
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_private_dict_add(struct dicm_private_dict *self, const char *creator,
+                      uint32_t tag, const char *vr) DICM_NONNULL();
+
+/**
+ * Write a private dictionary as a binary image
+ *
+ * The image holds the hash tables used for lookups and uses the host byte
+ * order, so that it can later be memory-mapped and used in place with
+ * dicm_private_dict_load().
+ *
+ * @param[in]       self    A private dictionary object.
+ * @param[in]       dst     Output destination.
+ *
+ * @returns @c 0 if the function succeeded, @c -1 on error.
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_private_dict_write(struct dicm_private_dict *self, struct dicm_dst *dst)
+    DICM_NONNULL();
+
+/**
+ * Open a private dictionary image in place
+ *
+ * Same rules as dicm_index_load(): @p ptr must be 8-byte aligned and outlive
+ * the dictionary, and a non-zero @p verify is required for an image that is
+ * not trusted.
+ *
+ * @param[out]      pself   A read-only private dictionary object.
+ * @param[in]       ptr     Dictionary image.
+ * @param[in]       size    Size of the image in bytes.
+ * @param[in]       verify  Verify checksum and entries.
+ *
+ * @returns @c 0 if the function succeeded, @c -1 if the image is invalid.
+ */
+DICM_CHECK_RETURN
+DICM_DECLARE(int)
+dicm_private_dict_load(struct dicm_private_dict **pself, const void *ptr,
+                       size_t size, int verify) DICM_NONNULL();
+
+/** @} */
+
 #ifdef __cplusplus
 }
 #endif
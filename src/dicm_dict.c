@@ -0,0 +1,79 @@
+#include "dicm_dict.h"
+
+#include "dicm.h"
+#include "dicm_private.h"
+
+#include "dicm_dict_table.h" /* generated */
+
+#include <string.h> /* strcmp */
+
+static const struct dicm_dict_entry dict_entries[] = {
+#define DICT_ENTRY(tag, vr, vm, keyword) {tag, VR_##vr, vm, #keyword},
+#include "dicm_dict.def"
+#undef DICT_ENTRY
+};
+
+_Static_assert(sizeof dict_entries / sizeof *dict_entries == DICT_NUM_ENTRIES,
+               "lookup tables are out of date");
+
+enum { DICT_SLOT_MASK = (1u << DICT_SLOT_BITS) - 1 };
+
+static const struct dicm_dict_entry *dict_find_tag(const uint32_t tag) {
+  size_t slot = dict_slot(dict_hash_tag(tag), DICT_SLOT_BITS);
+  for (; dict_tag_slots[slot] != 0; slot = (slot + 1) & DICT_SLOT_MASK) {
+    const struct dicm_dict_entry *entry =
+        &dict_entries[dict_tag_slots[slot] - 1];
+    if (entry->tag == tag) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+static const struct dicm_dict_entry *dict_find_keyword(const char *keyword) {
+  size_t slot = dict_slot(dict_hash_keyword(keyword), DICT_SLOT_BITS);
+  for (; dict_keyword_slots[slot] != 0; slot = (slot + 1) & DICT_SLOT_MASK) {
+    const struct dicm_dict_entry *entry =
+        &dict_entries[dict_keyword_slots[slot] - 1];
+    if (strcmp(entry->keyword, keyword) == 0) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+uint32_t dict_get_vr(const uint32_t tag) {
+  const struct dicm_dict_entry *entry = dict_find_tag(tag);
+  if (entry) {
+    return entry->vr;
+  }
+  const uint32_t group = tag >> 16u;
+  const uint32_t element = tag & 0xffffu;
+  if (element == 0x0000) {
+    /* Group Length */
+    return VR_UL;
+  }
+  if (group % 2 == 1 && element >= 0x0010 && element <= 0x00ff) {
+    /* Private Creator */
+    return VR_LO;
+  }
+  return VR_NONE;
+}
+
+int dicm_dict_find_tag(uint32_t tag, struct dicm_dict_entry *entry) {
+  const struct dicm_dict_entry *found = dict_find_tag(tag);
+  if (!found) {
+    return -1;
+  }
+  *entry = *found;
+  return 0;
+}
+
+int dicm_dict_find_keyword(const char *keyword, struct dicm_dict_entry *entry) {
+  const struct dicm_dict_entry *found = dict_find_keyword(keyword);
+  if (!found) {
+    return -1;
+  }
+  *entry = *found;
+  return 0;
+}
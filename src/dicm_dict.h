@@ -0,0 +1,46 @@
+#ifndef DICM_DICT_H
+#define DICM_DICT_H
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint32_t */
+
+/*
+ * Data dictionary lookup tables are generated by dicm_gendict from
+ * dicm_dict.def, itself generated by dicm_gendef from dicm_dict.tsv. Both
+ * tables use open addressing with linear probing: a slot holds the index of
+ * the entry plus one, 0 when empty. The generator and the
+ * library must agree on the hash functions below.
+ */
+
+/* multiplicative hashing, keep the upper bits */
+static inline uint32_t dict_hash_tag(const uint32_t tag) {
+  return tag * 0x9e3779b1u;
+}
+
+/* FNV-1a */
+static inline uint32_t dict_hash_keyword(const char *keyword) {
+  uint32_t h = 2166136261u;
+  for (; *keyword; ++keyword) {
+    h = (h ^ (unsigned char)*keyword) * 16777619u;
+  }
+  return h;
+}
+
+/* FNV-1a, for strings that are not null terminated */
+static inline uint32_t dict_hash_bytes(const void *ptr, const size_t len) {
+  const unsigned char *p = ptr;
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; ++i) {
+    h = (h ^ p[i]) * 16777619u;
+  }
+  return h;
+}
+
+static inline size_t dict_slot(const uint32_t hash, const unsigned bits) {
+  return hash >> (32u - bits);
+}
+
+/* VR of a data element in an implicit structure, VR_NONE when unknown */
+uint32_t dict_get_vr(uint32_t tag);
+
+#endif /* DICM_DICT_H */
@@ -1,13 +1,25 @@
 #define _FILE_OFFSET_BITS 64
-#define _POSIX_C_SOURCE 200112L
+#define _POSIX_C_SOURCE 200809L
+/* pwritev */
+#define _DEFAULT_SOURCE
 
 #include "dicm_dst.h"
 
+#include "dicm_configure.h"
 #include "posix_compat.h"
 
 #include <stdio.h>  /* FILE */
 #include <stdlib.h> /* malloc */
 #include <string.h> /* memcpy */
+#ifdef DICM_HAVE_PREAD
+#include <errno.h>    /* EINTR */
+#include <sys/stat.h> /* fstat */
+#include <sys/uio.h>  /* pwritev */
+#include <unistd.h>   /* pwrite */
+#endif
+#ifdef DICM_HAVE_IO_URING
+#include "dicm_uring.h"
+#endif
 
 struct file {
   struct dicm_dst super;
@@ -156,6 +168,373 @@ int dicm_dst_mem_create(struct dicm_dst **pself, void *ptr, size_t size) {
   return -1;
 }
 
+#ifdef DICM_HAVE_PREAD
+struct fd {
+  struct dicm_dst super;
+  /* data */
+  int fd;
+  /* own position, the file position of fd is neither used nor changed */
+  int64_t pos;
+};
+
+static DICM_CHECK_RETURN int fd_destroy(struct object *) DICM_NONNULL();
+static DICM_CHECK_RETURN int64_t fd_write(struct dicm_dst *, const void *,
+                                          size_t) DICM_NONNULL();
+static DICM_CHECK_RETURN int64_t fd_seek(struct dicm_dst *, int64_t, int)
+    DICM_NONNULL();
+static DICM_CHECK_RETURN int64_t fd_writev(struct dicm_dst *,
+                                           const struct dst_iovec *, int)
+    DICM_NONNULL();
+
+static struct dicm_dst_vtable const g_fd_vtable = {
+    .obj = {.fp_destroy = fd_destroy},
+    .dst = {.fp_write = fd_write, .fp_seek = fd_seek, .fp_writev = fd_writev}};
+
+int fd_destroy(struct object *obj) {
+  struct fd *self = (struct fd *)obj;
+  free(self);
+  return 0;
+}
+
+/* write at the current position, short writes are retried */
+static int64_t fd_pwrite(struct fd *self, const void *buf, size_t size) {
+  const char *in = buf;
+  size_t done = 0;
+  while (done < size) {
+    const ssize_t ret = pwrite(self->fd, in + done, size - done,
+                               (off_t)(self->pos + (int64_t)done));
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    done += (size_t)ret;
+  }
+  self->pos += (int64_t)done;
+  return (int64_t)done;
+}
+
+int64_t fd_write(struct dicm_dst *const dst, const void *buf, size_t size) {
+  struct fd *self = (struct fd *)dst;
+  assert(is_aligned(buf, 4));
+  return fd_pwrite(self, buf, size);
+}
+
+enum { FD_IOV_MAX = 8 };
+
+int64_t fd_writev(struct dicm_dst *const dst, const struct dst_iovec *iov,
+                  int iovcnt) {
+  struct fd *self = (struct fd *)dst;
+  int64_t done = 0;
+#ifdef DICM_HAVE_PWRITEV
+  struct iovec vec[FD_IOV_MAX];
+  while (iovcnt > 0) {
+    const int n = iovcnt < FD_IOV_MAX ? iovcnt : FD_IOV_MAX;
+    for (int i = 0; i < n; ++i) {
+      vec[i].iov_base = (void *)iov[i].base;
+      vec[i].iov_len = iov[i].len;
+    }
+    const ssize_t ret = pwritev(self->fd, vec, n, (off_t)self->pos);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    self->pos += ret;
+    done += ret;
+    /* skip the buffers written, a short write ends in the middle of one */
+    size_t len = (size_t)ret;
+    int i = 0;
+    for (; i < n && len >= iov[i].len; ++i) {
+      len -= iov[i].len;
+    }
+    if (i < n) {
+      const size_t rest = iov[i].len - len;
+      if (fd_pwrite(self, (const char *)iov[i].base + len, rest) < 0) {
+        return -1;
+      }
+      done += (int64_t)rest;
+      ++i;
+    }
+    iov += i;
+    iovcnt -= i;
+  }
+#else
+  for (int i = 0; i < iovcnt; ++i) {
+    if (fd_pwrite(self, iov[i].base, iov[i].len) < 0) {
+      return -1;
+    }
+    done += (int64_t)iov[i].len;
+  }
+#endif
+  return done;
+}
+
+int64_t fd_seek(struct dicm_dst *const dst, int64_t offset, int whence) {
+  struct fd *self = (struct fd *)dst;
+  int64_t base = 0;
+  struct stat st;
+  switch (whence) {
+  case SEEK_SET:
+    break;
+  case SEEK_CUR:
+    base = self->pos;
+    break;
+  case SEEK_END:
+    if (fstat(self->fd, &st) != 0) {
+      return -1;
+    }
+    base = (int64_t)st.st_size;
+    break;
+  default:
+    return -1;
+  }
+  if (base + offset < 0) {
+    return -1;
+  }
+  self->pos = base + offset;
+  return self->pos;
+}
+
+int dicm_dst_fd_create(struct dicm_dst **pself, int fd, int64_t offset) {
+  struct stat st;
+  if (offset < 0 || fstat(fd, &st) != 0 ||
+      !(S_ISREG(st.st_mode) || S_ISBLK(st.st_mode))) {
+    *pself = NULL;
+    return -1;
+  }
+  struct fd *self = (struct fd *)malloc(sizeof(*self));
+  if (self) {
+    *pself = &self->super;
+    self->super.vtable = &g_fd_vtable;
+    self->fd = fd;
+    self->pos = offset;
+    return 0;
+  }
+  *pself = NULL;
+  return -1;
+}
+#else
+int dicm_dst_fd_create(struct dicm_dst **pself, int fd, int64_t offset) {
+  (void)fd;
+  (void)offset;
+  *pself = NULL;
+  return -1;
+}
+#endif
+
+#ifdef DICM_HAVE_IO_URING
+/* a block being filled, or written by the kernel */
+struct uring_block {
+  struct iovec iov;
+  int64_t offset;
+  bool inflight;
+};
+
+struct uring_dst {
+  struct fd super;
+  /* data */
+  struct uring ring;
+  /* depth blocks, filled in turn, the current one is not submitted yet */
+  char *buf;
+  size_t block_size;
+  unsigned depth;
+  struct uring_block *blocks;
+  unsigned head;
+  unsigned inflight;
+  /* a write failed, reported by all later calls */
+  bool failed;
+};
+
+static DICM_CHECK_RETURN int uring_destroy(struct object *) DICM_NONNULL();
+static DICM_CHECK_RETURN int64_t uring_write(struct dicm_dst *, const void *,
+                                             size_t) DICM_NONNULL();
+static DICM_CHECK_RETURN int64_t uring_seek(struct dicm_dst *, int64_t, int)
+    DICM_NONNULL();
+
+static struct dicm_dst_vtable const g_uring_vtable = {
+    .obj = {.fp_destroy = uring_destroy},
+    .dst = {.fp_write = uring_write, .fp_seek = uring_seek}};
+
+/* wait for the next completion. A short write is finished synchronously,
+ * the block is still untouched */
+static int uring_dst_reap(struct uring_dst *self) {
+  int32_t res;
+  uint64_t user_data;
+  if (uring_wait(&self->ring, &res, &user_data) < 0) {
+    self->failed = true;
+    return -1;
+  }
+  struct uring_block *block = &self->blocks[user_data];
+  block->inflight = false;
+  --self->inflight;
+  if (res < 0) {
+    self->failed = true;
+    return -1;
+  }
+  const size_t done = (size_t)res;
+  if (done != block->iov.iov_len) {
+    struct fd rest = {.fd = self->super.fd, .pos = block->offset + res};
+    const size_t len = block->iov.iov_len - done;
+    if (fd_pwrite(&rest, (char *)block->iov.iov_base + done, len) < 0) {
+      self->failed = true;
+      return -1;
+    }
+  }
+  block->iov.iov_len = 0;
+  return 0;
+}
+
+/* hand the current block to the kernel and move on to the next one, waiting
+ * when it is still in flight */
+static int uring_dst_submit(struct uring_dst *self) {
+  struct uring_block *block = &self->blocks[self->head];
+  if (block->iov.iov_len != 0) {
+    struct io_uring_sqe *sqe = uring_get_sqe(&self->ring);
+    if (!sqe) {
+      self->failed = true;
+      return -1;
+    }
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = self->super.fd;
+    sqe->addr = (uint64_t)(uintptr_t)&block->iov;
+    sqe->len = 1;
+    sqe->off = (uint64_t)block->offset;
+    sqe->user_data = self->head;
+    block->inflight = true;
+    ++self->inflight;
+    if (uring_submit(&self->ring) < 0) {
+      self->failed = true;
+      return -1;
+    }
+    self->head = (self->head + 1) % self->depth;
+  }
+  while (self->blocks[self->head].inflight) {
+    if (uring_dst_reap(self) < 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/* submit the current block and wait for all writes */
+static int uring_dst_drain(struct uring_dst *self) {
+  int ret = uring_dst_submit(self);
+  while (self->inflight != 0) {
+    if (uring_dst_reap(self) < 0) {
+      ret = -1;
+    }
+  }
+  return self->failed ? -1 : ret;
+}
+
+int uring_destroy(struct object *obj) {
+  struct uring_dst *self = (struct uring_dst *)obj;
+  const int ret = uring_dst_drain(self);
+  uring_exit(&self->ring);
+  free(self->blocks);
+  free(self->buf);
+  free(self);
+  return ret;
+}
+
+int64_t uring_write(struct dicm_dst *const dst, const void *buf, size_t size) {
+  struct uring_dst *self = (struct uring_dst *)dst;
+  assert(is_aligned(buf, 4));
+  if (self->failed) {
+    return -1;
+  }
+  /* the caller may reuse buf on return: always copied */
+  const char *in = buf;
+  size_t done = 0;
+  while (done < size) {
+    struct uring_block *block = &self->blocks[self->head];
+    if (block->iov.iov_len == 0) {
+      block->offset = self->super.pos;
+    }
+    const size_t room = self->block_size - block->iov.iov_len;
+    const size_t remaining = size - done;
+    const size_t len = remaining < room ? remaining : room;
+    memcpy((char *)block->iov.iov_base + block->iov.iov_len, in + done, len);
+    block->iov.iov_len += len;
+    self->super.pos += (int64_t)len;
+    done += len;
+    if (block->iov.iov_len == self->block_size &&
+        uring_dst_submit(self) < 0) {
+      return -1;
+    }
+  }
+  return (int64_t)size;
+}
+
+int64_t uring_seek(struct dicm_dst *const dst, int64_t offset, int whence) {
+  struct uring_dst *self = (struct uring_dst *)dst;
+  /* later writes may overlap the ones in flight */
+  if (uring_dst_drain(self) < 0) {
+    return -1;
+  }
+  return fd_seek(dst, offset, whence);
+}
+
+enum { URING_DEFAULT_DEPTH = 8, URING_DEFAULT_BLOCK_SIZE = 262144 };
+
+static int uring_dst_create(struct dicm_dst **pself, int fd, int64_t offset,
+                            unsigned depth, size_t block_size) {
+  struct uring_dst *self = (struct uring_dst *)malloc(sizeof(*self));
+  if (!self) {
+    return -1;
+  }
+  self->depth = depth != 0 ? depth : URING_DEFAULT_DEPTH;
+  self->block_size = block_size != 0 ? block_size : URING_DEFAULT_BLOCK_SIZE;
+  if (uring_init(&self->ring, self->depth) < 0) {
+    free(self);
+    return -1;
+  }
+  self->buf = malloc(self->depth * self->block_size);
+  self->blocks = calloc(self->depth, sizeof *self->blocks);
+  if (self->buf && self->blocks) {
+    for (unsigned i = 0; i < self->depth; ++i) {
+      self->blocks[i].iov.iov_base = self->buf + (size_t)i * self->block_size;
+    }
+    *pself = &self->super.super;
+    self->super.super.vtable = &g_uring_vtable;
+    self->super.fd = fd;
+    self->super.pos = offset;
+    self->head = 0;
+    self->inflight = 0;
+    self->failed = false;
+    return 0;
+  }
+  uring_exit(&self->ring);
+  free(self->blocks);
+  free(self->buf);
+  free(self);
+  return -1;
+}
+#endif
+
+int dicm_dst_uring_create(struct dicm_dst **pself, int fd, int64_t offset,
+                          unsigned depth, size_t block_size) {
+#ifdef DICM_HAVE_IO_URING
+  struct stat st;
+  if (offset < 0 || fstat(fd, &st) != 0 ||
+      !(S_ISREG(st.st_mode) || S_ISBLK(st.st_mode))) {
+    *pself = NULL;
+    return -1;
+  }
+  if (uring_dst_create(pself, fd, offset, depth, block_size) == 0) {
+    return 0;
+  }
+#else
+  (void)depth;
+  (void)block_size;
+#endif
+  /* io_uring not available */
+  return dicm_dst_fd_create(pself, fd, offset);
+}
+
 static DICM_CHECK_RETURN int user_destroy(struct object *) DICM_NONNULL();
 int user_destroy(struct object *obj) {
   struct dicm_dst_user *self = (struct dicm_dst_user *)obj;
@@ -198,3 +577,143 @@ int dicm_dst_stream_create(struct dicm_dst **pself, void *data,
                                               int)) {
   return dst_user_create(pself, data, fp_write, fp_seek);
 }
+
+struct buffered {
+  struct dicm_dst super;
+  /* data */
+  struct dicm_dst *dst;
+  /* write-combining buffer, pending bytes are [0, len) */
+  char *buf;
+  size_t size;
+  size_t len;
+};
+
+static DICM_CHECK_RETURN int buffered_destroy(struct object *) DICM_NONNULL();
+static DICM_CHECK_RETURN int64_t buffered_write(struct dicm_dst *, const void *,
+                                                size_t) DICM_NONNULL();
+static DICM_CHECK_RETURN int64_t buffered_seek(struct dicm_dst *, int64_t, int)
+    DICM_NONNULL();
+static DICM_CHECK_RETURN int64_t buffered_writev(struct dicm_dst *,
+                                                 const struct dst_iovec *, int)
+    DICM_NONNULL();
+
+static struct dicm_dst_vtable const g_buffered_vtable = {
+    .obj = {.fp_destroy = buffered_destroy},
+    .dst = {.fp_write = buffered_write,
+            .fp_seek = buffered_seek,
+            .fp_writev = buffered_writev}};
+
+static struct dicm_dst_vtable const g_buffered_stream_vtable = {
+    .obj = {.fp_destroy = buffered_destroy},
+    .dst = {.fp_write = buffered_write,
+            .fp_seek = NULL,
+            .fp_writev = buffered_writev}};
+
+/* hand pending bytes to dst in one write */
+static int buffered_flush(struct buffered *self) {
+  const size_t len = self->len;
+  self->len = 0;
+  if (len != 0 && dicm_dst_write(self->dst, self->buf, len) != (int64_t)len) {
+    return -1;
+  }
+  return 0;
+}
+
+int buffered_destroy(struct object *obj) {
+  struct buffered *self = (struct buffered *)obj;
+  const int ret = buffered_flush(self);
+  free(self->buf);
+  free(self);
+  return ret;
+}
+
+int64_t buffered_write(struct dicm_dst *const dst, const void *buf,
+                       size_t size) {
+  struct buffered *self = (struct buffered *)dst;
+  const char *in = buf;
+  if (likely(size <= self->size - self->len)) {
+    /* fast path: merged with the previous writes */
+    memcpy(self->buf + self->len, in, size);
+    self->len += size;
+    return (int64_t)size;
+  }
+  if (buffered_flush(self) < 0) {
+    return -1;
+  }
+  if (size >= self->size && is_aligned(in, 4)) {
+    /* large write: bypass the buffer */
+    return dicm_dst_write(self->dst, in, size);
+  }
+  size_t done = 0;
+  while (done < size) {
+    const size_t remaining = size - done;
+    const size_t len = remaining < self->size ? remaining : self->size;
+    memcpy(self->buf, in + done, len);
+    self->len = len;
+    done += len;
+    if (self->len == self->size && buffered_flush(self) < 0) {
+      return -1;
+    }
+  }
+  return (int64_t)size;
+}
+
+enum { BUFFERED_IOV_MAX = 8 };
+
+int64_t buffered_writev(struct dicm_dst *const dst, const struct dst_iovec *iov,
+                        int iovcnt) {
+  struct buffered *self = (struct buffered *)dst;
+  size_t total = 0;
+  for (int i = 0; i < iovcnt; ++i) {
+    total += iov[i].len;
+  }
+  if (total < self->size || iovcnt >= BUFFERED_IOV_MAX) {
+    /* small writes are merged */
+    for (int i = 0; i < iovcnt; ++i) {
+      if (buffered_write(dst, iov[i].base, iov[i].len) != (int64_t)iov[i].len) {
+        return -1;
+      }
+    }
+    return (int64_t)total;
+  }
+  /* large write: pending bytes go first, in the same call */
+  struct dst_iovec all[BUFFERED_IOV_MAX];
+  all[0].base = self->buf;
+  all[0].len = self->len;
+  memcpy(all + 1, iov, iovcnt * sizeof *iov);
+  const size_t len = self->len;
+  self->len = 0;
+  const int64_t ret = dicm_dst_writev(self->dst, all, iovcnt + 1);
+  return ret == (int64_t)(len + total) ? (int64_t)total : -1;
+}
+
+int64_t buffered_seek(struct dicm_dst *const dst, int64_t offset, int whence) {
+  struct buffered *self = (struct buffered *)dst;
+  if (buffered_flush(self) < 0) {
+    return -1;
+  }
+  return self->dst->vtable->dst.fp_seek(self->dst, offset, whence);
+}
+
+enum { BUFFERED_DEFAULT_SIZE = 65536 };
+
+int dicm_dst_buffered_create(struct dicm_dst **pself, struct dicm_dst *dst,
+                             size_t size) {
+  struct buffered *self = (struct buffered *)malloc(sizeof(*self));
+  if (self) {
+    self->size = size != 0 ? size : BUFFERED_DEFAULT_SIZE;
+    self->buf = malloc(self->size);
+    if (self->buf) {
+      const bool seekable = dst->vtable->dst.fp_seek != NULL;
+      *pself = &self->super;
+      self->super.vtable =
+          seekable ? &g_buffered_vtable : &g_buffered_stream_vtable;
+      self->dst = dst;
+      self->len = 0;
+      return 0;
+    }
+    free(self);
+  }
+  *pself = NULL;
+  return -1;
+}
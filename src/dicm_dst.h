@@ -5,11 +5,21 @@
 
 #include <stddef.h> /* size_t */
 
+/* one buffer of a vectored write */
+struct dst_iovec {
+  const void *base;
+  size_t len;
+};
+
 struct dst_prv_vtable {
   DICM_CHECK_RETURN int64_t (*fp_write)(struct dicm_dst *, const void *, size_t)
       DICM_NONNULL();
   DICM_CHECK_RETURN int64_t (*fp_seek)(struct dicm_dst *, int64_t, int)
       DICM_NONNULL();
+  /* optional: write the buffers in order, as a single call when possible */
+  DICM_CHECK_RETURN int64_t (*fp_writev)(struct dicm_dst *,
+                                         const struct dst_iovec *, int)
+      DICM_NONNULL();
 };
 
 struct dicm_dst_vtable {
@@ -20,4 +30,28 @@ struct dicm_dst_vtable {
 /* common dst interface */
 #define dicm_dst_write(t, b, s) ((t)->vtable->dst.fp_write((t), (b), (s)))
 
+/* vectored write, one write per buffer when dst has no fp_writev. Return the
+ * number of bytes written, stop at the first short write */
+static inline int64_t dicm_dst_writev(struct dicm_dst *dst,
+                                      const struct dst_iovec *iov, int iovcnt) {
+  if (dst->vtable->dst.fp_writev) {
+    return dst->vtable->dst.fp_writev(dst, iov, iovcnt);
+  }
+  int64_t done = 0;
+  for (int i = 0; i < iovcnt; ++i) {
+    if (iov[i].len == 0) {
+      continue;
+    }
+    const int64_t ret = dicm_dst_write(dst, iov[i].base, iov[i].len);
+    if (ret < 0) {
+      return done != 0 ? done : -1;
+    }
+    done += ret;
+    if ((size_t)ret != iov[i].len) {
+      break;
+    }
+  }
+  return done;
+}
+
 #endif /* DICM_DST_H */
@@ -1,11 +1,26 @@
 #include "dicm_emitter.h"
 
+#include "dicm_configure.h"
 #include "dicm_dst.h"
 #include "dicm_item.h"
 #include "dicm_private.h"
 
 #include <assert.h> /* assert */
 #include <stdlib.h> /* malloc */
+#include <string.h> /* memcpy */
+
+enum { HEADER_MAX = 64 };
+
+/* level emitters write headers (keys, value lengths, items delimiters) here,
+ * they are sent along with the next value in a single vectored write */
+struct header_dst {
+  struct dicm_dst super;
+  /* data */
+  struct dicm_dst *dst;
+  /* pending bytes are [0, len) */
+  uint32_t buf[HEADER_MAX / 4];
+  size_t len;
+};
 
 // FIXME I need to define a name without spaces:
 typedef struct level_emitter level_emitter_t;
@@ -14,6 +29,7 @@ struct emitter {
 
   /* data */
   struct dicm_dst *dst;
+  struct header_dst header;
 
   /* the current item state */
   enum state current_item_state;
@@ -38,6 +54,45 @@ static struct emitter_vtable const g_vtable = {
 #endif
 };
 
+static int header_flush(struct header_dst *self) {
+  const size_t len = self->len;
+  self->len = 0;
+  if (len != 0 && dicm_dst_write(self->dst, self->buf, len) != (int64_t)len) {
+    return -1;
+  }
+  return 0;
+}
+
+static int64_t header_write(struct dicm_dst *const dst, const void *buf,
+                            size_t size) {
+  struct header_dst *self = (struct header_dst *)dst;
+  assert(size <= HEADER_MAX);
+  if (size > HEADER_MAX - self->len && header_flush(self) < 0) {
+    return -1;
+  }
+  memcpy((char *)self->buf + self->len, buf, size);
+  self->len += size;
+  return (int64_t)size;
+}
+
+/* pending header, then the value */
+static int64_t header_write_value(struct header_dst *self, const void *ptr,
+                                  size_t size) {
+  if (self->len == 0) {
+    return dicm_dst_write(self->dst, ptr, size);
+  }
+  const struct dst_iovec iov[] = {{self->buf, self->len}, {ptr, size}};
+  const size_t len = self->len;
+  self->len = 0;
+  const int64_t ret = dicm_dst_writev(self->dst, iov, size != 0 ? 2 : 1);
+  return ret == (int64_t)(len + size) ? (int64_t)size : -1;
+}
+
+/* not an object: never deleted */
+static struct dicm_dst_vtable const g_header_vtable = {
+    .obj = {.fp_destroy = NULL},
+    .dst = {.fp_write = header_write, .fp_seek = NULL}};
+
 static inline struct level_emitter *
 emitter_get_level_emitter(struct emitter *emitter) {
   return &array_back(emitter->level_emitters);
@@ -76,18 +131,26 @@ emitter_set_root_level(struct emitter *emitter,
 #else
   struct level_emitter *root_item = &array_back(emitter->level_emitters);
   switch (structure_type) {
+#ifdef DICM_ENABLE_STRUCTURE_ENCAPSULATED
   case DICM_STRUCTURE_ENCAPSULATED:
     encap_init_level_emitter(root_item);
     break;
+#endif
+#ifdef DICM_ENABLE_STRUCTURE_IMPLICT
   case DICM_STRUCTURE_IMPLICIT:
     ivrle_init_level_emitter(root_item);
     break;
+#endif
+#ifdef DICM_ENABLE_STRUCTURE_EXPLICT_LE
   case DICM_STRUCTURE_EXPLICIT_LE:
     evrle_init_level_emitter(root_item);
     break;
+#endif
+#ifdef DICM_ENABLE_STRUCTURE_EXPLICT_BE
   case DICM_STRUCTURE_EXPLICIT_BE:
     evrbe_init_level_emitter(root_item);
     break;
+#endif
   default:
     assert(0);
   }
@@ -130,8 +193,11 @@ static enum state emitter_emit(struct emitter *emitter,
 
   // else compute new state from event:
   struct level_emitter *level_emitter = emitter_get_level_emitter(emitter);
-  const enum state new_state = level_emitter_next_event(
-      level_emitter, emitter->current_item_state, emitter->dst, next);
+  enum state new_state = level_emitter_next_event(
+      level_emitter, emitter->current_item_state, &emitter->header.super, next);
+  if (new_state == STATE_ENDDOCUMENT && header_flush(&emitter->header) < 0) {
+    new_state = STATE_INVALID;
+  }
 
   // FIXME: should not expose detail frag vs item here:
   switch (new_state) {
@@ -152,9 +218,11 @@ static enum state emitter_emit(struct emitter *emitter,
 
 int emitter_destroy(struct object *const self) {
   struct emitter *emitter = (struct emitter *)self;
+  /* document not ended */
+  const int ret = emitter->dst ? header_flush(&emitter->header) : 0;
   array_free(emitter->level_emitters);
   free(emitter);
-  return 0;
+  return ret;
 }
 
 /* public API */
@@ -167,12 +235,22 @@ int dicm_emitter_set_output(struct dicm_emitter *self, const int structure_type,
   const enum dicm_structure_type estype = structure_type;
   // update ready state:
   emitter->dst = dst;
+  emitter->header.dst = dst;
+  emitter->header.len = 0;
   enum state new_state = STATE_INVALID;
   switch (estype) {
+#ifdef DICM_ENABLE_STRUCTURE_ENCAPSULATED
   case DICM_STRUCTURE_ENCAPSULATED:
+#endif
+#ifdef DICM_ENABLE_STRUCTURE_IMPLICT
   case DICM_STRUCTURE_IMPLICIT:
+#endif
+#ifdef DICM_ENABLE_STRUCTURE_EXPLICT_LE
   case DICM_STRUCTURE_EXPLICIT_LE:
+#endif
+#ifdef DICM_ENABLE_STRUCTURE_EXPLICT_BE
   case DICM_STRUCTURE_EXPLICIT_BE:
+#endif
     emitter_set_root_level(emitter, estype, STATE_INVALID);
     new_state = STATE_INIT;
     break;
@@ -244,18 +322,18 @@ int dicm_emitter_write_bytes(struct dicm_emitter *self_, const void *ptr,
   const uint32_t value_length = level_emitter->da.vl;
   assert(len <= value_length);
   const uint32_t to_write = (uint32_t)len;
-  struct dicm_dst *dst = emitter->dst;
+  struct header_dst *header = &emitter->header;
   const enum token tok = TOKEN_VALUE;
   /* Write VL */
   if (emitter->value_length_pos == VL_UNDEFINED) {
     const enum state new_state =
-        level_emitter_vl_token(level_emitter, dst, tok);
+        level_emitter_vl_token(level_emitter, &header->super, tok);
     assert(new_state == STATE_VALUE);
     emitter->value_length_pos = 0;
   }
 
-  /* Write actual value */
-  int64_t err = dicm_dst_write(dst, ptr, to_write);
+  /* Write actual value, along with the pending header */
+  int64_t err = header_write_value(header, ptr, to_write);
   assert(err == to_write);
   emitter->value_length_pos += to_write;
   assert(emitter->value_length_pos <= level_emitter->da.vl);
@@ -268,6 +346,10 @@ int dicm_emitter_create(struct dicm_emitter **pself) {
   if (self) {
     *pself = &self->emitter;
     self->emitter.vtable = &g_vtable;
+    self->dst = NULL;
+    self->header.super.vtable = &g_header_vtable;
+    self->header.dst = NULL;
+    self->header.len = 0;
     array_new(level_emitter_t, self->level_emitters);
 
     return 0;
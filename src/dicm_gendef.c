@@ -0,0 +1,123 @@
+/*
+ * Build time generator of the data dictionary entries.
+ *
+ * usage: dicm_gendef dicm_dict.tsv dicm_dict.def
+ *
+ * Reads the PS3.6 registry copied in dicm_dict.tsv and writes one
+ * DICT_ENTRY(tag, vr, vm, keyword) per attribute. When the standard lists
+ * several VR for an attribute, the one used in Implicit VR Little Endian is
+ * kept: OW for "OB or OW" and "US or OW" (pixel and LUT data), US for
+ * "US or SS" (pixel values, PS3.5 Annex A.1). Attributes without a keyword
+ * or without a VR (item delimiters) are skipped.
+ */
+#include <stdio.h>  /* fprintf */
+#include <stdlib.h> /* EXIT_SUCCESS */
+#include <string.h> /* strcmp */
+
+enum { MAX_LINE = 256, MAX_FIELDS = 5 };
+
+/* split line in place on tabs, return the number of fields */
+static int split(char *line, char *fields[MAX_FIELDS]) {
+  int n = 0;
+  fields[n++] = line;
+  for (char *p = line; *p; ++p) {
+    if (*p == '\t') {
+      *p = '\0';
+      if (n == MAX_FIELDS) {
+        return -1;
+      }
+      fields[n++] = p + 1;
+    }
+  }
+  return n;
+}
+
+/* the VR used in an implicit structure, NULL when there is none */
+static const char *implicit_vr(const char *vr) {
+  if (strcmp(vr, "NONE") == 0) {
+    return NULL;
+  }
+  if (strstr(vr, " or ") == NULL) {
+    return vr;
+  }
+  if (strstr(vr, "OW") != NULL) {
+    return "OW";
+  }
+  if (strstr(vr, "US") != NULL) {
+    return "US";
+  }
+  return NULL;
+}
+
+static int is_vr(const char *vr) {
+  return strlen(vr) == 2 && vr[0] >= 'A' && vr[0] <= 'Z' && vr[1] >= 'A' &&
+         vr[1] <= 'Z';
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 3) {
+    fprintf(stderr, "usage: %s dicm_dict.tsv dicm_dict.def\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  FILE *in = fopen(argv[1], "r");
+  if (!in) {
+    fprintf(stderr, "%s: cannot open %s\n", argv[0], argv[1]);
+    return EXIT_FAILURE;
+  }
+  FILE *out = fopen(argv[2], "w");
+  if (!out) {
+    fprintf(stderr, "%s: cannot open %s\n", argv[0], argv[2]);
+    fclose(in);
+    return EXIT_FAILURE;
+  }
+  fprintf(out, "/* generated by dicm_gendef from dicm_dict.tsv, do not edit "
+               "*/\n\n");
+
+  char line[MAX_LINE];
+  unsigned lineno = 0;
+  int ret = EXIT_SUCCESS;
+  while (fgets(line, sizeof line, in)) {
+    ++lineno;
+    const size_t len = strcspn(line, "\r\n");
+    if (line[len] == '\0' && !feof(in)) {
+      fprintf(stderr, "%s:%u: line too long\n", argv[1], lineno);
+      ret = EXIT_FAILURE;
+      break;
+    }
+    line[len] = '\0';
+    if (line[0] == '#' || line[0] == '\0') {
+      continue;
+    }
+    char *fields[MAX_FIELDS];
+    const int n = split(line, fields);
+    unsigned group, element;
+    char end;
+    if (n < 4 ||
+        sscanf(fields[0], "(%4x,%4x%c", &group, &element, &end) != 3 ||
+        end != ')') {
+      fprintf(stderr, "%s:%u: invalid entry\n", argv[1], lineno);
+      ret = EXIT_FAILURE;
+      break;
+    }
+    const char *keyword = fields[1];
+    const char *vr = implicit_vr(fields[2]);
+    if (*keyword == '\0' || vr == NULL) {
+      continue;
+    }
+    if (!is_vr(vr)) {
+      fprintf(stderr, "%s:%u: invalid VR %s\n", argv[1], lineno, fields[2]);
+      ret = EXIT_FAILURE;
+      break;
+    }
+    fprintf(out, "DICT_ENTRY(0x%04X%04X, %s, \"%s\", %s)\n", group, element,
+            vr, fields[3], keyword);
+  }
+  fclose(in);
+  if (fclose(out) != 0) {
+    ret = EXIT_FAILURE;
+  }
+  if (ret != EXIT_SUCCESS) {
+    remove(argv[2]);
+  }
+  return ret;
+}
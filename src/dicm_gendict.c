@@ -0,0 +1,103 @@
+/*
+ * Build time generator of the data dictionary lookup tables.
+ *
+ * usage: dicm_gendict output.h
+ *
+ * Entries are taken from dicm_dict.def, itself generated by dicm_gendef, in the
+ * same order as the entry table of dicm_dict.c. Duplicate tags or keywords fail the build.
+ */
+#include "dicm_dict.h"
+
+#include <stdio.h>  /* fprintf */
+#include <stdlib.h> /* EXIT_SUCCESS */
+#include <string.h> /* strcmp */
+
+struct entry {
+  uint32_t tag;
+  const char *keyword;
+};
+
+static const struct entry entries[] = {
+#define DICT_ENTRY(tag, vr, vm, keyword) {tag, #keyword},
+#include "dicm_dict.def"
+#undef DICT_ENTRY
+};
+
+enum { NUM_ENTRIES = sizeof entries / sizeof *entries, MAX_BITS = 16 };
+
+static uint16_t tag_slots[1u << MAX_BITS];
+static uint16_t keyword_slots[1u << MAX_BITS];
+
+/* insert entry i, return -1 when an entry with the same key exists */
+static int insert(uint16_t *slots, unsigned bits, uint32_t hash, size_t i,
+                  int (*equal)(size_t, size_t)) {
+  const size_t mask = ((size_t)1 << bits) - 1;
+  size_t slot = dict_slot(hash, bits);
+  while (slots[slot] != 0) {
+    if (equal(slots[slot] - 1u, i)) {
+      return -1;
+    }
+    slot = (slot + 1) & mask;
+  }
+  slots[slot] = (uint16_t)(i + 1);
+  return 0;
+}
+
+static int same_tag(size_t i, size_t j) {
+  return entries[i].tag == entries[j].tag;
+}
+
+static int same_keyword(size_t i, size_t j) {
+  return strcmp(entries[i].keyword, entries[j].keyword) == 0;
+}
+
+static void print_slots(FILE *out, const char *name, const uint16_t *slots,
+                        unsigned bits) {
+  const size_t n = (size_t)1 << bits;
+  fprintf(out, "static const uint16_t %s[%zu] = {", name, n);
+  for (size_t i = 0; i < n; ++i) {
+    fprintf(out, "%s%u,", i % 12 == 0 ? "\n    " : " ", slots[i]);
+  }
+  fprintf(out, "\n};\n\n");
+}
+
+int main(int argc, char *argv[]) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s output.h\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  /* at most half full */
+  unsigned bits = 1;
+  while (((size_t)1 << bits) < 2 * (size_t)NUM_ENTRIES) {
+    ++bits;
+  }
+  if (bits > MAX_BITS) {
+    fprintf(stderr, "%s: too many entries\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  for (size_t i = 0; i < NUM_ENTRIES; ++i) {
+    if (insert(tag_slots, bits, dict_hash_tag(entries[i].tag), i, same_tag) <
+        0) {
+      fprintf(stderr, "%s: duplicate tag %08x\n", argv[0], entries[i].tag);
+      return EXIT_FAILURE;
+    }
+    if (insert(keyword_slots, bits, dict_hash_keyword(entries[i].keyword), i,
+               same_keyword) < 0) {
+      fprintf(stderr, "%s: duplicate keyword %s\n", argv[0],
+              entries[i].keyword);
+      return EXIT_FAILURE;
+    }
+  }
+
+  FILE *out = fopen(argv[1], "w");
+  if (!out) {
+    fprintf(stderr, "%s: cannot open %s\n", argv[0], argv[1]);
+    return EXIT_FAILURE;
+  }
+  fprintf(out, "/* generated by dicm_gendict, do not edit */\n\n");
+  fprintf(out, "enum { DICT_NUM_ENTRIES = %u, DICT_SLOT_BITS = %u };\n\n",
+          (unsigned)NUM_ENTRIES, bits);
+  print_slots(out, "dict_tag_slots", tag_slots, bits);
+  print_slots(out, "dict_keyword_slots", keyword_slots, bits);
+  return fclose(out) == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
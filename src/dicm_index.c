@@ -0,0 +1,365 @@
+#include "dicm_index.h"
+
+#include "dicm_dst.h"
+#include "dicm_item.h"
+#include "dicm_src.h"
+
+#include <assert.h> /* assert */
+#include <stdio.h>  /* SEEK_SET */
+#include <stdlib.h> /* malloc */
+#include <string.h> /* memmove */
+
+struct index_node {
+  struct dicm_index_entry entry;
+  /* tag path, stored in the path pool */
+  uint32_t path_pos;
+  uint32_t path_len;
+};
+
+typedef struct index_node index_node_t;
+typedef uint32_t path_elem_t;
+struct index {
+  struct dicm_index index;
+
+  /* entries sorted by tag path */
+  array(index_node_t) * nodes;
+  /* tag paths of all entries, in insertion order */
+  array(path_elem_t) * paths;
+
+  /* read-only sidecar image, used in place of the arrays when set */
+  const struct index_node *view_nodes;
+  const uint32_t *view_paths;
+  size_t view_count;
+  size_t view_path_count;
+
+  /* identity of the indexed source, see dicm_index_set_source() */
+  uint64_t source_size;
+  uint32_t source_checksum;
+  bool has_source;
+};
+
+/*
+ * Sidecar layout, in host byte order so that it can be used in place:
+ * header, sorted nodes, then the path pool. The checksum covers everything
+ * after the header. The header also identifies the indexed source, so that a
+ * sidecar left over from a previous version of a file is not used.
+ */
+#define SIDECAR_MAGIC "DICMIDX"
+enum { SIDECAR_VERSION = 2, SIDECAR_BYTE_ORDER = 0x01020304 };
+
+struct sidecar_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint64_t node_count;
+  uint64_t path_count;
+  uint32_t checksum;
+  uint32_t reserved;
+  /* source size and checksum of its first and last bytes, when known */
+  uint64_t source_size;
+  uint32_t source_checksum;
+  uint32_t has_source;
+};
+
+_Static_assert(sizeof(struct sidecar_header) % 8 == 0,
+               "nodes must stay 8-byte aligned");
+
+/* bytes checksummed at each end of a source */
+enum { SOURCE_SAMPLE_SIZE = 4096 };
+
+static DICM_CHECK_RETURN int index_destroy(struct object *) DICM_NONNULL();
+
+static struct index_vtable const g_vtable = {
+    /* object interface */
+    .obj = {.fp_destroy = index_destroy}};
+
+int index_destroy(struct object *const self) {
+  struct index *index = (struct index *)self;
+  array_free(index->nodes);
+  array_free(index->paths);
+  free(index);
+  return 0;
+}
+
+/* lexicographic order, a path sorts before its extensions */
+static int path_compare(const uint32_t *a, size_t alen, const uint32_t *b,
+                        size_t blen) {
+  const size_t len = alen < blen ? alen : blen;
+  for (size_t i = 0; i < len; ++i) {
+    if (a[i] != b[i]) {
+      return a[i] < b[i] ? -1 : 1;
+    }
+  }
+  return alen < blen ? -1 : (alen > blen ? 1 : 0);
+}
+
+static inline const struct index_node *index_nodes(const struct index *index) {
+  return index->view_nodes ? index->view_nodes : array_ref(index->nodes, 0);
+}
+
+static inline size_t index_count(const struct index *index) {
+  return index->view_nodes ? index->view_count : index->nodes->size;
+}
+
+static inline const uint32_t *index_paths(const struct index *index) {
+  return index->view_nodes ? index->view_paths : array_ref(index->paths, 0);
+}
+
+static inline size_t index_path_count(const struct index *index) {
+  return index->view_nodes ? index->view_path_count : index->paths->size;
+}
+
+static inline const uint32_t *node_path(const struct index *index,
+                                        const struct index_node *node) {
+  return index_paths(index) + node->path_pos;
+}
+
+/* first node whose path is not less than (or greater than when upper) path */
+static size_t index_bound(const struct index *index, const uint32_t *path,
+                          size_t len, bool upper) {
+  const struct index_node *nodes = index_nodes(index);
+  size_t lo = 0;
+  size_t hi = index_count(index);
+  while (lo < hi) {
+    const size_t mid = lo + (hi - lo) / 2;
+    const struct index_node *node = nodes + mid;
+    const int cmp =
+        path_compare(node_path(index, node), node->path_len, path, len);
+    if (cmp < 0 || (upper && cmp == 0)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+void index_clear(struct dicm_index *self) {
+  struct index *index = (struct index *)self;
+  index->nodes->size = 0;
+  index->paths->size = 0;
+  index->view_nodes = NULL;
+  index->view_paths = NULL;
+  index->view_count = 0;
+  index->view_path_count = 0;
+  index->has_source = false;
+}
+
+void index_insert(struct dicm_index *self, const uint32_t *path, size_t len,
+                  const struct dicm_index_entry *entry) {
+  struct index *index = (struct index *)self;
+  if (index->view_nodes) {
+    /* a loaded image is read-only, start over */
+    index_clear(self);
+  }
+  const struct index_node node = {.entry = *entry,
+                                   .path_pos = (uint32_t)index->paths->size,
+                                   .path_len = (uint32_t)len};
+  for (size_t i = 0; i < len; ++i) {
+    array_push(index->paths, path[i]);
+  }
+  /* well-formed data sets are visited in ascending order: append */
+  const size_t size = index->nodes->size;
+  const size_t pos = size == 0 ? 0 : index_bound(index, path, len, true);
+  array_push(index->nodes, node);
+  if (pos != size) {
+    struct index_node *base = array_ref(index->nodes, 0);
+    memmove(base + pos + 1, base + pos, (size - pos) * sizeof *base);
+    base[pos] = node;
+  }
+}
+
+int dicm_index_create(struct dicm_index **pself) {
+  struct index *self = (struct index *)malloc(sizeof(*self));
+  if (self) {
+    *pself = &self->index;
+    self->index.vtable = &g_vtable;
+    array_new(index_node_t, self->nodes);
+    array_new(path_elem_t, self->paths);
+    self->view_nodes = NULL;
+    self->view_paths = NULL;
+    self->view_count = 0;
+    self->view_path_count = 0;
+    self->source_size = 0;
+    self->source_checksum = 0;
+    self->has_source = false;
+    return 0;
+  }
+  return -1;
+}
+
+int dicm_index_get_count(const struct dicm_index *self, size_t *count) {
+  const struct index *index = (const struct index *)self;
+  *count = index_count(index);
+  return 0;
+}
+
+int dicm_index_find(const struct dicm_index *self, const uint32_t *path,
+                    size_t len, struct dicm_index_entry *entry) {
+  const struct index *index = (const struct index *)self;
+  const size_t pos = index_bound(index, path, len, false);
+  if (pos == index_count(index)) {
+    return -1;
+  }
+  const struct index_node *node = index_nodes(index) + pos;
+  if (path_compare(node_path(index, node), node->path_len, path, len) != 0) {
+    return -1;
+  }
+  *entry = node->entry;
+  return 0;
+}
+
+/* len bytes at offset, a short read is an error */
+static int source_read_at(struct dicm_src *src, int64_t offset, void *buf,
+                          size_t len) {
+  if (dicm_src_seek(src, offset, SEEK_SET) != offset) {
+    return -1;
+  }
+  return len == 0 || dicm_src_read(src, buf, len) == (int64_t)len ? 0 : -1;
+}
+
+/* size of src and checksum of its first and last bytes, the position of src
+ * is restored */
+static int source_identity(struct dicm_src *src, uint64_t *size,
+                           uint32_t *checksum) {
+  if (src->vtable->src.fp_seek == NULL) {
+    return -1;
+  }
+  const int64_t cur = dicm_src_seek(src, 0, SEEK_CUR);
+  const int64_t end = dicm_src_seek(src, 0, SEEK_END);
+  if (cur < 0 || end < 0) {
+    return -1;
+  }
+  /* aligned for all sources */
+  uint64_t buf[SOURCE_SAMPLE_SIZE / sizeof(uint64_t)];
+  const size_t len = end < SOURCE_SAMPLE_SIZE ? (size_t)end : sizeof buf;
+  uint32_t crc = 0;
+  int ret = source_read_at(src, 0, buf, len);
+  if (ret == 0) {
+    crc = crc32_update(crc, buf, len);
+    ret = source_read_at(src, end - (int64_t)len, buf, len);
+    crc = crc32_update(crc, buf, len);
+  }
+  if (dicm_src_seek(src, cur, SEEK_SET) != cur) {
+    return -1;
+  }
+  *size = (uint64_t)end;
+  *checksum = crc;
+  return ret;
+}
+
+int dicm_index_set_source(struct dicm_index *self, struct dicm_src *src) {
+  struct index *index = (struct index *)self;
+  uint64_t size;
+  uint32_t checksum;
+  if (source_identity(src, &size, &checksum) < 0) {
+    return -1;
+  }
+  index->source_size = size;
+  index->source_checksum = checksum;
+  index->has_source = true;
+  return 0;
+}
+
+int dicm_index_check_source(const struct dicm_index *self,
+                            struct dicm_src *src) {
+  const struct index *index = (const struct index *)self;
+  uint64_t size;
+  uint32_t checksum;
+  if (!index->has_source || source_identity(src, &size, &checksum) < 0) {
+    return -1;
+  }
+  return size == index->source_size && checksum == index->source_checksum
+             ? 0
+             : -1;
+}
+
+int dicm_index_write(const struct dicm_index *self, struct dicm_dst *dst) {
+  const struct index *index = (const struct index *)self;
+  const struct index_node *nodes = index_nodes(index);
+  const size_t count = index_count(index);
+  const uint32_t *paths = index_paths(index);
+  const size_t path_count = index_path_count(index);
+  const size_t nodes_size = count * sizeof *nodes;
+  const size_t paths_size = path_count * sizeof *paths;
+  struct sidecar_header header = {.magic = SIDECAR_MAGIC,
+                                  .version = SIDECAR_VERSION,
+                                  .byte_order = SIDECAR_BYTE_ORDER,
+                                  .node_count = count,
+                                  .path_count = path_count,
+                                  .reserved = 0,
+                                  .source_size = index->source_size,
+                                  .source_checksum = index->source_checksum,
+                                  .has_source = index->has_source};
+  header.checksum = crc32_update(crc32_update(0, nodes, nodes_size), paths,
+                                 paths_size);
+  if (dicm_dst_write(dst, &header, sizeof header) != (int64_t)sizeof header) {
+    return -1;
+  }
+  if (nodes_size != 0 &&
+      dicm_dst_write(dst, nodes, nodes_size) != (int64_t)nodes_size) {
+    return -1;
+  }
+  if (paths_size != 0 &&
+      dicm_dst_write(dst, paths, paths_size) != (int64_t)paths_size) {
+    return -1;
+  }
+  return 0;
+}
+
+/* validate a sidecar image, the checksum is only computed on request */
+static int sidecar_check(const void *ptr, size_t size, int verify) {
+  const struct sidecar_header *header = ptr;
+  if (!is_aligned(ptr, 8) || size < sizeof *header ||
+      memcmp(header->magic, SIDECAR_MAGIC, sizeof header->magic) != 0 ||
+      header->version != SIDECAR_VERSION ||
+      header->byte_order != SIDECAR_BYTE_ORDER || header->has_source > 1) {
+    return -1;
+  }
+  const size_t avail = size - sizeof *header;
+  const uint64_t node_count = header->node_count;
+  const uint64_t path_count = header->path_count;
+  if (node_count > avail / sizeof(struct index_node) ||
+      path_count > (avail - node_count * sizeof(struct index_node)) /
+                       sizeof(uint32_t)) {
+    return -1;
+  }
+  if (!verify) {
+    return 0;
+  }
+  const size_t payload = (size_t)node_count * sizeof(struct index_node) +
+                         (size_t)path_count * sizeof(uint32_t);
+  if (crc32_update(0, header + 1, payload) != header->checksum) {
+    return -1;
+  }
+  const struct index_node *nodes = (const struct index_node *)(header + 1);
+  for (size_t i = 0; i < node_count; ++i) {
+    if (nodes[i].path_len == 0 ||
+        (uint64_t)nodes[i].path_pos + nodes[i].path_len > path_count) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int dicm_index_load(struct dicm_index **pself, const void *ptr, size_t size,
+                    int verify) {
+  if (sidecar_check(ptr, size, verify) < 0) {
+    return -1;
+  }
+  struct dicm_index *self;
+  if (dicm_index_create(&self) < 0) {
+    return -1;
+  }
+  struct index *index = (struct index *)self;
+  const struct sidecar_header *header = ptr;
+  index->view_nodes = (const struct index_node *)(header + 1);
+  index->view_count = (size_t)header->node_count;
+  index->view_paths = (const uint32_t *)(index->view_nodes + index->view_count);
+  index->view_path_count = (size_t)header->path_count;
+  index->source_size = header->source_size;
+  index->source_checksum = header->source_checksum;
+  index->has_source = header->has_source != 0;
+  *pself = self;
+  return 0;
+}
@@ -0,0 +1,27 @@
+#ifndef DICM_INDEX_H
+#define DICM_INDEX_H
+
+#include "dicm.h"
+
+#include "dicm_private.h"
+
+#include <stddef.h> /* size_t */
+
+struct index_vtable {
+  struct object_prv_vtable const obj;
+};
+
+/* common index object */
+struct dicm_index {
+  struct index_vtable const *vtable;
+};
+
+/* remove all entries, keep storage */
+void index_clear(struct dicm_index *self) DICM_NONNULL();
+
+/* record an entry at its sorted position. The path alternates tags and item
+ * numbers, and ends with the tag of the data element */
+void index_insert(struct dicm_index *self, const uint32_t *path, size_t len,
+                  const struct dicm_index_entry *entry) DICM_NONNULL();
+
+#endif /* DICM_INDEX_H */
@@ -7,6 +7,146 @@
 
 bool dicm_vr_is_16(const dicm_vr_t vr) { return _is_vr16(vr); }
 
+/* VR information table, indexed by the 5 low bits of both letters */
+#define VR_SIZE(log2) ((log2) << VR_INFO_SIZE_SHIFT)
+#define VR_STRING16 (VR_INFO_KNOWN | VR_INFO_VL16 | VR_INFO_STRING)
+#define VR_STRING32 (VR_INFO_KNOWN | VR_INFO_STRING)
+#define VR_NUMBER16(log2)                                                      \
+  (VR_INFO_KNOWN | VR_INFO_VL16 | VR_INFO_SWAP | VR_SIZE(log2))
+#define VR_NUMBER32(log2) (VR_INFO_KNOWN | VR_INFO_SWAP | VR_SIZE(log2))
+
+/* PS3.5 Table 6.2-1 and Section 7.1.2 */
+#define VR_KNOWN(vr)                                                           \
+  ((vr) == VR_AE   ? VR_STRING16                                               \
+   : (vr) == VR_AS ? VR_STRING16                                               \
+   : (vr) == VR_AT ? VR_NUMBER16(1)                                            \
+   : (vr) == VR_CS ? VR_STRING16                                               \
+   : (vr) == VR_DA ? VR_STRING16                                               \
+   : (vr) == VR_DS ? VR_STRING16                                               \
+   : (vr) == VR_DT ? VR_STRING16                                               \
+   : (vr) == VR_FL ? VR_NUMBER16(2)                                            \
+   : (vr) == VR_FD ? VR_NUMBER16(3)                                            \
+   : (vr) == VR_IS ? VR_STRING16                                               \
+   : (vr) == VR_LO ? VR_STRING16                                               \
+   : (vr) == VR_LT ? VR_STRING16                                               \
+   : (vr) == VR_OB ? VR_INFO_KNOWN                                             \
+   : (vr) == VR_OD ? VR_NUMBER32(3)                                            \
+   : (vr) == VR_OF ? VR_NUMBER32(2)                                            \
+   : (vr) == VR_OL ? VR_NUMBER32(2)                                            \
+   : (vr) == VR_OV ? VR_NUMBER32(3)                                            \
+   : (vr) == VR_OW ? VR_NUMBER32(1)                                            \
+   : (vr) == VR_PN ? VR_STRING16                                               \
+   : (vr) == VR_SH ? VR_STRING16                                               \
+   : (vr) == VR_SL ? VR_NUMBER16(2)                                            \
+   : (vr) == VR_SQ ? VR_INFO_KNOWN                                             \
+   : (vr) == VR_SS ? VR_NUMBER16(1)                                            \
+   : (vr) == VR_ST ? VR_STRING16                                               \
+   : (vr) == VR_SV ? VR_NUMBER32(3)                                            \
+   : (vr) == VR_TM ? VR_STRING16                                               \
+   : (vr) == VR_UC ? VR_STRING32                                               \
+   : (vr) == VR_UI ? VR_STRING16                                               \
+   : (vr) == VR_UL ? VR_NUMBER16(2)                                            \
+   : (vr) == VR_UN ? VR_INFO_KNOWN                                             \
+   : (vr) == VR_UR ? VR_STRING32                                               \
+   : (vr) == VR_US ? VR_NUMBER16(1)                                            \
+   : (vr) == VR_UT ? VR_STRING32                                               \
+   : (vr) == VR_UV ? VR_NUMBER32(3)                                            \
+                   : 0)
+
+#define VR_CELL(l, r)                                                          \
+  [VR_INDEX(MAKE_VR(l, r))] = VR_INFO_VALID | VR_KNOWN(MAKE_VR(l, r))
+#define VR_ROW(l)                                                              \
+  VR_CELL(l, 'A'), VR_CELL(l, 'B'), VR_CELL(l, 'C'), VR_CELL(l, 'D'),          \
+  VR_CELL(l, 'E'), VR_CELL(l, 'F'), VR_CELL(l, 'G'), VR_CELL(l, 'H'),          \
+  VR_CELL(l, 'I'), VR_CELL(l, 'J'), VR_CELL(l, 'K'), VR_CELL(l, 'L'),          \
+  VR_CELL(l, 'M'), VR_CELL(l, 'N'), VR_CELL(l, 'O'), VR_CELL(l, 'P'),          \
+  VR_CELL(l, 'Q'), VR_CELL(l, 'R'), VR_CELL(l, 'S'), VR_CELL(l, 'T'),          \
+  VR_CELL(l, 'U'), VR_CELL(l, 'V'), VR_CELL(l, 'W'), VR_CELL(l, 'X'),          \
+  VR_CELL(l, 'Y'), VR_CELL(l, 'Z')
+
+const uint8_t dicm_vr_infos[1024] = {
+    VR_ROW('A'), VR_ROW('B'), VR_ROW('C'), VR_ROW('D'), VR_ROW('E'),
+    VR_ROW('F'), VR_ROW('G'), VR_ROW('H'), VR_ROW('I'), VR_ROW('J'),
+    VR_ROW('K'), VR_ROW('L'), VR_ROW('M'), VR_ROW('N'), VR_ROW('O'),
+    VR_ROW('P'), VR_ROW('Q'), VR_ROW('R'), VR_ROW('S'), VR_ROW('T'),
+    VR_ROW('U'), VR_ROW('V'), VR_ROW('W'), VR_ROW('X'), VR_ROW('Y'),
+    VR_ROW('Z'),
+};
+
+#undef VR_ROW
+#undef VR_CELL
+#undef VR_KNOWN
+#undef VR_NUMBER32
+#undef VR_NUMBER16
+#undef VR_STRING32
+#undef VR_STRING16
+#undef VR_SIZE
+
+/* Transition tables */
+const unsigned char level_reads[][NUM_STATES] = {
+    [LEVEL_ROOT] = {[STATE_STARTDOCUMENT] = READ_KEY,
+                    [STATE_KEY] = READ_VALUE,
+                    [STATE_VALUE] = READ_KEY,
+                    [STATE_ENDSEQUENCE] = READ_KEY},
+    [LEVEL_ITEM] = {[STATE_STARTSEQUENCE] = READ_KEY,
+                    [STATE_ENDITEM] = READ_KEY,
+                    [STATE_KEY] = READ_VALUE,
+                    [STATE_VALUE] = READ_KEY,
+                    [STATE_ENDSEQUENCE] = READ_KEY,
+                    [STATE_STARTITEM] = READ_KEY},
+    [LEVEL_FRAGMENTS] = {[STATE_STARTFRAGMENTS] = READ_KEY,
+                         [STATE_VALUE] = READ_KEY,
+                         [STATE_FRAGMENT] = READ_VALUE},
+};
+
+/* value of an attribute, identical in the root dataset and in items */
+#define VALUE_TRANSITIONS                                                      \
+  {                                                                            \
+    [TOKEN_VALUE] = STATE_VALUE, [TOKEN_STARTSEQUENCE] = STATE_STARTSEQUENCE,  \
+    [TOKEN_STARTFRAGMENTS] = STATE_STARTFRAGMENTS                              \
+  }
+
+const signed char level_transitions[][NUM_STATES][NUM_TOKENS] = {
+    [LEVEL_ROOT] =
+        {
+            /* empty document is an error */
+            [STATE_STARTDOCUMENT] = {[TOKEN_KEY] = STATE_KEY},
+            [STATE_KEY] = VALUE_TRANSITIONS,
+            [STATE_VALUE] = {[TOKEN_KEY] = STATE_KEY,
+                             [TOKEN_EOF] = STATE_ENDDOCUMENT},
+            [STATE_ENDSEQUENCE] = {[TOKEN_KEY] = STATE_KEY,
+                                   [TOKEN_EOF] = STATE_ENDDOCUMENT},
+        },
+    [LEVEL_ITEM] =
+        {
+            [STATE_STARTSEQUENCE] = {[TOKEN_STARTITEM] = STATE_STARTITEM,
+                                     [TOKEN_ENDSQITEM] = STATE_ENDSEQUENCE},
+            [STATE_ENDITEM] = {[TOKEN_STARTITEM] = STATE_STARTITEM,
+                               [TOKEN_ENDSQITEM] = STATE_ENDSEQUENCE},
+            [STATE_KEY] = VALUE_TRANSITIONS,
+            [STATE_VALUE] = {[TOKEN_KEY] = STATE_KEY,
+                             [TOKEN_ENDITEM] = STATE_ENDITEM},
+            [STATE_ENDSEQUENCE] = {[TOKEN_KEY] = STATE_KEY,
+                                   [TOKEN_ENDITEM] = STATE_ENDITEM},
+            [STATE_STARTITEM] = {[TOKEN_KEY] = STATE_KEY,
+                                 [TOKEN_ENDITEM] = STATE_ENDITEM},
+        },
+    [LEVEL_FRAGMENTS] =
+        {
+            // FIXME: technically TOKEN_ENDSQITEM is impossible right after
+            // STATE_STARTFRAGMENTS, this would mean a duplicate Pixel Data
+            [STATE_STARTFRAGMENTS] = {[TOKEN_FRAGMENT] = STATE_FRAGMENT,
+                                      [TOKEN_ENDSQITEM] = STATE_ENDSEQUENCE},
+            [STATE_VALUE] = {[TOKEN_FRAGMENT] = STATE_FRAGMENT,
+                             [TOKEN_ENDSQITEM] = STATE_ENDSEQUENCE},
+            [STATE_FRAGMENT] = {[TOKEN_VALUE] = STATE_VALUE},
+        },
+};
+
+#undef VALUE_TRANSITIONS
+
+_Static_assert(STATE_INIT == 0, "zero entries are invalid transitions");
+
 static inline bool _tag_is_valid(const dicm_tag_t tag) {
   // The following cases have been handled by design:
   assert(tag != TAG_STARTITEM && tag != TAG_ENDITEM && tag != TAG_ENDSQITEM);
@@ -19,14 +159,6 @@ static inline bool _tag_is_creator(const dicm_tag_t tag) {
   return dicm_tag_is_private(tag) && (element > 0x0 && element <= 0xff);
 }
 
-static inline bool _vr_is_valid(const dicm_vr_t vr) {
-  if ((vr & 0xffff0000) != 0x0) {
-    return false;
-  }
-  const char *str = dicm_vr_get_string(vr);
-  return str[0] >= 'A' && str[0] <= 'Z' && str[1] >= 'A' && str[1] <= 'Z';
-}
-
 static inline bool _vl_is_valid(const dicm_vl_t vl) {
   return dicm_vl_is_undefined(vl) || vl % 2 == 0;
 }
@@ -5,6 +5,7 @@
 
 #include "dicm_private.h"
 
+#include <assert.h>
 #include <stdint.h>
 #include <string.h>
 
@@ -148,12 +149,96 @@ struct level_parser_prv_vtable {
 struct level_parser_vtable {
   struct level_parser_prv_vtable const reader;
 };
+
+/* kind of level walked by the shared transition tables */
+enum level_kind {
+  /* root dataset, also used for the meta header */
+  LEVEL_ROOT = 0,
+  /* items of a sequence */
+  LEVEL_ITEM,
+  /* fragments of an encapsulated Pixel Data */
+  LEVEL_FRAGMENTS,
+};
+
+/* end position of an undefined length sequence or item */
+#define POS_UNDEFINED UINT64_MAX
+
 struct level_parser {
   struct key_info da;
 
+  /* absolute end position of a defined length sequence, and of the current
+   * defined length item. POS_UNDEFINED when delimited */
+  uint64_t sq_end;
+  uint64_t item_end;
+  /* number of items started so far in the sequence */
+  uint32_t item_count;
+  /* first private block reserved in the current item, see dicm_parser.c */
+  uint32_t private_base;
+  /* selects the transition table */
+  enum level_kind kind;
+
   struct level_parser_vtable const *vtable;
 };
 
+/* Transition tables (see dicm_item.c)
+ *
+ * For each level kind, a state selects which token to read next (key or
+ * value), then the pair (state, token) selects the new state. A zero entry,
+ * that is STATE_INIT, stands for an invalid transition.
+ */
+enum {
+  NUM_STATES = STATE_ENDSEQUENCE + 1,
+  NUM_TOKENS = TOKEN_INVALID_DATA + 1,
+};
+
+enum level_read {
+  /* no transition from this state */
+  READ_NONE = 0,
+  READ_KEY,
+  READ_VALUE,
+};
+
+extern const unsigned char level_reads[][NUM_STATES];
+extern const signed char level_transitions[][NUM_STATES][NUM_TOKENS];
+
+typedef enum token (*level_token_fn)(struct level_parser *self,
+                                     struct dicm_src *src);
+
+static inline enum state
+level_parser_transition(struct level_parser *self,
+                        const enum state current_state, struct dicm_src *src,
+                        const level_token_fn read_key,
+                        const level_token_fn read_value) {
+  if ((unsigned)current_state >= NUM_STATES) {
+    return STATE_INVALID;
+  }
+  const enum level_kind kind = self->kind;
+  enum token next;
+  switch (level_reads[kind][current_state]) {
+  case READ_KEY:
+    next = read_key(self, src);
+    break;
+  case READ_VALUE:
+    next = read_value(self, src);
+    break;
+  default:
+    return STATE_INVALID;
+  }
+  assert((unsigned)next < NUM_TOKENS);
+  const enum state new_state = level_transitions[kind][current_state][next];
+  return new_state != STATE_INIT ? new_state : STATE_INVALID;
+}
+
+/* Instantiate the fp_next_event of a structure: the key and value readers are
+ * called directly so that they can be inlined */
+#define LEVEL_PARSER_NEXT_EVENT(name, read_key, read_value)                    \
+  static inline enum state name(struct level_parser *self,                     \
+                                const enum state current_state,                \
+                                struct dicm_src *src) {                        \
+    return level_parser_transition(self, current_state, src, read_key,         \
+                                   read_value);                                \
+  }
+
 // FIXME: rename to onelevel_writer or nested_emitter or sublevel_emitter
 struct level_emitter;
 struct level_emitter_prv_vtable {
@@ -219,6 +304,7 @@ static inline dicm_tag_t dicm_tag_set_element(const dicm_tag_t tag,
 }
 
 enum SPECIAL_TAGS {
+  TAG_EXTENDED_OFFSET_TABLE = MAKE_TAG(0x7fe0, 0x0001),
   TAG_PIXELDATA = MAKE_TAG(0x7fe0, 0x0010),
   TAG_STARTITEM = MAKE_TAG(0xfffe, 0xe000),
   TAG_ENDITEM = MAKE_TAG(0xfffe, 0xe00d),
@@ -1,13 +1,35 @@
 #include "dicm_parser.h"
 
+#include "dicm_configure.h"
+#include "dicm_index.h"
 #include "dicm_item.h"
+#include "dicm_log.h"
+#include "dicm_private_dict.h"
+#include "dicm_reader.h"
 #include "dicm_src.h"
+#include "dicm_swap.h"
 
 #include <assert.h> /* assert */
+#include <limits.h> /* INT_MAX */
+#include <stdio.h>  /* SEEK_CUR */
 #include <stdlib.h> /* malloc */
+#include <string.h> /* memcmp */
 
 // FIXME I need to define a name without spaces:
 typedef struct level_parser level_parser_t;
+
+/* (gggg,xx00-xxff) reserved by a private creator of the current item */
+struct private_block {
+  uint16_t group;
+  uint8_t block;
+  /* PRIVATE_CREATOR_UNKNOWN when not in the private dictionary */
+  uint32_t creator;
+};
+typedef struct private_block private_block_t;
+
+/* LO value of a private creator */
+enum { CREATOR_MAX_LENGTH = 64 };
+
 struct parser {
   struct dicm_parser parser;
   /* data */
@@ -19,6 +41,77 @@ struct parser {
   /* current pos in value_length */
   uint32_t value_length_pos;
 
+  /* absolute position of the next byte to parse */
+  uint64_t pos;
+  /* explicit or implicit VR keys, for position accounting */
+  bool explicit_vr;
+  bool big_endian;
+
+  /* optional offset index, and tag path scratch */
+  struct dicm_index *index;
+  uint32_t *path;
+  size_t path_capacity;
+
+  /* frame offsets of the current encapsulated Pixel Data, relative to the
+   * first fragment following the Basic Offset Table */
+  uint64_t *frames;
+  size_t frames_capacity;
+  uint32_t frame_count;
+  bool frames_loaded;
+  uint64_t frame_base;
+  /* root level Extended Offset Table value, if any */
+  uint64_t eot_pos;
+  uint32_t eot_length;
+
+  /* optional private dictionary, blocks reserved by the creators of all
+   * levels (see level_parser::private_base), and the creator value being
+   * read */
+  struct dicm_private_dict *private_dict;
+  array(private_block_t) * private_blocks;
+  char creator[CREATOR_MAX_LENGTH];
+
+  /* root level filter: stop tag and sorted set of wanted tags */
+  uint32_t max_tag;
+  const uint32_t *wanted_tags;
+  size_t wanted_count;
+  size_t wanted_pos;
+
+  /* Part 10: File Meta Information is parsed from memory, then the user
+   * input is restored and parsed with the selected structure */
+  bool part10;
+  struct dicm_src *meta_src;
+  struct dicm_src *input;
+  enum dicm_structure_type dataset_structure;
+  void *meta;
+  size_t meta_size;
+
+  /* structure of the specialized level transitions, -1 to dispatch through
+   * the level parser vtable */
+  int fast_structure;
+
+  /* push mode: input fed by the application, and the parser state to roll
+   * back to when an event cannot be completed */
+  struct dicm_src *push_src;
+  struct push_mark {
+    enum state state;
+    uint32_t value_length_pos;
+    uint64_t pos;
+    size_t wanted_pos;
+    struct key_info da;
+  } mark;
+
+  /* values of dicm_parser_read_bytes() in host byte order, and the number
+   * split by the end of the previous chunk */
+  bool host_order;
+  uint64_t swap_carry;
+
+  /* fallback storage for borrowed bytes (non-contiguous sources) */
+  void *buffer;
+  size_t buffer_size;
+  /* copies of inline values of dicm_parser_next_events() */
+  char *batch;
+  size_t batch_size;
+
   /* level parsers */
   array(level_parser_t) * level_parsers;
 };
@@ -30,6 +123,15 @@ static DICM_CHECK_RETURN int parser_get_value_length(struct dicm_parser *,
                                                      uint32_t *) DICM_NONNULL();
 static DICM_CHECK_RETURN int parser_read_value(struct dicm_parser *, void *,
                                                size_t) DICM_NONNULL();
+static DICM_CHECK_RETURN int parser_borrow_value(struct dicm_parser *,
+                                                 const void **, size_t)
+    DICM_NONNULL();
+static DICM_CHECK_RETURN int parser_skip_value(struct dicm_parser *)
+    DICM_NONNULL();
+static DICM_CHECK_RETURN int parser_skip_bytes(struct parser *, uint64_t)
+    DICM_NONNULL();
+static DICM_CHECK_RETURN int parser_reserve_buffer(struct parser *, size_t)
+    DICM_NONNULL();
 
 static struct parser_vtable const g_vtable = {
     /* object interface */
@@ -55,6 +157,149 @@ static inline bool parser_is_root_dataset(const struct parser *self) {
   return self->level_parsers->size == 1;
 }
 
+/* push mode: fewer than len bytes were fed so far */
+static inline bool parser_lacks_input(const struct parser *parser,
+                                      const size_t len) {
+  const void *ptr;
+  return parser->push_src && parser->src == parser->push_src &&
+         src_push_peek(parser->push_src, &ptr) < len;
+}
+
+/* bytes of the current value left to read */
+static inline uint32_t parser_get_remaining(struct parser *parser) {
+  return parser_get_level_parser(parser)->da.vl - parser->value_length_pos;
+}
+
+/* private creator values are recorded when there is a private dictionary */
+static inline bool parser_is_creator(const struct parser *parser,
+                                     const struct key_info *da) {
+  const uint_fast16_t element = dicm_tag_get_element(da->tag);
+  return parser->private_dict && dicm_tag_is_private(da->tag) &&
+         element >= 0x0010 && element <= 0x00ff &&
+         da->vl <= CREATOR_MAX_LENGTH;
+}
+
+/* copy the next chunk of a creator value, the block is reserved once the
+ * value is complete */
+static void parser_capture_creator(struct parser *parser, const void *ptr,
+                                   const uint32_t len) {
+  const struct key_info *da = &parser_get_level_parser(parser)->da;
+  memcpy(parser->creator + parser->value_length_pos, ptr, len);
+  if (parser->value_length_pos + len != da->vl) {
+    return;
+  }
+  const struct private_block block = {
+      .group = (uint16_t)dicm_tag_get_group(da->tag),
+      .block = (uint8_t)dicm_tag_get_element(da->tag),
+      .creator = private_dict_find_creator(parser->private_dict,
+                                           parser->creator, da->vl)};
+  array_push(parser->private_blocks, block);
+}
+
+/* implicit VR: a private data element gets the VR of its creator entry */
+static void parser_resolve_private(struct parser *parser,
+                                   struct level_parser *level) {
+  struct key_info *da = &level->da;
+  const uint_fast16_t element = dicm_tag_get_element(da->tag);
+  if (!parser->private_dict || da->vr != VR_NONE ||
+      !dicm_tag_is_private(da->tag) || element < 0x1000) {
+    return;
+  }
+  const uint_fast16_t group = dicm_tag_get_group(da->tag);
+  /* most recent reservation of the current item first */
+  for (size_t i = parser->private_blocks->size; i > level->private_base; --i) {
+    const struct private_block *block =
+        array_ref(parser->private_blocks, i - 1);
+    if (block->group == group && block->block == element >> 8u) {
+      if (block->creator != PRIVATE_CREATOR_UNKNOWN) {
+        da->vr = private_dict_get_vr(parser->private_dict, block->creator,
+                                     group, element & 0xffu);
+      }
+      return;
+    }
+  }
+}
+
+/* size of the numbers of the current value to swap for host order reads, 1
+ * when bytes are returned as is */
+static inline uint32_t parser_swap_size(struct parser *parser) {
+  const struct level_parser *level = parser_get_level_parser(parser);
+  const bool big_endian_host = __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;
+  if (!parser->host_order || parser->big_endian == big_endian_host ||
+      level->kind == LEVEL_FRAGMENTS || !_vr_needs_swap(level->da.vr)) {
+    return 1;
+  }
+  const uint32_t size = _vr_get_size(level->da.vr);
+  /* truncated number: bytes as is */
+  return level->da.vl % size == 0 ? size : 1;
+}
+
+/* bytes of the swap carry not returned yet, they were already read from the
+ * source */
+static inline uint32_t parser_swap_pending(struct parser *parser) {
+  const uint32_t size = parser_swap_size(parser);
+  const uint32_t phase = parser->value_length_pos % size;
+  return phase != 0 ? size - phase : 0;
+}
+
+/* bytes to read from the source for a host order read of len bytes */
+static inline size_t parser_swap_need(struct parser *parser, const size_t len,
+                                      const uint32_t size) {
+  const uint32_t pending = parser_swap_pending(parser);
+  const uint32_t remaining = parser_get_remaining(parser);
+  const uint32_t to_read = len < remaining ? (uint32_t)len : remaining;
+  if (to_read <= pending) {
+    return 0;
+  }
+  return (to_read - pending + size - 1) / size * size;
+}
+
+/* host order read. A number split by the end of the chunk is read as a
+ * whole, its remaining bytes are returned by the next call */
+static int parser_read_swapped(struct parser *parser, unsigned char *b,
+                               const size_t s, const uint32_t size) {
+  const swap_kernel_t swap = swap_get_kernel(size);
+  struct dicm_src *src = parser->src;
+  unsigned char *carry = (unsigned char *)&parser->swap_carry;
+  const uint32_t remaining = parser_get_remaining(parser);
+  const uint32_t len = s < remaining ? (uint32_t)s : remaining;
+  const uint32_t phase = parser->value_length_pos % size;
+  uint32_t done = 0;
+  if (phase != 0) {
+    done = len < size - phase ? len : size - phase;
+    memcpy(b, carry + phase, done);
+  }
+  const uint32_t body = (len - done) / size * size;
+  if (body != 0) {
+    /* sources want aligned buffers, go through the fallback storage after
+     * the end of a split number */
+    const bool aligned = is_aligned(b + done, 4);
+    if (!aligned && parser_reserve_buffer(parser, body) < 0) {
+      return -1;
+    }
+    unsigned char *out = aligned ? b + done : parser->buffer;
+    if (dicm_src_read(src, out, body) != (int64_t)body) {
+      parser->current_item_state = STATE_INVALID;
+      return -1;
+    }
+    swap(out, body);
+    if (!aligned) {
+      memcpy(b + done, out, body);
+    }
+    done += body;
+  }
+  if (done != len) {
+    if (dicm_src_read(src, carry, size) != (int64_t)size) {
+      parser->current_item_state = STATE_INVALID;
+      return -1;
+    }
+    swap(carry, size);
+    memcpy(b + done, carry, len - done);
+  }
+  parser->value_length_pos += len;
+  return 0;
+}
+
 int dicm_parser_get_key(struct dicm_parser *self, struct dicm_key *key) {
   struct parser *parser = (struct parser *)self;
   const enum state cur_state = parser_get_state(parser);
@@ -93,14 +338,117 @@ int dicm_parser_read_bytes(struct dicm_parser *self, void *ptr, size_t len) {
 #if 0
   return dicm_parser_read_value1(self, ptr, len);
 #else
-    return parser_read_value(self, ptr, len);
+    const uint32_t vl = parser_get_level_parser(parser)->da.vl;
+    const uint32_t size = parser_swap_size(parser);
+    const size_t need = size == 1 ? (len < vl ? len : vl)
+                                  : parser_swap_need(parser, len, size);
+    if (parser_lacks_input(parser, need)) {
+      return DICM_NEED_MORE_DATA;
+    }
+    const int ret = size == 1 ? parser_read_value(self, ptr, len)
+                              : parser_read_swapped(parser, ptr, len, size);
+    if (ret == 0 && parser->src == parser->push_src) {
+      /* copied out, release on the next feed */
+      src_push_set_mark(parser->src);
+    }
+    return ret;
 #endif
   }
   return -1;
 }
 
+int dicm_parser_borrow_bytes(struct dicm_parser *self, const void **pptr,
+                             size_t len) {
+  struct parser *parser = (struct parser *)self;
+  const enum state cur_state = parser_get_state(parser);
+  if (cur_state == STATE_VALUE) {
+    const uint32_t remaining = parser_get_remaining(parser);
+    if (parser_swap_pending(parser) != 0) {
+      /* in the middle of a number read in host order */
+      return -1;
+    }
+    if (parser_lacks_input(parser, len < remaining ? len : remaining)) {
+      return DICM_NEED_MORE_DATA;
+    }
+    return parser_borrow_value(self, pptr, len);
+  }
+  return -1;
+}
+
+int dicm_parser_skip_sequence(struct dicm_parser *self) {
+  struct parser *parser = (struct parser *)self;
+  const enum state cur_state = parser_get_state(parser);
+  if (cur_state != STATE_STARTSEQUENCE) {
+    return -1;
+  }
+  struct level_parser *level_parser = parser_get_level_parser(parser);
+  const uint64_t sq_end = level_parser->sq_end;
+  if (sq_end == POS_UNDEFINED) {
+    /* delimited: cannot be skipped without parsing */
+    return -1;
+  }
+  if (parser_lacks_input(parser, sq_end - parser->pos)) {
+    /* discard what was fed so far, resume on the next call */
+    const void *ptr;
+    const size_t avail = src_push_peek(parser->src, &ptr);
+    if (dicm_src_borrow(parser->src, &ptr, avail) != (int64_t)avail) {
+      parser->current_item_state = STATE_INVALID;
+      return -1;
+    }
+    parser->pos += avail;
+    src_push_set_mark(parser->src);
+    return DICM_NEED_MORE_DATA;
+  }
+  if (parser_skip_bytes(parser, sq_end - parser->pos) < 0) {
+    parser->current_item_state = STATE_INVALID;
+    return -1;
+  }
+  /* next event is the end of the sequence */
+  parser->pos = sq_end;
+  return 0;
+}
+
+int dicm_parser_skip_value(struct dicm_parser *self) {
+  struct parser *parser = (struct parser *)self;
+  const enum state cur_state = parser_get_state(parser);
+  if (cur_state == STATE_VALUE) {
+    /* rest of a number read in host order, already consumed */
+    parser->value_length_pos += parser_swap_pending(parser);
+    const uint32_t remaining = parser_get_remaining(parser);
+    if (parser_lacks_input(parser, remaining)) {
+      /* discard what was fed so far, resume on the next call */
+      const void *ptr;
+      const uint32_t avail = (uint32_t)src_push_peek(parser->src, &ptr);
+      if (dicm_src_borrow(parser->src, &ptr, avail) != (int64_t)avail) {
+        parser->current_item_state = STATE_INVALID;
+        return -1;
+      }
+      if (parser_is_creator(parser, &parser_get_level_parser(parser)->da)) {
+        parser_capture_creator(parser, ptr, avail);
+      }
+      parser->value_length_pos += avail;
+      src_push_set_mark(parser->src);
+      return DICM_NEED_MORE_DATA;
+    }
+    return parser_skip_value(self);
+  }
+  return -1;
+}
+
 int parser_destroy(struct object *const self) {
   struct parser *parser = (struct parser *)self;
+  if (parser->meta_src) {
+    dicm_delete(parser->meta_src);
+  }
+  free(parser->meta);
+  free(parser->path);
+  free(parser->frames);
+  if (parser->push_src) {
+    dicm_delete(parser->push_src);
+  }
+  free(parser->buffer);
+  free(parser->batch);
+  array_free(parser->private_blocks);
   array_free(parser->level_parsers);
   free(parser);
   return 0;
@@ -124,10 +472,21 @@ int parser_get_value_length(struct dicm_parser *const self, uint32_t *len) {
 struct level_parser get_new_reader_ds();
 struct level_parser get_new_ivrle_reader_ds();
 struct level_parser get_new_evrle_reader_ds();
+struct level_parser get_new_evrle_reader_meta();
 struct level_parser get_new_evrbe_reader_ds();
 struct level_parser get_new_reader_item();
 struct level_parser get_new_reader_frag();
 
+static inline void parser_push_level(struct parser *parser,
+                                     struct level_parser new_item,
+                                     const uint64_t sq_end) {
+  new_item.sq_end = sq_end;
+  new_item.item_end = POS_UNDEFINED;
+  new_item.item_count = 0;
+  new_item.private_base = (uint32_t)parser->private_blocks->size;
+  array_push(parser->level_parsers, new_item);
+}
+
 static inline void push_ds_reader(struct parser *parser,
                                   const enum state current_state) {
   assert(current_state == STATE_INVALID);
@@ -135,7 +494,7 @@ static inline void push_ds_reader(struct parser *parser,
 
   parser->value_length_pos = VL_UNDEFINED;
   struct level_parser new_item = get_new_reader_ds();
-  array_push(parser->level_parsers, new_item);
+  parser_push_level(parser, new_item, POS_UNDEFINED);
   assert(parser_is_root_dataset(parser));
 }
 
@@ -146,7 +505,7 @@ static inline void push_ds_implicit_reader(struct parser *parser,
 
   parser->value_length_pos = VL_UNDEFINED;
   struct level_parser new_item = get_new_ivrle_reader_ds();
-  array_push(parser->level_parsers, new_item);
+  parser_push_level(parser, new_item, POS_UNDEFINED);
   assert(parser_is_root_dataset(parser));
 }
 
@@ -157,7 +516,7 @@ static inline void push_ds_explicit_reader(struct parser *parser,
 
   parser->value_length_pos = VL_UNDEFINED;
   struct level_parser new_item = get_new_evrle_reader_ds();
-  array_push(parser->level_parsers, new_item);
+  parser_push_level(parser, new_item, POS_UNDEFINED);
   assert(parser_is_root_dataset(parser));
 }
 
@@ -168,7 +527,18 @@ static inline void push_ds_evrbe_reader(struct parser *parser,
 
   parser->value_length_pos = VL_UNDEFINED;
   struct level_parser new_item = get_new_evrbe_reader_ds();
-  array_push(parser->level_parsers, new_item);
+  parser_push_level(parser, new_item, POS_UNDEFINED);
+  assert(parser_is_root_dataset(parser));
+}
+
+static inline void push_meta_reader(struct parser *parser,
+                                    const enum state current_state) {
+  assert(current_state == STATE_INVALID);
+  parser->current_item_state = current_state;
+
+  parser->value_length_pos = VL_UNDEFINED;
+  struct level_parser new_item = get_new_evrle_reader_meta();
+  parser_push_level(parser, new_item, POS_UNDEFINED);
   assert(parser_is_root_dataset(parser));
 }
 
@@ -178,53 +548,138 @@ static inline void push_ds_evrbe_reader(struct parser *parser,
 static inline void push_level_parser(struct parser *parser,
                                      const enum state current_state) {
   struct level_parser *level_parser = parser_get_level_parser(parser);
+  const uint32_t vl = level_parser->da.vl;
   struct level_parser new_item =
       level_parser_next_level(level_parser, current_state);
-  array_push(parser->level_parsers, new_item);
+  parser_push_level(parser, new_item,
+                    dicm_vl_is_undefined(vl) ? POS_UNDEFINED
+                                             : parser->pos + vl);
 }
 
 static inline void push_fragments_reader(struct parser *parser) {
+#ifdef DICM_ENABLE_STRUCTURE_ENCAPSULATED
+  /* new Pixel Data, the offset table is read on demand */
+  parser->frames_loaded = false;
   struct level_parser new_item = get_new_reader_frag();
-  array_push(parser->level_parsers, new_item);
+  parser_push_level(parser, new_item, POS_UNDEFINED);
+#else
+  /* only reported by the encapsulated structure */
+  assert(0);
+#endif
 }
 
 static inline void pop_level_parser(struct parser *parser) {
+  /* reservations of the sequence items end with it */
+  parser->private_blocks->size = parser_get_level_parser(parser)->private_base;
   (void)array_pop(parser->level_parsers);
 }
 
-/* public API */
-int dicm_parser_set_input(struct dicm_parser *self, const int structure_type,
-                          struct dicm_src *src) {
-  struct parser *parser = (struct parser *)self;
-  // clear any previous run:
-  parser->level_parsers->size = 0;
-  // update ready state:
-  parser->src = src;
+static enum state push_root_reader(struct parser *parser,
+                                   const enum dicm_structure_type estype) {
   enum state new_state = STATE_INVALID;
-  const enum dicm_structure_type estype = structure_type;
+  parser->explicit_vr = estype != DICM_STRUCTURE_IMPLICIT;
+  parser->big_endian = estype == DICM_STRUCTURE_EXPLICIT_BE;
   switch (estype) {
+#ifdef DICM_ENABLE_STRUCTURE_ENCAPSULATED
   case DICM_STRUCTURE_ENCAPSULATED:
     push_ds_reader(parser, STATE_INVALID);
     new_state = STATE_INIT;
     break;
+#endif
+#ifdef DICM_ENABLE_STRUCTURE_EXPLICT_LE
   case DICM_STRUCTURE_EXPLICIT_LE:
     push_ds_explicit_reader(parser, STATE_INVALID);
     new_state = STATE_INIT;
     break;
+#endif
+#ifdef DICM_ENABLE_STRUCTURE_EXPLICT_BE
   case DICM_STRUCTURE_EXPLICIT_BE:
     push_ds_evrbe_reader(parser, STATE_INVALID);
     new_state = STATE_INIT;
     break;
+#endif
+#ifdef DICM_ENABLE_STRUCTURE_IMPLICT
   case DICM_STRUCTURE_IMPLICIT:
     push_ds_implicit_reader(parser, STATE_INVALID);
     new_state = STATE_INIT;
     break;
+#endif
+#ifdef DICM_ENABLE_STRUCTURE_EXPLICT_LE
+  case DICM_STRUCTURE_PART10:
+    /* File Meta Information is always explicit little endian */
+    push_meta_reader(parser, STATE_INVALID);
+    new_state = STATE_INIT;
+    break;
+#endif
   default:;
   }
+  return new_state;
+}
+
+/* public API */
+int dicm_parser_set_input(struct dicm_parser *self, const int structure_type,
+                          struct dicm_src *src) {
+  struct parser *parser = (struct parser *)self;
+  // clear any previous run:
+  parser->level_parsers->size = 0;
+  parser->private_blocks->size = 0;
+  if (parser->meta_src) {
+    dicm_delete(parser->meta_src);
+    parser->meta_src = NULL;
+  }
+  parser->input = NULL;
+  if (parser->push_src && src != parser->push_src) {
+    dicm_delete(parser->push_src);
+    parser->push_src = NULL;
+  }
+  // update ready state:
+  parser->src = src;
+  parser->pos = 0;
+  parser->eot_length = 0;
+  parser->frames_loaded = false;
+  parser->wanted_pos = 0;
+  parser->fast_structure = -1;
+  if (parser->index) {
+    index_clear(parser->index);
+  }
+  const enum dicm_structure_type estype = structure_type;
+  parser->part10 = estype == DICM_STRUCTURE_PART10;
+  const enum state new_state = push_root_reader(parser, estype);
   parser->current_item_state = new_state;
   return new_state;
 }
 
+static int parser_set_input_fast(struct dicm_parser *self,
+                                 const enum dicm_structure_type estype,
+                                 struct dicm_src *src) {
+  if (dicm_parser_set_input(self, estype, src) < 0) {
+    return -1;
+  }
+  struct parser *parser = (struct parser *)self;
+  parser->fast_structure = estype;
+  return 0;
+}
+
+int dicm_parser_set_input_encap_fast(struct dicm_parser *self,
+                                     struct dicm_src *src) {
+  return parser_set_input_fast(self, DICM_STRUCTURE_ENCAPSULATED, src);
+}
+
+int dicm_parser_set_input_ivrle_fast(struct dicm_parser *self,
+                                     struct dicm_src *src) {
+  return parser_set_input_fast(self, DICM_STRUCTURE_IMPLICIT, src);
+}
+
+int dicm_parser_set_input_evrle_fast(struct dicm_parser *self,
+                                     struct dicm_src *src) {
+  return parser_set_input_fast(self, DICM_STRUCTURE_EXPLICIT_LE, src);
+}
+
+int dicm_parser_set_input_evrbe_fast(struct dicm_parser *self,
+                                     struct dicm_src *src) {
+  return parser_set_input_fast(self, DICM_STRUCTURE_EXPLICIT_BE, src);
+}
+
 int parser_read_value(struct dicm_parser *const self, void *b, size_t s) {
   assert(is_aligned(b, 2U));
   struct parser *parser = (struct parser *)self;
@@ -240,15 +695,826 @@ int parser_read_value(struct dicm_parser *const self, void *b, size_t s) {
     parser->current_item_state = STATE_INVALID;
     return -1;
   }
+  if (parser_is_creator(parser, &level_parser->da)) {
+    parser_capture_creator(parser, b, to_read);
+  }
   parser->value_length_pos += to_read;
   assert(parser->value_length_pos <= level_parser->da.vl);
 
   return 0;
 }
 
+/* make sure the fallback buffer can hold len bytes */
+static int parser_reserve_buffer(struct parser *parser, const size_t len) {
+  if (len > parser->buffer_size) {
+    void *buffer = realloc(parser->buffer, len);
+    if (!buffer) {
+      return -1;
+    }
+    parser->buffer = buffer;
+    parser->buffer_size = len;
+  }
+  return 0;
+}
+
+int parser_borrow_value(struct dicm_parser *const self, const void **pptr,
+                        size_t s) {
+  struct parser *parser = (struct parser *)self;
+  struct level_parser *level_parser = parser_get_level_parser(parser);
+  const uint32_t remaining = level_parser->da.vl - parser->value_length_pos;
+  const uint32_t to_read = s < (size_t)remaining ? (uint32_t)s : remaining;
+
+  struct dicm_src *src = parser->src;
+  int64_t err = 0;
+  if (dicm_src_can_borrow(src)) {
+    /* zero-copy: point directly into the source */
+    err = dicm_src_borrow(src, pptr, to_read);
+    if (err >= 0 && err < (int64_t)to_read &&
+        parser_reserve_buffer(parser, to_read) == 0) {
+      /* larger than a read-ahead window: copy */
+      const size_t len = (size_t)err;
+      memcpy(parser->buffer, *pptr, len);
+      *pptr = parser->buffer;
+      err = dicm_src_read(src, (char *)parser->buffer + len, to_read - len);
+      err = err < 0 ? err : err + (int64_t)len;
+    }
+  } else {
+    /* fallback: copy into internal buffer */
+    if (parser_reserve_buffer(parser, to_read) < 0) {
+      parser->current_item_state = STATE_INVALID;
+      return -1;
+    }
+    *pptr = parser->buffer;
+    if (to_read != 0) {
+      err = dicm_src_read(src, parser->buffer, to_read);
+    }
+  }
+  if (err != (int64_t)to_read) {
+    parser->current_item_state = STATE_INVALID;
+    return -1;
+  }
+  if (parser_is_creator(parser, &level_parser->da)) {
+    parser_capture_creator(parser, *pptr, to_read);
+  }
+  parser->value_length_pos += to_read;
+  assert(parser->value_length_pos <= level_parser->da.vl);
+
+  return 0;
+}
+
+/* discard chunk size for non-seekable sources */
+enum { SKIP_CHUNK_SIZE = 4096 };
+
+/* move the source forward, without copy when possible */
+static int parser_skip_bytes(struct parser *parser, uint64_t len) {
+  struct dicm_src *src = parser->src;
+  if (len == 0) {
+    return 0;
+  }
+  if (src->vtable->src.fp_seek) {
+    /* seekable: a single relative seek */
+    return dicm_src_seek(src, (int64_t)len, SEEK_CUR) < 0 ? -1 : 0;
+  }
+  /* non-seekable: discard in chunks */
+  const bool can_borrow = dicm_src_can_borrow(src);
+  if (!can_borrow && parser_reserve_buffer(parser, SKIP_CHUNK_SIZE) < 0) {
+    return -1;
+  }
+  while (len != 0) {
+    const size_t chunk = len < SKIP_CHUNK_SIZE ? (size_t)len : SKIP_CHUNK_SIZE;
+    const void *ptr;
+    /* a borrow may be shorter than the chunk (read-ahead window) */
+    const int64_t err = can_borrow
+                            ? dicm_src_borrow(src, &ptr, chunk)
+                            : dicm_src_read(src, parser->buffer, chunk);
+    if (err <= 0 || (!can_borrow && err != (int64_t)chunk)) {
+      return -1;
+    }
+    len -= (uint64_t)err;
+  }
+  return 0;
+}
+
+int parser_skip_value(struct dicm_parser *const self) {
+  struct parser *parser = (struct parser *)self;
+  struct level_parser *level_parser = parser_get_level_parser(parser);
+  const uint32_t remaining = level_parser->da.vl - parser->value_length_pos;
+  if (parser_is_creator(parser, &level_parser->da)) {
+    /* small enough, read instead of skipped */
+    const void *ptr;
+    return parser_borrow_value(self, &ptr, remaining);
+  }
+  if (parser_skip_bytes(parser, remaining) < 0) {
+    parser->current_item_state = STATE_INVALID;
+    return -1;
+  }
+  parser->value_length_pos += remaining;
+  assert(parser->value_length_pos == level_parser->da.vl);
+
+  return 0;
+}
+
 #define level_parser_next_event(t, tok, src)                                   \
   ((t)->vtable->reader.fp_next_event((t), (tok), (src)))
 
+/* transition of the current level: the level parsers of dicm_reader.h are
+ * inlined here when the structure was fixed by one of the
+ * dicm_parser_set_input_*_fast() */
+static inline enum state parser_level_next_event(struct parser *parser,
+                                                 struct level_parser *level,
+                                                 const enum state state) {
+  switch (parser->fast_structure) {
+#ifdef DICM_ENABLE_STRUCTURE_ENCAPSULATED
+  case DICM_STRUCTURE_ENCAPSULATED:
+    return encap_fast_next_event(level, state, parser->src);
+#endif
+#ifdef DICM_ENABLE_STRUCTURE_IMPLICT
+  case DICM_STRUCTURE_IMPLICIT:
+    return ivrle_fast_next_event(level, state, parser->src);
+#endif
+#ifdef DICM_ENABLE_STRUCTURE_EXPLICT_LE
+  case DICM_STRUCTURE_EXPLICIT_LE:
+    return evrle_fast_next_event(level, state, parser->src);
+#endif
+#ifdef DICM_ENABLE_STRUCTURE_EXPLICT_BE
+  case DICM_STRUCTURE_EXPLICIT_BE:
+    return evrbe_fast_next_event(level, state, parser->src);
+#endif
+  default:
+    return level_parser_next_event(level, state, parser->src);
+  }
+}
+
+enum {
+  PREAMBLE_SIZE = 128,
+  /* (0002,0000) UL, explicit little endian */
+  GROUP_LENGTH_SIZE = 12,
+  /* sanity limit, File Meta Information is a few hundred bytes */
+  META_MAX_SIZE = 1 << 20,
+  /* Transfer Syntax UID is an UI, at most 64 bytes */
+  TS_MAX_SIZE = 64,
+};
+
+static inline uint32_t read_le16(const unsigned char *p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8u;
+}
+
+static inline uint32_t read_le32(const unsigned char *p) {
+  return read_le16(p) | read_le16(p + 2) << 16u;
+}
+
+/* transfer syntaxes where the data set itself is deflated */
+static const char *const deflated_ts[] = {
+    "1.2.840.10008.1.2.1.99",  /* Deflated Explicit VR Little Endian */
+    "1.2.840.10008.1.2.4.95",  /* JPIP Referenced Deflate */
+    "1.2.840.10008.1.2.4.205", /* JPIP HTJ2K Referenced Deflate */
+};
+
+static int ts_to_structure(const char *ts) {
+  if (strcmp(ts, "1.2.840.10008.1.2") == 0) {
+    return DICM_STRUCTURE_IMPLICIT;
+  } else if (strcmp(ts, "1.2.840.10008.1.2.1") == 0) {
+    return DICM_STRUCTURE_EXPLICIT_LE;
+  } else if (strcmp(ts, "1.2.840.10008.1.2.2") == 0) {
+    return DICM_STRUCTURE_EXPLICIT_BE;
+  }
+  for (size_t i = 0; i < ARRAY_LEN(deflated_ts); ++i) {
+    if (strcmp(ts, deflated_ts[i]) == 0) {
+      _log_msg(DICM_LOG_ERROR, "deflated Transfer Syntax %s not supported",
+               ts);
+      return -1;
+    }
+  }
+  /* any other standard transfer syntax is explicit little endian with
+   * encapsulated pixel data, the structure of a private one is unknown */
+  if (strncmp(ts, "1.2.840.10008.1.2.", 18) != 0) {
+    _log_msg(DICM_LOG_ERROR, "unknown Transfer Syntax %s", ts);
+    return -1;
+  }
+  return DICM_STRUCTURE_ENCAPSULATED;
+}
+
+/* walk the in-memory File Meta Information looking for (0002,0010) */
+static int meta_find_structure(const unsigned char *meta, const size_t size) {
+  size_t pos = 0;
+  while (size - pos >= 8) {
+    const unsigned char *p = meta + pos;
+    const uint32_t tag = read_le16(p) << 16u | read_le16(p + 2);
+    const dicm_vr_t vr = MAKE_VR(p[4], p[5]);
+    size_t header = 8;
+    uint32_t vl = read_le16(p + 6);
+    if (!_is_vr16(vr)) {
+      if (size - pos < 12) {
+        break;
+      }
+      header = 12;
+      vl = read_le32(p + 8);
+    }
+    if (vl > size - pos - header) {
+      break;
+    }
+    if (tag == 0x00020010) {
+      char ts[TS_MAX_SIZE + 1];
+      if (vl > TS_MAX_SIZE) {
+        break;
+      }
+      memcpy(ts, p + header, vl);
+      /* strip UI padding */
+      while (vl != 0 && (ts[vl - 1] == '\0' || ts[vl - 1] == ' ')) {
+        --vl;
+      }
+      ts[vl] = '\0';
+      return ts_to_structure(ts);
+    }
+    pos += header + vl;
+  }
+  return -1;
+}
+
+/* consume preamble, prefix and File Meta Information from the user input,
+ * then redirect the parser onto an in-memory copy of the meta group */
+static int parser_read_meta(struct parser *parser) {
+  struct dicm_src *src = parser->src;
+  uint32_t head[(PREAMBLE_SIZE + 4 + GROUP_LENGTH_SIZE) / 4];
+  const unsigned char *bytes = (const unsigned char *)head;
+  if (dicm_src_read(src, head, sizeof head) != (int64_t)sizeof head) {
+    return -1;
+  }
+  if (memcmp(bytes + PREAMBLE_SIZE, "DICM", 4) != 0) {
+    return -1;
+  }
+  const unsigned char *group_length = bytes + PREAMBLE_SIZE + 4;
+  if (memcmp(group_length, "\2\0\0\0UL\4\0", 8) != 0) {
+    return -1;
+  }
+  const uint32_t length = read_le32(group_length + 8);
+  if (length > META_MAX_SIZE) {
+    return -1;
+  }
+  const size_t meta_size = GROUP_LENGTH_SIZE + length;
+  if (meta_size > parser->meta_size) {
+    void *meta = realloc(parser->meta, meta_size);
+    if (!meta) {
+      return -1;
+    }
+    parser->meta = meta;
+    parser->meta_size = meta_size;
+  }
+  memcpy(parser->meta, group_length, GROUP_LENGTH_SIZE);
+  char *rest = (char *)parser->meta + GROUP_LENGTH_SIZE;
+  if (length != 0 && dicm_src_read(src, rest, length) != (int64_t)length) {
+    return -1;
+  }
+  const int structure = meta_find_structure(parser->meta, meta_size);
+  if (structure < 0) {
+    return -1;
+  }
+  parser->dataset_structure = structure;
+  if (dicm_src_mem_create(&parser->meta_src, parser->meta, meta_size) < 0) {
+    return -1;
+  }
+  parser->input = src;
+  parser->src = parser->meta_src;
+  parser->pos = PREAMBLE_SIZE + 4;
+  return 0;
+}
+
+/* end of File Meta Information: switch to the user input and the data set
+ * level parser */
+static int parser_end_meta(struct parser *parser) {
+  dicm_delete(parser->meta_src);
+  parser->meta_src = NULL;
+  parser->src = parser->input;
+  parser->input = NULL;
+  parser->level_parsers->size = 0;
+  return push_root_reader(parser, parser->dataset_structure) == STATE_INIT
+             ? 0
+             : -1;
+}
+
+/* push mode: remember the state an event is computed from */
+static void parser_set_mark(struct parser *parser, const enum state state) {
+  struct push_mark *mark = &parser->mark;
+  mark->state = state;
+  mark->value_length_pos = parser->value_length_pos;
+  mark->pos = parser->pos;
+  mark->wanted_pos = parser->wanted_pos;
+  mark->da = parser_get_level_parser(parser)->da;
+  src_push_set_mark(parser->push_src);
+}
+
+/* push mode: when the input ran short, restore the state saved by
+ * parser_set_mark() so that the event is computed again once more bytes are
+ * fed. Return true in that case */
+static bool parser_rewind(struct parser *parser) {
+  if (!parser->push_src || !src_push_rewind(parser->push_src)) {
+    return false;
+  }
+  const struct push_mark *mark = &parser->mark;
+  parser->current_item_state = mark->state;
+  parser->value_length_pos = mark->value_length_pos;
+  parser->pos = mark->pos;
+  parser->wanted_pos = mark->wanted_pos;
+  parser_get_level_parser(parser)->da = mark->da;
+  return true;
+}
+
+/* end of a defined length sequence or item: synthesize the delimitation
+ * event without reading. Return STATE_INIT when bytes must be read */
+static inline enum state parser_defined_end(const struct parser *parser,
+                                            const struct level_parser *level,
+                                            const enum state current_state) {
+  uint64_t end;
+  enum state end_state;
+  switch (current_state) {
+  case STATE_STARTSEQUENCE:
+  case STATE_ENDITEM:
+    end = level->sq_end;
+    end_state = STATE_ENDSEQUENCE;
+    break;
+  case STATE_STARTITEM:
+  case STATE_VALUE:
+  case STATE_ENDSEQUENCE:
+    end = level->item_end;
+    end_state = STATE_ENDITEM;
+    break;
+  default:
+    return STATE_INIT;
+  }
+  if (end == POS_UNDEFINED || parser->pos < end) {
+    return STATE_INIT;
+  }
+  /* overlong nested element */
+  return parser->pos == end ? end_state : STATE_INVALID;
+}
+
+static inline uint32_t parser_key_size(const struct parser *parser,
+                                       const struct key_info *da) {
+  return !parser->explicit_vr || _is_vr16(da->vr) ? 8 : 12;
+}
+
+/* account for the bytes consumed by the level parser to reach new_state */
+static inline void parser_advance(struct parser *parser,
+                                  struct level_parser *level,
+                                  const enum state new_state) {
+  const struct key_info *da = &level->da;
+  switch (new_state) {
+  case STATE_KEY:
+    parser->pos += parser_key_size(parser, da);
+    if (da->tag == TAG_EXTENDED_OFFSET_TABLE && parser_is_root_dataset(parser) &&
+        !dicm_vl_is_undefined(da->vl)) {
+      /* remember where it is, in case the Basic Offset Table is empty */
+      parser->eot_pos = parser->pos;
+      parser->eot_length = da->vl;
+    }
+    break;
+  case STATE_STARTITEM:
+    parser->pos += 8;
+    level->item_count++;
+    /* reservations of the previous item end with it */
+    parser->private_blocks->size = level->private_base;
+    level->item_end =
+        dicm_vl_is_undefined(da->vl) ? POS_UNDEFINED : parser->pos + da->vl;
+    break;
+  case STATE_ENDITEM:
+  case STATE_ENDSEQUENCE:
+  case STATE_FRAGMENT:
+    parser->pos += 8;
+    break;
+  case STATE_VALUE:
+    /* value bytes are consumed before the next event */
+    parser->pos += da->vl;
+    break;
+  default:;
+  }
+}
+
+/* push mode: level parsers expect complete keys, check that the next one (if
+ * any is read from current_state) has been fed */
+static bool parser_lacks_key(struct parser *parser,
+                             const enum state current_state) {
+  if (current_state == STATE_KEY || current_state == STATE_FRAGMENT) {
+    /* value token, nothing is read */
+    return false;
+  }
+  const unsigned char *p;
+  const size_t avail = src_push_peek(parser->push_src, (const void **)&p);
+  if (avail < 8) {
+    return true;
+  }
+  if (!parser->explicit_vr || avail >= 12) {
+    return false;
+  }
+  const uint32_t group = parser->big_endian ? (uint32_t)p[0] << 8u | p[1]
+                                            : (uint32_t)p[1] << 8u | p[0];
+  uint16_t vr16;
+  memcpy(&vr16, p + 4, sizeof vr16);
+  /* items have no VR, long VR keys are 12 bytes */
+  return group != 0xfffe && !_is_vr16(vr16);
+}
+
+/* next state of the current level, crossing the meta / data set boundary */
+static enum state parser_next_state(struct parser *parser,
+                                    const enum state current_state) {
+  struct level_parser *level_parser = parser_get_level_parser(parser);
+  const enum state end_state =
+      parser_defined_end(parser, level_parser, current_state);
+  if (end_state != STATE_INIT) {
+    return end_state;
+  }
+  if (parser->src == parser->push_src &&
+      parser_lacks_key(parser, current_state)) {
+    src_push_set_starved(parser->push_src);
+    return STATE_INVALID;
+  }
+  enum state new_state =
+      parser_level_next_event(parser, level_parser, current_state);
+  if (new_state == STATE_ENDDOCUMENT && parser->meta_src) {
+    if (parser_end_meta(parser) < 0) {
+      return STATE_INVALID;
+    }
+    if (parser->push_src) {
+      /* the meta group is not read again */
+      parser_set_mark(parser, STATE_STARTDOCUMENT);
+      if (parser_lacks_key(parser, STATE_STARTDOCUMENT)) {
+        src_push_set_starved(parser->push_src);
+        return STATE_INVALID;
+      }
+    }
+    level_parser = parser_get_level_parser(parser);
+    new_state =
+        parser_level_next_event(parser, level_parser, STATE_STARTDOCUMENT);
+  }
+  parser_advance(parser, level_parser, new_state);
+  if (new_state == STATE_KEY) {
+    parser_resolve_private(parser, level_parser);
+  }
+  return new_state;
+}
+
+static inline bool parser_has_filter(const struct parser *parser) {
+  return parser->max_tag != UINT32_MAX || parser->wanted_count != 0;
+}
+
+static inline bool parser_is_past_last_tag(const struct parser *parser,
+                                           const uint32_t tag) {
+  if (tag > parser->max_tag) {
+    return true;
+  }
+  return parser->wanted_count != 0 &&
+         tag > parser->wanted_tags[parser->wanted_count - 1];
+}
+
+static inline bool parser_is_wanted(struct parser *parser, const uint32_t tag) {
+  if (parser->wanted_count == 0) {
+    return true;
+  }
+  /* both wanted tags and root level keys are sorted, advance the cursor */
+  size_t pos = parser->wanted_pos;
+  while (pos < parser->wanted_count && parser->wanted_tags[pos] < tag) {
+    ++pos;
+  }
+  parser->wanted_pos = pos;
+  return pos < parser->wanted_count && parser->wanted_tags[pos] == tag;
+}
+
+/* apply root level filter on a freshly read key. Unwanted elements and
+ * sequences with a defined length are skipped, elements of undefined length
+ * cannot be skipped without parsing them and are reported */
+static enum state parser_filter_key(struct parser *parser) {
+  for (;;) {
+    const struct key_info *da = &parser_get_level_parser(parser)->da;
+    if (parser_is_past_last_tag(parser, da->tag)) {
+      /* ascending tag order: nothing left can match */
+      return STATE_ENDDOCUMENT;
+    }
+    if (parser_is_wanted(parser, da->tag) || dicm_vl_is_undefined(da->vl)) {
+      return STATE_KEY;
+    }
+    const uint32_t vl = da->vl;
+    enum state new_state = parser_next_state(parser, STATE_KEY);
+    if (new_state == STATE_STARTSEQUENCE) {
+      /* defined length sequence, resume as if it was parsed */
+      if (parser_skip_bytes(parser, vl) < 0) {
+        return STATE_INVALID;
+      }
+      parser->pos += vl;
+      new_state = parser_next_state(parser, STATE_ENDSEQUENCE);
+      if (new_state != STATE_KEY) {
+        return new_state;
+      }
+      continue;
+    }
+    if (new_state != STATE_VALUE) {
+      return new_state;
+    }
+    parser->current_item_state = STATE_VALUE;
+    parser->value_length_pos = 0;
+    if (parser_skip_value(&parser->parser) < 0) {
+      return STATE_INVALID;
+    }
+    new_state = parser_next_state(parser, STATE_VALUE);
+    if (new_state != STATE_KEY) {
+      return new_state;
+    }
+  }
+}
+
+/* record the current key, its path is made of the sequence tags and item
+ * numbers of the enclosing levels */
+static int parser_index_key(struct parser *parser) {
+  const size_t nlevels = parser->level_parsers->size;
+  const size_t len = 2 * nlevels - 1;
+  if (len > parser->path_capacity) {
+    uint32_t *path = realloc(parser->path, len * sizeof *path);
+    if (!path) {
+      return -1;
+    }
+    parser->path = path;
+    parser->path_capacity = len;
+  }
+  uint32_t *path = parser->path;
+  for (size_t i = 0; i + 1 < nlevels; ++i) {
+    path[2 * i] = array_at(parser->level_parsers, i).da.tag;
+    path[2 * i + 1] = array_at(parser->level_parsers, i + 1).item_count - 1;
+  }
+  const struct key_info *da = &array_back(parser->level_parsers).da;
+  path[len - 1] = da->tag;
+  const struct dicm_index_entry entry = {
+      .key_offset = parser->pos - parser_key_size(parser, da),
+      .value_offset = parser->pos,
+      .vl = da->vl,
+      .vr = da->vr};
+  index_insert(parser->index, path, len, &entry);
+  return 0;
+}
+
+static int parser_reserve_frames(struct parser *parser, const size_t count) {
+  if (count > parser->frames_capacity) {
+    uint64_t *frames = realloc(parser->frames, count * sizeof *frames);
+    if (!frames) {
+      return -1;
+    }
+    parser->frames = frames;
+    parser->frames_capacity = count;
+  }
+  return 0;
+}
+
+/* read the Extended Offset Table back, only possible on a seekable source */
+static int parser_read_eot(struct parser *parser) {
+  struct dicm_src *src = parser->src;
+  const uint32_t length = parser->eot_length;
+  const uint32_t count = length / 8;
+  if (!src->vtable->src.fp_seek || count == 0 ||
+      parser_reserve_frames(parser, count) < 0) {
+    return -1;
+  }
+  const int64_t back = (int64_t)(parser->pos - parser->eot_pos);
+  if (dicm_src_seek(src, -back, SEEK_CUR) < 0) {
+    return -1;
+  }
+  const int64_t size = (int64_t)count * 8;
+  if (dicm_src_read(src, parser->frames, (size_t)size) != size ||
+      dicm_src_seek(src, back - size, SEEK_CUR) < 0) {
+    return -1;
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    const unsigned char *p = (const unsigned char *)&parser->frames[i];
+    parser->frames[i] = read_le32(p) | (uint64_t)read_le32(p + 4) << 32u;
+  }
+  parser->frame_count = count;
+  return 0;
+}
+
+/* true when a fragment starts with a JPEG (also JPEG-LS) SOI, a JPEG 2000
+ * codestream (SOC then SIZ) or a JP2 signature box */
+static bool is_frame_start(const unsigned char *p, const size_t len) {
+  static const unsigned char jpeg[] = {0xff, 0xd8, 0xff};
+  static const unsigned char j2k[] = {0xff, 0x4f, 0xff, 0x51};
+  static const unsigned char jp2[] = {0, 0, 0, 0x0c, 'j', 'P', ' ', ' '};
+  return (len >= sizeof jpeg && memcmp(p, jpeg, sizeof jpeg) == 0) ||
+         (len >= sizeof j2k && memcmp(p, j2k, sizeof j2k) == 0) ||
+         (len >= sizeof jp2 && memcmp(p, jp2, sizeof jp2) == 0);
+}
+
+/* no offset table: walk the fragment headers and start a new frame on each
+ * fragment opening a codestream. Only the first bytes of each fragment are
+ * read, then the source is moved back to the first fragment */
+static int parser_scan_frames(struct parser *parser) {
+  struct dicm_src *src = parser->src;
+  if (!src->vtable->src.fp_seek) {
+    return -1;
+  }
+  unsigned char buf[16];
+  uint64_t offset = 0;
+  uint32_t count = 0;
+  for (;;) {
+    if (dicm_src_read(src, buf, 8) != 8) {
+      return -1;
+    }
+    const uint32_t tag = read_le16(buf) << 16u | read_le16(buf + 2);
+    const uint32_t length = read_le32(buf + 4);
+    offset += 8;
+    if (dicm_tag_is_end_sq_item(tag)) {
+      break;
+    }
+    if (!dicm_tag_is_start_item(tag) || dicm_vl_is_undefined(length)) {
+      return -1;
+    }
+    const size_t len = length < 8 ? length : 8;
+    if (dicm_src_read(src, buf + 8, len) != (int64_t)len) {
+      return -1;
+    }
+    if (count == 0 || is_frame_start(buf + 8, len)) {
+      if (parser_reserve_frames(parser, count + 1) < 0) {
+        return -1;
+      }
+      parser->frames[count++] = offset - 8;
+    }
+    if (dicm_src_seek(src, (int64_t)(length - len), SEEK_CUR) < 0) {
+      return -1;
+    }
+    offset += length;
+  }
+  if (count == 0 || dicm_src_seek(src, -(int64_t)offset, SEEK_CUR) < 0) {
+    return -1;
+  }
+  parser->frame_count = count;
+  return 0;
+}
+
+/* consume the Basic Offset Table (first fragment) and decode frame offsets,
+ * falling back to the Extended Offset Table when it is empty and to a scan of
+ * the fragments when there is none */
+static int parser_load_frames(struct parser *parser) {
+  enum state new_state = parser_next_state(parser, STATE_STARTFRAGMENTS);
+  if (new_state != STATE_FRAGMENT) {
+    return -1;
+  }
+  new_state = parser_next_state(parser, STATE_FRAGMENT);
+  if (new_state != STATE_VALUE) {
+    return -1;
+  }
+  struct level_parser *level_parser = parser_get_level_parser(parser);
+  const uint32_t length = level_parser->da.vl;
+  const uint32_t count = length / 4;
+  parser->current_item_state = STATE_VALUE;
+  parser->value_length_pos = length;
+  parser->frame_base = parser->pos;
+  if (count != 0) {
+    if (parser_reserve_frames(parser, count) < 0 ||
+        parser_reserve_buffer(parser, length) < 0 ||
+        dicm_src_read(parser->src, parser->buffer, length) != length) {
+      return -1;
+    }
+    const unsigned char *p = parser->buffer;
+    for (uint32_t i = 0; i < count; ++i) {
+      parser->frames[i] = read_le32(p + 4 * i);
+    }
+    parser->frame_count = count;
+  } else if (length != 0) {
+    return -1;
+  } else if (parser->level_parsers->size == 2 && parser->eot_length != 0) {
+    if (parser_read_eot(parser) < 0) {
+      return -1;
+    }
+  } else if (parser_scan_frames(parser) < 0) {
+    return -1;
+  }
+  parser->frames_loaded = true;
+  return 0;
+}
+
+static int parser_prepare_frames(struct parser *parser) {
+  const enum state cur_state = parser_get_state(parser);
+  if (parser->frames_loaded) {
+    /* between two fragments */
+    return cur_state == STATE_VALUE || cur_state == STATE_FRAGMENT ? 0 : -1;
+  }
+  if (cur_state != STATE_STARTFRAGMENTS || parser_load_frames(parser) < 0) {
+    parser->current_item_state = STATE_INVALID;
+    return -1;
+  }
+  return 0;
+}
+
+int dicm_parser_get_frame_count(struct dicm_parser *self, uint32_t *count) {
+  struct parser *parser = (struct parser *)self;
+  if (parser_prepare_frames(parser) < 0) {
+    return -1;
+  }
+  *count = parser->frame_count;
+  return 0;
+}
+
+int dicm_parser_get_frame_offsets(struct dicm_parser *self, uint64_t *offsets,
+                                  const uint32_t count) {
+  struct parser *parser = (struct parser *)self;
+  if (parser_prepare_frames(parser) < 0 || count != parser->frame_count) {
+    return -1;
+  }
+  memcpy(offsets, parser->frames, count * sizeof *offsets);
+  return 0;
+}
+
+int dicm_parser_seek_frame(struct dicm_parser *self, const uint32_t frame) {
+  struct parser *parser = (struct parser *)self;
+  if (parser_prepare_frames(parser) < 0 || frame >= parser->frame_count) {
+    return -1;
+  }
+  struct level_parser *level_parser = parser_get_level_parser(parser);
+  /* actual source position: the current fragment may not be consumed */
+  uint64_t cur = parser->pos;
+  if (parser_get_state(parser) == STATE_VALUE) {
+    cur -= level_parser->da.vl - parser->value_length_pos;
+  }
+  const uint64_t target = parser->frame_base + parser->frames[frame];
+  if (target >= cur) {
+    if (parser_skip_bytes(parser, target - cur) < 0) {
+      parser->current_item_state = STATE_INVALID;
+      return -1;
+    }
+  } else {
+    struct dicm_src *src = parser->src;
+    if (!src->vtable->src.fp_seek ||
+        dicm_src_seek(src, -(int64_t)(cur - target), SEEK_CUR) < 0) {
+      parser->current_item_state = STATE_INVALID;
+      return -1;
+    }
+  }
+  /* resume as if the previous fragment was just consumed */
+  parser->pos = target;
+  parser->current_item_state = STATE_VALUE;
+  parser->value_length_pos = level_parser->da.vl;
+  return 0;
+}
+
+int dicm_parser_set_push_input(struct dicm_parser *self,
+                               const int structure_type) {
+  struct parser *parser = (struct parser *)self;
+  struct dicm_src *src;
+  if (src_push_create(&src) < 0) {
+    return -1;
+  }
+  if (parser->push_src) {
+    dicm_delete(parser->push_src);
+  }
+  parser->push_src = src;
+  return dicm_parser_set_input(self, structure_type, src);
+}
+
+int dicm_parser_feed(struct dicm_parser *self, const void *ptr,
+                     const size_t len) {
+  struct parser *parser = (struct parser *)self;
+  if (!parser->push_src) {
+    return -1;
+  }
+  return src_push_feed(parser->push_src, ptr, len);
+}
+
+int dicm_parser_set_index(struct dicm_parser *self, struct dicm_index *index) {
+  struct parser *parser = (struct parser *)self;
+  parser->index = index;
+  return 0;
+}
+
+int dicm_parser_set_private_dict(struct dicm_parser *self,
+                                 struct dicm_private_dict *dict) {
+  struct parser *parser = (struct parser *)self;
+  if (dict && private_dict_prepare(dict) < 0) {
+    return -1;
+  }
+  parser->private_dict = dict;
+  return 0;
+}
+
+int dicm_parser_set_host_byte_order(struct dicm_parser *self, int enable) {
+  struct parser *parser = (struct parser *)self;
+  parser->host_order = enable != 0;
+  return 0;
+}
+
+int dicm_parser_set_max_tag(struct dicm_parser *self, const uint32_t tag) {
+  struct parser *parser = (struct parser *)self;
+  parser->max_tag = tag;
+  return 0;
+}
+
+int dicm_parser_set_wanted_tags(struct dicm_parser *self, const uint32_t *tags,
+                                const size_t count) {
+  struct parser *parser = (struct parser *)self;
+  for (size_t i = 1; i < count; ++i) {
+    if (tags[i - 1] >= tags[i]) {
+      return -1;
+    }
+  }
+  parser->wanted_tags = count != 0 ? tags : NULL;
+  parser->wanted_count = count;
+  parser->wanted_pos = 0;
+  return 0;
+}
+
 int dicm_parser_next_event(struct dicm_parser *self) {
   struct parser *parser = (struct parser *)self;
 
@@ -256,8 +1522,18 @@ int dicm_parser_next_event(struct dicm_parser *self) {
   // special init case
   // TODO: move to external state machine:
   const enum state cur_state = parser_get_state(parser);
+  if (parser->push_src) {
+    parser_set_mark(parser, cur_state);
+  }
   if (STATE_INIT == cur_state) {
     assert(parser->src);
+    if (parser->part10 && parser_read_meta(parser) < 0) {
+      if (parser_rewind(parser)) {
+        return DICM_NEED_MORE_DATA;
+      }
+      parser->current_item_state = STATE_INVALID;
+      return -1;
+    }
     parser->current_item_state = STATE_STARTDOCUMENT;
     return DICM_DOCUMENT_START_EVENT;
   }
@@ -266,8 +1542,18 @@ int dicm_parser_next_event(struct dicm_parser *self) {
     assert(level_parser->da.vl == parser->value_length_pos);
   }
   // else get next dicm event:
-  const enum state new_state = level_parser_next_event(
-      level_parser, parser->current_item_state, parser->src);
+  enum state new_state = parser_next_state(parser, parser->current_item_state);
+  if (new_state == STATE_KEY && parser_has_filter(parser) &&
+      parser_is_root_dataset(parser)) {
+    new_state = parser_filter_key(parser);
+  }
+  if (parser_rewind(parser)) {
+    return DICM_NEED_MORE_DATA;
+  }
+  if (new_state == STATE_KEY && parser->index &&
+      parser_index_key(parser) < 0) {
+    new_state = STATE_INVALID;
+  }
   parser->current_item_state = new_state;
   // at this point level_parser->current_item_state has been updated
   if (new_state == STATE_VALUE) {
@@ -296,11 +1582,238 @@ int dicm_parser_next_event(struct dicm_parser *self) {
   return next;
 }
 
+/* value chunk size when bytes cannot be borrowed from the source */
+enum { RUN_CHUNK_SIZE = 65536 };
+
+/* deliver the rest of the current value */
+static int parser_run_value(struct parser *parser,
+                            const struct dicm_handlers *handlers, void *ctx) {
+  struct dicm_parser *self = &parser->parser;
+  if (!handlers->fp_value) {
+    return dicm_parser_skip_value(self);
+  }
+  const bool push = parser->src == parser->push_src;
+  /* bounded chunks unless the whole input is in memory */
+  const bool stable = dicm_src_is_stable(parser->src);
+  uint32_t remaining = parser_get_remaining(parser);
+  do {
+    const void *ptr;
+    uint32_t len = remaining;
+    if (push) {
+      /* whatever was fed so far */
+      const size_t avail = src_push_peek(parser->src, &ptr);
+      if (avail == 0 && remaining != 0) {
+        return DICM_NEED_MORE_DATA;
+      }
+      len = avail < len ? (uint32_t)avail : len;
+    } else if (!stable && len > RUN_CHUNK_SIZE) {
+      len = RUN_CHUNK_SIZE;
+    }
+    const int err = dicm_parser_borrow_bytes(self, &ptr, len);
+    if (err != 0) {
+      return err;
+    }
+    remaining -= len;
+    const int ret = handlers->fp_value(ctx, ptr, len, remaining);
+    if (ret != 0) {
+      return ret;
+    }
+  } while (remaining != 0);
+  return 0;
+}
+
+static inline int run_handler(int (*fp_handler)(void *), void *ctx) {
+  return fp_handler ? fp_handler(ctx) : 0;
+}
+
+int dicm_parser_run(struct dicm_parser *self,
+                    const struct dicm_handlers *handlers, void *ctx) {
+  struct parser *parser = (struct parser *)self;
+  if (parser_get_state(parser) == STATE_VALUE &&
+      parser_get_remaining(parser) != 0) {
+    /* resume an interrupted value */
+    const int ret = parser_run_value(parser, handlers, ctx);
+    if (ret != 0) {
+      return ret;
+    }
+  }
+  for (;;) {
+    const int next = dicm_parser_next_event(self);
+    const struct level_parser *level_parser = parser_get_level_parser(parser);
+    struct dicm_key key;
+    int ret;
+    switch (next) {
+    case DICM_DOCUMENT_START_EVENT:
+      ret = run_handler(handlers->fp_document_start, ctx);
+      break;
+    case DICM_DOCUMENT_END_EVENT:
+      ret = run_handler(handlers->fp_document_end, ctx);
+      return ret;
+    case DICM_KEY_EVENT:
+      key.tag = level_parser->da.tag;
+      key.vr = level_parser->da.vr;
+      ret = handlers->fp_key ? handlers->fp_key(ctx, &key, level_parser->da.vl)
+                             : 0;
+      break;
+    case DICM_FRAGMENT_EVENT:
+      ret = handlers->fp_fragment
+                ? handlers->fp_fragment(ctx, level_parser->da.vl)
+                : 0;
+      break;
+    case DICM_VALUE_EVENT:
+      ret = parser_run_value(parser, handlers, ctx);
+      break;
+    case DICM_ITEM_START_EVENT:
+      ret = run_handler(handlers->fp_item_start, ctx);
+      break;
+    case DICM_ITEM_END_EVENT:
+      ret = run_handler(handlers->fp_item_end, ctx);
+      break;
+    case DICM_SEQUENCE_START_EVENT:
+      ret = run_handler(handlers->fp_sequence_start, ctx);
+      break;
+    case DICM_SEQUENCE_END_EVENT:
+      ret = run_handler(handlers->fp_sequence_end, ctx);
+      break;
+    default:
+      /* error or need more data */
+      return next;
+    }
+    if (ret != 0) {
+      return ret;
+    }
+  }
+}
+
+/* describe the event just returned by dicm_parser_next_event */
+static void parser_fill_event(struct parser *parser, struct dicm_event *event,
+                              const int next) {
+  const size_t nlevels = parser->level_parsers->size;
+  /* a sequence start is reported at the depth of its key */
+  const size_t level = next == DICM_SEQUENCE_START_EVENT ? nlevels - 2
+                                                          : nlevels - 1;
+  const struct key_info *da = &array_at(parser->level_parsers, level).da;
+  event->type = next;
+  event->depth = (uint32_t)level;
+  event->offset = parser->pos;
+  event->value = NULL;
+  switch (next) {
+  case DICM_VALUE_EVENT:
+    event->offset -= da->vl;
+    /* fall through */
+  case DICM_KEY_EVENT:
+  case DICM_FRAGMENT_EVENT:
+  case DICM_ITEM_START_EVENT:
+  case DICM_SEQUENCE_START_EVENT:
+  case DICM_SEQUENCE_END_EVENT:
+    event->tag = da->tag;
+    event->vr = da->vr;
+    event->vl = da->vl;
+    break;
+  default:
+    event->tag = 0;
+    event->vr = VR_NONE;
+    event->vl = 0;
+  }
+}
+
+int dicm_parser_next_events(struct dicm_parser *self, struct dicm_event *events,
+                            const size_t count, const uint32_t inline_max) {
+  struct parser *parser = (struct parser *)self;
+  if (parser->push_src || count > INT_MAX) {
+    return -1;
+  }
+  if (parser_get_state(parser) == STATE_ENDDOCUMENT) {
+    return 0;
+  }
+  /* values borrowed from other sources (read-ahead windows) may be
+   * overwritten while the rest of the batch is parsed */
+  const bool stable = dicm_src_is_stable(parser->src);
+  /* one slot per event so that copies stay in place, sources require
+   * aligned buffers */
+  const size_t slot = ((size_t)inline_max + 3u) & ~(size_t)3u;
+  if (!stable && slot != 0) {
+    if (count > SIZE_MAX / slot) {
+      return -1;
+    }
+    const size_t size = count * slot;
+    if (size > parser->batch_size) {
+      char *batch = realloc(parser->batch, size);
+      if (!batch) {
+        return -1;
+      }
+      parser->batch = batch;
+      parser->batch_size = size;
+    }
+  }
+  size_t n = 0;
+  while (n < count) {
+    const int next = dicm_parser_next_event(self);
+    if (next < 0) {
+      return -1;
+    }
+    struct dicm_event *event = &events[n];
+    parser_fill_event(parser, event, next);
+    if (next == DICM_VALUE_EVENT) {
+      const uint32_t vl = event->vl;
+      if (vl > inline_max) {
+        if (parser_skip_value(self) < 0) {
+          return -1;
+        }
+      } else if (stable) {
+        if (parser_borrow_value(self, &event->value, vl) < 0) {
+          return -1;
+        }
+      } else {
+        char *copy = parser->batch + n * slot;
+        if (parser_read_value(self, copy, vl) < 0) {
+          return -1;
+        }
+        event->value = copy;
+      }
+    }
+    ++n;
+    if (next == DICM_DOCUMENT_END_EVENT) {
+      break;
+    }
+  }
+  return (int)n;
+}
+
 int dicm_parser_create(struct dicm_parser **pself) {
   struct parser *self = (struct parser *)malloc(sizeof(*self));
   if (self) {
     *pself = &self->parser;
     self->parser.vtable = &g_vtable;
+    self->max_tag = UINT32_MAX;
+    self->wanted_tags = NULL;
+    self->wanted_count = 0;
+    self->wanted_pos = 0;
+    self->part10 = false;
+    self->meta_src = NULL;
+    self->input = NULL;
+    self->dataset_structure = DICM_STRUCTURE_ENCAPSULATED;
+    self->meta = NULL;
+    self->meta_size = 0;
+    self->fast_structure = -1;
+    self->frames = NULL;
+    self->frames_capacity = 0;
+    self->frame_count = 0;
+    self->frames_loaded = false;
+    self->frame_base = 0;
+    self->eot_pos = 0;
+    self->eot_length = 0;
+    self->index = NULL;
+    self->private_dict = NULL;
+    self->host_order = false;
+    array_new(private_block_t, self->private_blocks);
+    self->path = NULL;
+    self->path_capacity = 0;
+    self->push_src = NULL;
+    self->buffer = NULL;
+    self->buffer_size = 0;
+    self->batch = NULL;
+    self->batch_size = 0;
     array_new(level_parser_t, self->level_parsers);
 
     return 0;
@@ -89,32 +89,66 @@ enum VALUE_REPRESENTATIONS {
   VR_UV = MAKE_VR('U', 'V'),
 };
 
-static inline bool _is_vr16(const uint32_t vr) {
-  switch (vr) {
-  case VR_AE:
-  case VR_AS:
-  case VR_AT:
-  case VR_CS:
-  case VR_DA:
-  case VR_DS:
-  case VR_DT:
-  case VR_FD:
-  case VR_FL:
-  case VR_IS:
-  case VR_LO:
-  case VR_LT:
-  case VR_PN:
-  case VR_SH:
-  case VR_SL:
-  case VR_SS:
-  case VR_ST:
-  case VR_TM:
-  case VR_UI:
-  case VR_UL:
-  case VR_US:
-    return true;
+/* VR information: one byte per pair of letters, see dicm_vr_infos */
+enum VR_INFO {
+  /* two upper case letters */
+  VR_INFO_VALID = 0x01,
+  /* defined in PS3.5 */
+  VR_INFO_KNOWN = 0x02,
+  /* 16-bit VL in explicit structures */
+  VR_INFO_VL16 = 0x04,
+  /* character string */
+  VR_INFO_STRING = 0x08,
+  /* binary numbers, byte swapped between little and big endian */
+  VR_INFO_SWAP = 0x10,
+  /* log2 of the size of one number (bits 5-6) */
+  VR_INFO_SIZE_SHIFT = 5,
+};
+
+/* 5 low bits of each letter: 1024 entries. Both bytes must be in the 0x40-0x5f
+ * range, and nothing else set */
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define VR_LETTERS_MASK 0xffffe0e0u
+#define VR_LETTERS_BITS 0x00004040u
+#define VR_INDEX(vr) (((vr)&0x1fu) << 5u | ((vr) >> 8u & 0x1fu))
+#else
+#define VR_LETTERS_MASK 0xe0e0ffffu
+#define VR_LETTERS_BITS 0x40400000u
+#define VR_INDEX(vr) (((vr) >> 24u & 0x1fu) << 5u | ((vr) >> 16u & 0x1fu))
+#endif
+
+extern const uint8_t dicm_vr_infos[1024];
+
+static inline uint_fast8_t _vr_info(const uint32_t vr) {
+  if ((vr & VR_LETTERS_MASK) != VR_LETTERS_BITS) {
+    return 0;
   }
-  return false;
+  return dicm_vr_infos[VR_INDEX(vr)];
+}
+
+static inline bool _is_vr16(const uint32_t vr) {
+  return (_vr_info(vr) & VR_INFO_VL16) != 0;
+}
+
+static inline bool _vr_is_valid(const uint32_t vr) {
+  return (_vr_info(vr) & VR_INFO_VALID) != 0;
+}
+
+static inline bool _vr_is_known(const uint32_t vr) {
+  return (_vr_info(vr) & VR_INFO_KNOWN) != 0;
+}
+
+static inline bool _vr_is_string(const uint32_t vr) {
+  return (_vr_info(vr) & VR_INFO_STRING) != 0;
+}
+
+static inline bool _vr_needs_swap(const uint32_t vr) {
+  return (_vr_info(vr) & VR_INFO_SWAP) != 0;
+}
+
+/* size of one number, 1 for strings and bytes */
+static inline uint32_t _vr_get_size(const uint32_t vr) {
+  return 1u << (_vr_info(vr) >> VR_INFO_SIZE_SHIFT & 0x3u);
 }
 
 struct _ede32 {
@@ -380,4 +414,19 @@ static inline bool is_aligned(const void *restrict pointer, size_t byte_count) {
   return (uintptr_t)pointer % byte_count == 0;
 }
 
+/* CRC-32 (IEEE), nibble at a time */
+static inline uint32_t crc32_update(uint32_t crc, const void *buf, size_t len) {
+  static const uint32_t table[16] = {
+      0x00000000, 0x1db71064, 0x3b6e20c8, 0x26d930ac, 0x76dc4190, 0x6b6b51f4,
+      0x4db26158, 0x5005713c, 0xedb88320, 0xf00f9344, 0xd6d6a3e8, 0xcb61b38c,
+      0x9b64c2b0, 0x86d3d2d4, 0xa00ae278, 0xbdbdf21c};
+  const unsigned char *p = buf;
+  crc = ~crc;
+  for (size_t i = 0; i < len; ++i) {
+    crc = (crc >> 4) ^ table[(crc ^ p[i]) & 0x0f];
+    crc = (crc >> 4) ^ table[(crc ^ (p[i] >> 4)) & 0x0f];
+  }
+  return ~crc;
+}
+
 #endif /* DICM_PRIVATE_H */
@@ -0,0 +1,414 @@
+#include "dicm_private_dict.h"
+
+#include "dicm_dict.h"
+#include "dicm_dst.h"
+#include "dicm_item.h"
+
+#include <stdlib.h> /* malloc */
+#include <string.h> /* memcmp */
+
+/*
+ * Image layout, in host byte order so that it can be used in place: header,
+ * creators, entries, creator slots, entry slots, then the creator names. Both
+ * slot tables use open addressing with linear probing, a slot holds the index
+ * of a creator (or entry) plus one, 0 when empty. The checksum covers
+ * everything after the header.
+ */
+#define PRIVATE_DICT_MAGIC "DICMPRV"
+enum {
+  PRIVATE_DICT_VERSION = 1,
+  PRIVATE_DICT_BYTE_ORDER = 0x01020304,
+  /* LO value of a private creator */
+  CREATOR_MAX_LENGTH = 64
+};
+
+struct private_dict_header {
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  uint32_t creator_count;
+  uint32_t entry_count;
+  /* both slot tables have 1 << slot_bits entries */
+  uint32_t slot_bits;
+  uint32_t names_size;
+  uint32_t checksum;
+  uint32_t reserved;
+};
+
+struct private_creator {
+  uint32_t name_pos;
+  uint32_t name_len;
+};
+
+/* (gggg,xxee) reserved by creator, whatever the block xx */
+struct private_entry {
+  uint32_t creator;
+  uint16_t group;
+  uint8_t element;
+  uint8_t reserved;
+  uint32_t vr;
+};
+
+typedef struct private_creator private_creator_t;
+typedef struct private_entry private_entry_t;
+typedef char name_char_t;
+struct private_dict {
+  struct dicm_private_dict dict;
+
+  /* entries added so far, unused once loaded */
+  array(private_creator_t) * creators;
+  array(private_entry_t) * entries;
+  array(name_char_t) * names;
+
+  /* lookup image, owned when built from the arrays */
+  const struct private_dict_header *image;
+  void *owned;
+};
+
+static DICM_CHECK_RETURN int private_dict_destroy(struct object *)
+    DICM_NONNULL();
+
+static struct private_dict_vtable const g_vtable = {
+    /* object interface */
+    .obj = {.fp_destroy = private_dict_destroy}};
+
+int private_dict_destroy(struct object *const self) {
+  struct private_dict *dict = (struct private_dict *)self;
+  array_free(dict->creators);
+  array_free(dict->entries);
+  array_free(dict->names);
+  free(dict->owned);
+  free(dict);
+  return 0;
+}
+
+/* LO padding (leading and trailing spaces, trailing nulls) is not part of
+ * the creator name */
+static void creator_trim(const char **pname, size_t *plen) {
+  const char *name = *pname;
+  size_t len = *plen;
+  while (len != 0 && *name == ' ') {
+    ++name;
+    --len;
+  }
+  while (len != 0 && (name[len - 1] == ' ' || name[len - 1] == '\0')) {
+    --len;
+  }
+  *pname = name;
+  *plen = len;
+}
+
+static inline uint32_t entry_hash(const uint32_t creator, const uint32_t group,
+                                  const uint32_t element) {
+  return dict_hash_tag(creator << 24u ^ group << 8u ^ element);
+}
+
+static inline const struct private_creator *
+image_creators(const struct private_dict_header *header) {
+  return (const struct private_creator *)(header + 1);
+}
+
+static inline const struct private_entry *
+image_entries(const struct private_dict_header *header) {
+  return (const struct private_entry *)(image_creators(header) +
+                                        header->creator_count);
+}
+
+static inline const uint32_t *
+image_creator_slots(const struct private_dict_header *header) {
+  return (const uint32_t *)(image_entries(header) + header->entry_count);
+}
+
+static inline const uint32_t *
+image_entry_slots(const struct private_dict_header *header) {
+  return image_creator_slots(header) + ((size_t)1 << header->slot_bits);
+}
+
+static inline const char *
+image_names(const struct private_dict_header *header) {
+  return (const char *)(image_entry_slots(header) +
+                        ((size_t)1 << header->slot_bits));
+}
+
+static inline size_t image_size(const uint32_t creator_count,
+                                const uint32_t entry_count,
+                                const uint32_t slot_bits,
+                                const uint32_t names_size) {
+  return sizeof(struct private_dict_header) +
+         creator_count * sizeof(struct private_creator) +
+         entry_count * sizeof(struct private_entry) +
+         ((size_t)2 << slot_bits) * sizeof(uint32_t) + names_size;
+}
+
+static uint32_t image_find_creator(const struct private_dict_header *header,
+                                   const char *name, const size_t len) {
+  const struct private_creator *creators = image_creators(header);
+  const uint32_t *slots = image_creator_slots(header);
+  const char *names = image_names(header);
+  const size_t mask = ((size_t)1 << header->slot_bits) - 1;
+  size_t slot = dict_slot(dict_hash_bytes(name, len), header->slot_bits);
+  for (; slots[slot] != 0; slot = (slot + 1) & mask) {
+    const uint32_t i = slots[slot] - 1;
+    if (creators[i].name_len == len &&
+        memcmp(names + creators[i].name_pos, name, len) == 0) {
+      return i;
+    }
+  }
+  return PRIVATE_CREATOR_UNKNOWN;
+}
+
+static const struct private_entry *
+image_find_entry(const struct private_dict_header *header,
+                 const uint32_t creator, const uint32_t group,
+                 const uint32_t element) {
+  const struct private_entry *entries = image_entries(header);
+  const uint32_t *slots = image_entry_slots(header);
+  const size_t mask = ((size_t)1 << header->slot_bits) - 1;
+  size_t slot =
+      dict_slot(entry_hash(creator, group, element), header->slot_bits);
+  for (; slots[slot] != 0; slot = (slot + 1) & mask) {
+    const struct private_entry *entry = &entries[slots[slot] - 1];
+    if (entry->creator == creator && entry->group == group &&
+        entry->element == element) {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+/* insert index i at the first free slot after hash */
+static void slots_insert(uint32_t *slots, const uint32_t bits,
+                         const uint32_t hash, const uint32_t i) {
+  const size_t mask = ((size_t)1 << bits) - 1;
+  size_t slot = dict_slot(hash, bits);
+  while (slots[slot] != 0) {
+    slot = (slot + 1) & mask;
+  }
+  slots[slot] = i + 1;
+}
+
+int private_dict_prepare(struct dicm_private_dict *self) {
+  struct private_dict *dict = (struct private_dict *)self;
+  if (dict->image) {
+    return 0;
+  }
+  const uint32_t creator_count = (uint32_t)dict->creators->size;
+  const uint32_t entry_count = (uint32_t)dict->entries->size;
+  const size_t count =
+      creator_count > entry_count ? creator_count : entry_count;
+  /* at most half full */
+  uint32_t bits = 1;
+  while (((size_t)1 << bits) < 2 * count) {
+    ++bits;
+  }
+  const uint32_t names_size = (uint32_t)dict->names->size;
+  const size_t size = image_size(creator_count, entry_count, bits, names_size);
+  struct private_dict_header *header = calloc(1, size);
+  if (!header) {
+    return -1;
+  }
+  memcpy(header->magic, PRIVATE_DICT_MAGIC, sizeof header->magic);
+  header->version = PRIVATE_DICT_VERSION;
+  header->byte_order = PRIVATE_DICT_BYTE_ORDER;
+  header->creator_count = creator_count;
+  header->entry_count = entry_count;
+  header->slot_bits = bits;
+  header->names_size = names_size;
+  struct private_creator *creators = (struct private_creator *)(header + 1);
+  struct private_entry *entries =
+      (struct private_entry *)(creators + creator_count);
+  uint32_t *creator_slots = (uint32_t *)(entries + entry_count);
+  uint32_t *entry_slots = creator_slots + ((size_t)1 << bits);
+  char *names = (char *)(entry_slots + ((size_t)1 << bits));
+  if (creator_count != 0) {
+    memcpy(creators, array_ref(dict->creators, 0),
+           creator_count * sizeof *creators);
+  }
+  if (entry_count != 0) {
+    memcpy(entries, array_ref(dict->entries, 0), entry_count * sizeof *entries);
+  }
+  if (names_size != 0) {
+    memcpy(names, array_ref(dict->names, 0), names_size);
+  }
+  for (uint32_t i = 0; i < creator_count; ++i) {
+    const uint32_t hash =
+        dict_hash_bytes(names + creators[i].name_pos, creators[i].name_len);
+    slots_insert(creator_slots, bits, hash, i);
+  }
+  for (uint32_t i = 0; i < entry_count; ++i) {
+    const struct private_entry *entry = &entries[i];
+    const uint32_t hash =
+        entry_hash(entry->creator, entry->group, entry->element);
+    slots_insert(entry_slots, bits, hash, i);
+  }
+  header->checksum = crc32_update(0, header + 1, size - sizeof *header);
+  dict->owned = header;
+  dict->image = header;
+  return 0;
+}
+
+uint32_t private_dict_find_creator(const struct dicm_private_dict *self,
+                                   const char *name, size_t len) {
+  const struct private_dict *dict = (const struct private_dict *)self;
+  assert(dict->image);
+  creator_trim(&name, &len);
+  return image_find_creator(dict->image, name, len);
+}
+
+uint32_t private_dict_get_vr(const struct dicm_private_dict *self,
+                             const uint32_t creator, const uint32_t group,
+                             const uint32_t element) {
+  const struct private_dict *dict = (const struct private_dict *)self;
+  assert(dict->image);
+  const struct private_entry *entry =
+      image_find_entry(dict->image, creator, group, element);
+  return entry ? entry->vr : VR_NONE;
+}
+
+int dicm_private_dict_create(struct dicm_private_dict **pself) {
+  struct private_dict *self = (struct private_dict *)malloc(sizeof(*self));
+  if (self) {
+    *pself = &self->dict;
+    self->dict.vtable = &g_vtable;
+    array_new(private_creator_t, self->creators);
+    array_new(private_entry_t, self->entries);
+    array_new(name_char_t, self->names);
+    self->image = NULL;
+    self->owned = NULL;
+    return 0;
+  }
+  return -1;
+}
+
+/* index of a creator in the arrays, added when missing */
+static uint32_t private_dict_add_creator(struct private_dict *dict,
+                                         const char *name, const size_t len) {
+  const size_t count = dict->creators->size;
+  for (size_t i = 0; i < count; ++i) {
+    const struct private_creator *creator = array_ref(dict->creators, i);
+    if (creator->name_len == len &&
+        memcmp(array_ref(dict->names, creator->name_pos), name, len) == 0) {
+      return (uint32_t)i;
+    }
+  }
+  const struct private_creator creator = {
+      .name_pos = (uint32_t)dict->names->size, .name_len = (uint32_t)len};
+  for (size_t i = 0; i < len; ++i) {
+    array_push(dict->names, name[i]);
+  }
+  array_push(dict->creators, creator);
+  return (uint32_t)count;
+}
+
+int dicm_private_dict_add(struct dicm_private_dict *self, const char *creator,
+                          const uint32_t tag, const char *vr) {
+  struct private_dict *dict = (struct private_dict *)self;
+  if (dict->image && !dict->owned) {
+    /* loaded images are read-only */
+    return -1;
+  }
+  size_t len = strlen(creator);
+  creator_trim(&creator, &len);
+  const uint32_t group = dicm_tag_get_group(tag);
+  const uint32_t element = dicm_tag_get_element(tag) & 0xffu;
+  if (len == 0 || len > CREATOR_MAX_LENGTH || group % 2 == 0 ||
+      strlen(vr) != 2 || !_vr_is_known(MAKE_VR(vr[0], vr[1]))) {
+    return -1;
+  }
+  const uint32_t id = private_dict_add_creator(dict, creator, len);
+  for (size_t i = 0; i < dict->entries->size; ++i) {
+    const struct private_entry *entry = array_ref(dict->entries, i);
+    if (entry->creator == id && entry->group == group &&
+        entry->element == element) {
+      return -1;
+    }
+  }
+  const struct private_entry entry = {.creator = id,
+                                      .group = (uint16_t)group,
+                                      .element = (uint8_t)element,
+                                      .reserved = 0,
+                                      .vr = MAKE_VR(vr[0], vr[1])};
+  array_push(dict->entries, entry);
+  /* lookup image is rebuilt on demand */
+  free(dict->owned);
+  dict->owned = NULL;
+  dict->image = NULL;
+  return 0;
+}
+
+int dicm_private_dict_write(struct dicm_private_dict *self,
+                            struct dicm_dst *dst) {
+  struct private_dict *dict = (struct private_dict *)self;
+  if (private_dict_prepare(self) < 0) {
+    return -1;
+  }
+  const struct private_dict_header *header = dict->image;
+  const size_t size =
+      image_size(header->creator_count, header->entry_count,
+                 header->slot_bits, header->names_size);
+  return dicm_dst_write(dst, header, size) == (int64_t)size ? 0 : -1;
+}
+
+/* validate an image, the checksum and contents are only checked on request */
+static int image_check(const void *ptr, size_t size, int verify) {
+  const struct private_dict_header *header = ptr;
+  if (!is_aligned(ptr, 8) || size < sizeof *header ||
+      memcmp(header->magic, PRIVATE_DICT_MAGIC, sizeof header->magic) != 0 ||
+      header->version != PRIVATE_DICT_VERSION ||
+      header->byte_order != PRIVATE_DICT_BYTE_ORDER ||
+      header->slot_bits == 0 || header->slot_bits > 30 ||
+      header->creator_count > UINT32_MAX / 2 ||
+      header->entry_count > UINT32_MAX / 2 ||
+      size != image_size(header->creator_count, header->entry_count,
+                         header->slot_bits, header->names_size)) {
+    return -1;
+  }
+  const size_t slots = (size_t)1 << header->slot_bits;
+  /* an empty slot must end every probe */
+  if (header->creator_count >= slots || header->entry_count >= slots) {
+    return -1;
+  }
+  if (!verify) {
+    return 0;
+  }
+  if (crc32_update(0, header + 1, size - sizeof *header) != header->checksum) {
+    return -1;
+  }
+  const struct private_creator *creators = image_creators(header);
+  const struct private_entry *entries = image_entries(header);
+  const uint32_t *creator_slots = image_creator_slots(header);
+  const uint32_t *entry_slots = image_entry_slots(header);
+  for (size_t i = 0; i < header->creator_count; ++i) {
+    if ((uint64_t)creators[i].name_pos + creators[i].name_len >
+        header->names_size) {
+      return -1;
+    }
+  }
+  for (size_t i = 0; i < header->entry_count; ++i) {
+    if (entries[i].creator >= header->creator_count) {
+      return -1;
+    }
+  }
+  for (size_t i = 0; i < slots; ++i) {
+    if (creator_slots[i] > header->creator_count ||
+        entry_slots[i] > header->entry_count) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int dicm_private_dict_load(struct dicm_private_dict **pself, const void *ptr,
+                           size_t size, int verify) {
+  if (image_check(ptr, size, verify) < 0) {
+    return -1;
+  }
+  struct dicm_private_dict *self;
+  if (dicm_private_dict_create(&self) < 0) {
+    return -1;
+  }
+  struct private_dict *dict = (struct private_dict *)self;
+  dict->image = ptr;
+  *pself = self;
+  return 0;
+}
@@ -0,0 +1,39 @@
+#ifndef DICM_PRIVATE_DICT_H
+#define DICM_PRIVATE_DICT_H
+
+#include "dicm.h"
+
+#include "dicm_private.h"
+
+#include <stddef.h> /* size_t */
+
+struct private_dict_vtable {
+  struct object_prv_vtable const obj;
+};
+
+/* common private dictionary object */
+struct dicm_private_dict {
+  struct private_dict_vtable const *vtable;
+};
+
+/* creator not found in the dictionary */
+#define PRIVATE_CREATOR_UNKNOWN UINT32_MAX
+
+/* build the lookup image of a dictionary made with dicm_private_dict_add(),
+ * nothing to do for a loaded one */
+DICM_CHECK_RETURN int private_dict_prepare(struct dicm_private_dict *self)
+    DICM_NONNULL();
+
+/* identifier of a private creator value, padding is ignored. The dictionary
+ * must be prepared */
+uint32_t private_dict_find_creator(const struct dicm_private_dict *self,
+                                   const char *name, size_t len)
+    DICM_NONNULL();
+
+/* VR of element (gggg,xxee) reserved by creator, VR_NONE when unknown. The
+ * dictionary must be prepared */
+uint32_t private_dict_get_vr(const struct dicm_private_dict *self,
+                             uint32_t creator, uint32_t group,
+                             uint32_t element) DICM_NONNULL();
+
+#endif /* DICM_PRIVATE_DICT_H */
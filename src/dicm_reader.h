@@ -0,0 +1,484 @@
+#ifndef DICM_READER_H
+#define DICM_READER_H
+
+#include "dicm_configure.h"
+#include "dicm_dict.h"
+#include "dicm_item.h"
+#include "dicm_src.h"
+
+#include <assert.h>
+
+/* Key and value readers of each structure, and their next_event instances.
+ * Everything is static inline so that dicm_parser.c, which includes this
+ * header, can inline a whole level transition when the structure is known
+ * (see the dicm_parser_set_input_*_fast() entry points). The item sources
+ * include it too, to fill the level parser vtables. */
+
+static inline bool _tag_is_valid(const dicm_tag_t tag) {
+  // The following cases have been handled by design:
+  assert(tag != TAG_STARTITEM && tag != TAG_ENDITEM && tag != TAG_ENDSQITEM);
+  // FIXME: valid for DataSet but not CommandSet
+  return dicm_tag_get_group(tag) >= 0x0008;
+}
+
+static inline bool _tag_is_creator(const dicm_tag_t tag) {
+  const uint_fast16_t element = dicm_tag_get_element(tag);
+  return dicm_tag_is_private(tag) && (element > 0x0 && element <= 0xff);
+}
+
+static inline bool vl_is_valid(const dicm_vl_t vl) {
+  return dicm_vl_is_undefined(vl) || vl % 2 == 0;
+}
+
+static inline bool _attribute_is_valid(const struct key_info *da) {
+  // 1. check triplet separately:
+  const bool valid =
+      _tag_is_valid(da->tag) && _vr_is_valid(da->vr) && vl_is_valid(da->vl);
+  if (!valid) {
+    return false;
+  }
+  // 2. handle finer cases here:
+  if (dicm_vl_is_undefined(da->vl) && da->vr != VR_SQ) {
+    if (!dicm_attribute_is_encapsulated_pixel_data(da)) {
+      return false;
+    }
+  }
+  if (dicm_tag_is_group_length(da->tag)) {
+    if (da->vr != VR_UL)
+      return false;
+  } else if (_tag_is_creator(da->tag)) {
+    if (da->vr != VR_LO)
+      return false;
+  }
+  return true;
+}
+
+static inline bool _ivr_attribute_is_valid(const struct key_info *da) {
+  // 1. check triplet separately:
+  const bool valid = _tag_is_valid(da->tag) && vl_is_valid(da->vl);
+  if (!valid) {
+    return false;
+  }
+  return true;
+}
+
+#define LE_SWAP_TAG(x) ((((x)&0x0000ffff) << 16u) | (((x)&0xffff0000) >> 16u))
+
+static inline uint32_t evrle2tag(const uint32_t tag_bytes) {
+  return LE_SWAP_TAG(tag_bytes);
+}
+
+enum EVRLE_SPECIAL_TAGS {
+  EVRLE_TAG_STARTITEM = LE_SWAP_TAG(TAG_STARTITEM),
+  EVRLE_TAG_ENDITEM = LE_SWAP_TAG(TAG_ENDITEM),
+  EVRLE_TAG_ENDSQITEM = LE_SWAP_TAG(TAG_ENDSQITEM),
+};
+
+static inline uint32_t ivrle2tag(const uint32_t tag_bytes) {
+  return LE_SWAP_TAG(tag_bytes);
+}
+
+enum IVRLE_SPECIAL_TAGS {
+  IVRLE_TAG_STARTITEM = LE_SWAP_TAG(TAG_STARTITEM),
+  IVRLE_TAG_ENDITEM = LE_SWAP_TAG(TAG_ENDITEM),
+  IVRLE_TAG_ENDSQITEM = LE_SWAP_TAG(TAG_ENDSQITEM),
+};
+
+#define BE_SWAP_TAG(x)                                                         \
+  ((((x)&0x000000ff) << 24) | (((x)&0x0000ff00) << 8) |                        \
+   (((x)&0x00ff0000) >> 8) | (((x)&0xff000000) >> 24))
+
+static inline uint32_t evrbe2tag(const uint32_t tag_bytes) {
+  return bswap_32(tag_bytes);
+}
+
+enum EVRBE_SPECIAL_TAGS {
+  EVRBE_TAG_STARTITEM = BE_SWAP_TAG(TAG_STARTITEM),
+  EVRBE_TAG_ENDITEM = BE_SWAP_TAG(TAG_ENDITEM),
+  EVRBE_TAG_ENDSQITEM = BE_SWAP_TAG(TAG_ENDSQITEM),
+};
+
+#ifdef DICM_ENABLE_STRUCTURE_ENCAPSULATED
+static inline enum token
+encap_level_parser_read_key(struct level_parser *self, struct dicm_src *src) {
+  struct dual dual;
+  int64_t ssize = dicm_src_read(src, &dual.ivr, 8);
+  if (ssize != 8) {
+    /* EOF is not an error at root level */
+    return ssize == 0 ? TOKEN_EOF : TOKEN_INVALID_DATA;
+  }
+
+  const uint32_t tag = evrle2tag(dual.ivr.tag);
+  self->da.tag = tag;
+  {
+    const uint32_t ide_vl = dual.ivr.vl;
+    switch (tag) {
+    case TAG_STARTITEM:
+      /* FIXME: no bswap needed at this point */
+      assert(dual.ivr.tag == EVRLE_TAG_STARTITEM);
+      self->da.vr = VR_NONE;
+      self->da.vl = ide_vl;
+      return vl_is_valid(ide_vl) ? TOKEN_STARTITEM : TOKEN_INVALID_DATA;
+    case TAG_ENDITEM:
+      assert(dual.ivr.tag == EVRLE_TAG_ENDITEM);
+      self->da.vr = VR_NONE;
+      self->da.vl = ide_vl;
+      return ide_vl == 0 ? TOKEN_ENDITEM : TOKEN_INVALID_DATA;
+    case TAG_ENDSQITEM:
+      assert(dual.ivr.tag == EVRLE_TAG_ENDSQITEM);
+      self->da.vr = VR_NONE;
+      self->da.vl = ide_vl;
+      return ide_vl == 0 ? TOKEN_ENDSQITEM : TOKEN_INVALID_DATA;
+    }
+  }
+
+  const uint32_t vr = dual.evr.vr16;
+  self->da.vr = vr;
+  if (_is_vr16(vr)) {
+    const uint32_t vl = dual.evr.vl16;
+    self->da.vl = vl;
+  } else {
+    ssize = dicm_src_read(src, &dual.evr.vl32, 4);
+    if (ssize != 4) {
+      return TOKEN_INVALID_DATA;
+    }
+    const uint32_t vl = dual.evr.vl32;
+    self->da.vl = vl;
+  }
+
+  if (!_attribute_is_valid(&self->da)) {
+    assert(0);
+    return TOKEN_INVALID_DATA;
+  }
+
+  return TOKEN_KEY;
+}
+
+static inline enum token
+encap_level_parser_read_value(struct level_parser *self, struct dicm_src *src) {
+  assert(src);
+  const dicm_vr_t vr = self->da.vr;
+  if (dicm_attribute_is_encapsulated_pixel_data(&self->da)) {
+    return TOKEN_STARTFRAGMENTS;
+  } else if (vr == VR_SQ) {
+    /* defined length is tracked by the parser */
+    return TOKEN_STARTSEQUENCE;
+  } else {
+    assert(!dicm_vl_is_undefined(self->da.vl));
+    return TOKEN_VALUE;
+  }
+}
+
+static inline enum token
+encap_frag_reader_read_value(struct level_parser *self, struct dicm_src *src) {
+  assert(src);
+  const dicm_vr_t vr = self->da.vr;
+  assert(vr == VR_NONE);
+  return TOKEN_VALUE;
+}
+
+static inline enum token
+encap_frag_reader_read_key(struct level_parser *self, struct dicm_src *src) {
+  struct dual dual;
+  int64_t ssize = dicm_src_read(src, &dual.ivr, 8);
+  if (ssize != 8) {
+    return TOKEN_INVALID_DATA;
+  }
+
+  const uint32_t tag = evrle2tag(dual.ivr.tag);
+  self->da.tag = tag;
+  {
+    const uint32_t ide_vl = dual.ivr.vl;
+    switch (tag) {
+    case TAG_STARTITEM:
+      /* FIXME: no bswap needed at this point */
+      assert(dual.ivr.tag == EVRLE_TAG_STARTITEM);
+      self->da.vr = VR_NONE;
+      self->da.vl = ide_vl;
+      return vl_is_valid(ide_vl) ? TOKEN_FRAGMENT : TOKEN_INVALID_DATA;
+    case TAG_ENDSQITEM:
+      assert(dual.ivr.tag == EVRLE_TAG_ENDSQITEM);
+      self->da.vr = VR_NONE;
+      self->da.vl = ide_vl;
+      return ide_vl == 0 ? TOKEN_ENDSQITEM : TOKEN_INVALID_DATA;
+    }
+  }
+  return TOKEN_INVALID_DATA;
+}
+
+LEVEL_PARSER_NEXT_EVENT(encap_level_parser_next_event,
+                        encap_level_parser_read_key,
+                        encap_level_parser_read_value)
+LEVEL_PARSER_NEXT_EVENT(encap_frag_reader_next_event,
+                        encap_frag_reader_read_key,
+                        encap_frag_reader_read_value)
+
+/* specialized fp_next_event, without dispatch through the vtable */
+static inline enum state encap_fast_next_event(struct level_parser *self,
+                                               const enum state current_state,
+                                               struct dicm_src *src) {
+  return self->kind == LEVEL_FRAGMENTS
+             ? encap_frag_reader_next_event(self, current_state, src)
+             : encap_level_parser_next_event(self, current_state, src);
+}
+#endif /* DICM_ENABLE_STRUCTURE_ENCAPSULATED */
+
+#ifdef DICM_ENABLE_STRUCTURE_EXPLICT_LE
+static inline enum token
+evrle_level_parser_read_key(struct level_parser *self, struct dicm_src *src) {
+  struct dual dual;
+  int64_t ssize = dicm_src_read(src, &dual.ivr, 8);
+  if (ssize != 8) {
+    return ssize == 0 ? TOKEN_EOF : TOKEN_INVALID_DATA;
+  }
+
+  const uint32_t tag = evrle2tag(dual.ivr.tag);
+  self->da.tag = tag;
+  {
+    const uint32_t ide_vl = dual.ivr.vl;
+    switch (tag) {
+    case TAG_STARTITEM:
+      /* FIXME: no bswap needed at this point */
+      assert(dual.ivr.tag == EVRLE_TAG_STARTITEM);
+      self->da.vr = VR_NONE;
+      self->da.vl = ide_vl;
+      return vl_is_valid(ide_vl) ? TOKEN_STARTITEM : TOKEN_INVALID_DATA;
+    case TAG_ENDITEM:
+      assert(dual.ivr.tag == EVRLE_TAG_ENDITEM);
+      self->da.vr = VR_NONE;
+      self->da.vl = ide_vl;
+      return ide_vl == 0 ? TOKEN_ENDITEM : TOKEN_INVALID_DATA;
+    case TAG_ENDSQITEM:
+      assert(dual.ivr.tag == EVRLE_TAG_ENDSQITEM);
+      self->da.vr = VR_NONE;
+      self->da.vl = ide_vl;
+      return ide_vl == 0 ? TOKEN_ENDSQITEM : TOKEN_INVALID_DATA;
+    }
+  }
+
+  const uint32_t vr = dual.evr.vr16;
+  self->da.vr = vr;
+  if (_is_vr16(vr)) {
+    const uint32_t vl = dual.evr.vl16;
+    self->da.vl = vl;
+  } else {
+    ssize = dicm_src_read(src, &dual.evr.vl32, 4);
+    if (ssize != 4) {
+      return TOKEN_INVALID_DATA;
+    }
+    const uint32_t vl = dual.evr.vl32;
+    self->da.vl = vl;
+  }
+
+  if (!_attribute_is_valid(&self->da)) {
+    assert(0);
+    return TOKEN_INVALID_DATA;
+  }
+
+  return TOKEN_KEY;
+}
+
+/* File Meta Information: group 0002 only, always defined length */
+static inline bool _meta_attribute_is_valid(const struct key_info *da) {
+  return dicm_tag_get_group(da->tag) == 0x0002 && _vr_is_valid(da->vr) &&
+         da->vr != VR_SQ && !dicm_vl_is_undefined(da->vl);
+}
+
+static inline enum token
+evrle_meta_parser_read_key(struct level_parser *self, struct dicm_src *src) {
+  struct dual dual;
+  int64_t ssize = dicm_src_read(src, &dual.ivr, 8);
+  if (ssize != 8) {
+    return ssize == 0 ? TOKEN_EOF : TOKEN_INVALID_DATA;
+  }
+
+  self->da.tag = evrle2tag(dual.ivr.tag);
+  const uint32_t vr = dual.evr.vr16;
+  self->da.vr = vr;
+  if (_is_vr16(vr)) {
+    self->da.vl = dual.evr.vl16;
+  } else {
+    ssize = dicm_src_read(src, &dual.evr.vl32, 4);
+    if (ssize != 4) {
+      return TOKEN_INVALID_DATA;
+    }
+    self->da.vl = dual.evr.vl32;
+  }
+
+  return _meta_attribute_is_valid(&self->da) ? TOKEN_KEY : TOKEN_INVALID_DATA;
+}
+
+static inline enum token
+evrle_level_parser_read_value(struct level_parser *self, struct dicm_src *src) {
+  assert(src);
+  const dicm_vr_t vr = self->da.vr;
+  if (vr == VR_SQ) {
+    /* defined length is tracked by the parser */
+    return TOKEN_STARTSEQUENCE;
+  } else {
+    assert(!dicm_vl_is_undefined(self->da.vl));
+    return TOKEN_VALUE;
+  }
+}
+
+LEVEL_PARSER_NEXT_EVENT(evrle_level_parser_next_event,
+                        evrle_level_parser_read_key,
+                        evrle_level_parser_read_value)
+LEVEL_PARSER_NEXT_EVENT(evrle_meta_parser_next_event,
+                        evrle_meta_parser_read_key,
+                        evrle_level_parser_read_value)
+
+/* specialized fp_next_event, without dispatch through the vtable */
+static inline enum state evrle_fast_next_event(struct level_parser *self,
+                                               const enum state current_state,
+                                               struct dicm_src *src) {
+  return evrle_level_parser_next_event(self, current_state, src);
+}
+#endif /* DICM_ENABLE_STRUCTURE_EXPLICT_LE */
+
+#ifdef DICM_ENABLE_STRUCTURE_EXPLICT_BE
+static inline enum token
+evrbe_level_parser_read_key(struct level_parser *self, struct dicm_src *src) {
+  struct dual dual;
+  int64_t ssize = dicm_src_read(src, &dual.ivr, 8);
+  if (ssize != 8) {
+    return ssize == 0 ? TOKEN_EOF : TOKEN_INVALID_DATA;
+  }
+
+  const uint32_t tag = evrbe2tag(dual.ivr.tag);
+  self->da.tag = tag;
+  {
+    const uint32_t ide_vl = bswap_32(dual.ivr.vl);
+    switch (tag) {
+    case TAG_STARTITEM:
+      self->da.vr = VR_NONE;
+      self->da.vl = ide_vl;
+      return vl_is_valid(ide_vl) ? TOKEN_STARTITEM : TOKEN_INVALID_DATA;
+    case TAG_ENDITEM:
+      self->da.vr = VR_NONE;
+      self->da.vl = ide_vl;
+      return ide_vl == 0 ? TOKEN_ENDITEM : TOKEN_INVALID_DATA;
+    case TAG_ENDSQITEM:
+      self->da.vr = VR_NONE;
+      self->da.vl = ide_vl;
+      return ide_vl == 0 ? TOKEN_ENDSQITEM : TOKEN_INVALID_DATA;
+    }
+  }
+
+  const uint32_t vr = dual.evr.vr16;
+  self->da.vr = vr;
+  if (_is_vr16(vr)) {
+    const uint32_t vl = bswap_16(dual.evr.vl16);
+    self->da.vl = vl;
+  } else {
+    ssize = dicm_src_read(src, &dual.evr.vl32, 4);
+    if (ssize != 4) {
+      return TOKEN_INVALID_DATA;
+    }
+    const uint32_t vl = bswap_32(dual.evr.vl32);
+    self->da.vl = vl;
+  }
+
+  if (!_attribute_is_valid(&self->da)) {
+    assert(0);
+    return TOKEN_INVALID_DATA;
+  }
+
+  return TOKEN_KEY;
+}
+
+static inline enum token
+evrbe_level_parser_read_value(struct level_parser *self, struct dicm_src *src) {
+  assert(src);
+  const dicm_vr_t vr = self->da.vr;
+  if (vr == VR_SQ) {
+    /* defined length is tracked by the parser */
+    return TOKEN_STARTSEQUENCE;
+  } else {
+    assert(!dicm_vl_is_undefined(self->da.vl));
+    return TOKEN_VALUE;
+  }
+}
+
+LEVEL_PARSER_NEXT_EVENT(evrbe_level_parser_next_event,
+                        evrbe_level_parser_read_key,
+                        evrbe_level_parser_read_value)
+
+/* specialized fp_next_event, without dispatch through the vtable */
+static inline enum state evrbe_fast_next_event(struct level_parser *self,
+                                               const enum state current_state,
+                                               struct dicm_src *src) {
+  return evrbe_level_parser_next_event(self, current_state, src);
+}
+#endif /* DICM_ENABLE_STRUCTURE_EXPLICT_BE */
+
+#ifdef DICM_ENABLE_STRUCTURE_IMPLICT
+static inline enum token
+ivrle_level_parser_read_key(struct level_parser *self, struct dicm_src *src) {
+  struct dual dual;
+  int64_t ssize = dicm_src_read(src, &dual.ivr, 8);
+  if (ssize != 8) {
+    return ssize == 0 ? TOKEN_EOF : TOKEN_INVALID_DATA;
+  }
+
+  const uint32_t tag = ivrle2tag(dual.ivr.tag);
+  self->da.tag = tag;
+  {
+    const uint32_t ide_vl = dual.ivr.vl;
+    self->da.vl = ide_vl;
+    self->da.vr = VR_NONE;
+    switch (tag) {
+    case TAG_STARTITEM:
+      /* FIXME: no bswap needed at this point */
+      assert(dual.ivr.tag == IVRLE_TAG_STARTITEM);
+      self->da.vr = VR_NONE;
+      self->da.vl = ide_vl;
+      return vl_is_valid(ide_vl) ? TOKEN_STARTITEM : TOKEN_INVALID_DATA;
+    case TAG_ENDITEM:
+      assert(dual.ivr.tag == IVRLE_TAG_ENDITEM);
+      self->da.vr = VR_NONE;
+      self->da.vl = ide_vl;
+      return ide_vl == 0 ? TOKEN_ENDITEM : TOKEN_INVALID_DATA;
+    case TAG_ENDSQITEM:
+      assert(dual.ivr.tag == IVRLE_TAG_ENDSQITEM);
+      self->da.vr = VR_NONE;
+      self->da.vl = ide_vl;
+      return ide_vl == 0 ? TOKEN_ENDSQITEM : TOKEN_INVALID_DATA;
+    }
+  }
+
+  if (!_ivr_attribute_is_valid(&self->da)) {
+    assert(0);
+    return TOKEN_INVALID_DATA;
+  }
+  self->da.vr = dict_get_vr(tag);
+
+  return TOKEN_KEY;
+}
+
+static inline enum token
+ivrle_level_parser_read_value(struct level_parser *self, struct dicm_src *src) {
+  assert(src);
+  const dicm_vr_t vr = self->da.vr;
+  if (dicm_vl_is_undefined(self->da.vl) || vr == VR_SQ) {
+    /* defined length is tracked by the parser */
+    return TOKEN_STARTSEQUENCE;
+  } else {
+    assert(!dicm_vl_is_undefined(self->da.vl));
+    return TOKEN_VALUE;
+  }
+}
+
+LEVEL_PARSER_NEXT_EVENT(ivrle_level_parser_next_event,
+                        ivrle_level_parser_read_key,
+                        ivrle_level_parser_read_value)
+
+/* specialized fp_next_event, without dispatch through the vtable */
+static inline enum state ivrle_fast_next_event(struct level_parser *self,
+                                               const enum state current_state,
+                                               struct dicm_src *src) {
+  return ivrle_level_parser_next_event(self, current_state, src);
+}
+#endif /* DICM_ENABLE_STRUCTURE_IMPLICT */
+
+#endif /* DICM_READER_H */
@@ -1,13 +1,30 @@
 #define _FILE_OFFSET_BITS 64
-#define _POSIX_C_SOURCE 200112L
+#define _POSIX_C_SOURCE 200809L
 
 #include "dicm_src.h"
 
+#include "dicm_configure.h"
 #include "posix_compat.h"
 
 #include <stdio.h>  /* FILE */
 #include <stdlib.h> /* malloc */
 #include <string.h> /* memcpy */
+#ifdef DICM_HAVE_MMAP
+#include <sys/mman.h> /* mmap */
+#endif
+#if defined(DICM_HAVE_MMAP) || defined(DICM_HAVE_PREAD)
+#include <sys/stat.h> /* fstat */
+#endif
+#ifdef DICM_HAVE_PREAD
+#include <errno.h>  /* EINTR */
+#include <fcntl.h>  /* posix_fadvise */
+#include <unistd.h> /* pread */
+#endif
+#ifdef DICM_HAVE_IO_URING
+#include "dicm_uring.h"
+
+#include <sys/uio.h> /* iovec */
+#endif
 
 struct file {
   struct dicm_src super;
@@ -125,10 +142,15 @@ static DICM_CHECK_RETURN int64_t mem_read(struct dicm_src *, void *, size_t)
     DICM_NONNULL();
 static DICM_CHECK_RETURN int64_t mem_seek(struct dicm_src *, int64_t, int)
     DICM_NONNULL();
+static DICM_CHECK_RETURN int64_t mem_borrow(struct dicm_src *, const void **,
+                                            size_t) DICM_NONNULL();
 
 static struct dicm_src_vtable const g_mem_vtable = {
     .obj = {.fp_destroy = mem_destroy},
-    .src = {.fp_read = mem_read, .fp_seek = mem_seek}};
+    .src = {.fp_read = mem_read,
+            .fp_seek = mem_seek,
+            .fp_borrow = mem_borrow,
+            .stable = true}};
 
 int mem_destroy(struct object *obj) {
   struct mem *self = (struct mem *)obj;
@@ -141,13 +163,23 @@ int64_t mem_read(struct dicm_src *const src, void *buf, size_t size) {
   assert(is_aligned(buf, 4));
   const ptrdiff_t diff = self->end - self->cur;
   assert(diff >= 0);
-  if ((size_t)diff >= size) {
-    memcpy(buf, self->cur, size);
-    self->cur += size;
-    return size;
-  }
-  self->cur = self->end;
-  return -1;
+  /* behave like fread: short read at end of buffer, 0 means EOF */
+  const size_t read = (size_t)diff < size ? (size_t)diff : size;
+  memcpy(buf, self->cur, read);
+  self->cur += read;
+  return (int64_t)read;
+}
+
+/* same as mem_read, but hand out a pointer into the buffer instead of copying
+ */
+int64_t mem_borrow(struct dicm_src *const src, const void **pptr, size_t size) {
+  struct mem *self = (struct mem *)src;
+  const ptrdiff_t diff = self->end - self->cur;
+  assert(diff >= 0);
+  const size_t read = (size_t)diff < size ? (size_t)diff : size;
+  *pptr = self->cur;
+  self->cur += read;
+  return (int64_t)read;
 }
 
 int64_t mem_seek(struct dicm_src *const src, int64_t offset, int whence) {
@@ -186,6 +218,826 @@ int dicm_src_mem_create(struct dicm_src **pself, const void *ptr, size_t size) {
   return -1;
 }
 
+#ifdef DICM_HAVE_MMAP
+struct map {
+  struct mem super;
+  /* data */
+  void *addr;
+  size_t length;
+};
+
+static DICM_CHECK_RETURN int map_destroy(struct object *) DICM_NONNULL();
+
+/* reads and seeks are served directly out of the mapping */
+static struct dicm_src_vtable const g_map_vtable = {
+    .obj = {.fp_destroy = map_destroy},
+    .src = {.fp_read = mem_read,
+            .fp_seek = mem_seek,
+            .fp_borrow = mem_borrow,
+            .stable = true}};
+
+int map_destroy(struct object *obj) {
+  struct map *self = (struct map *)obj;
+  int ret = 0;
+  if (self->addr) {
+    ret = munmap(self->addr, self->length);
+  }
+  free(self);
+  return ret;
+}
+
+static inline int advice2madv(const enum dicm_advice_type advice) {
+  switch (advice) {
+  case DICM_ADVICE_SEQUENTIAL:
+    return POSIX_MADV_SEQUENTIAL;
+  case DICM_ADVICE_WILLNEED:
+    return POSIX_MADV_WILLNEED;
+  default:;
+  }
+  return POSIX_MADV_NORMAL;
+}
+
+int dicm_src_mmap_create(struct dicm_src **pself, int fd, int advice) {
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    *pself = NULL;
+    return -1;
+  }
+  const size_t length = (size_t)st.st_size;
+  void *addr = NULL;
+  /* mmap(2) refuses zero-length mapping, an empty file is still valid */
+  if (length != 0) {
+    addr = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      *pself = NULL;
+      return -1;
+    }
+    /* this is only a hint, ignore failure */
+    (void)posix_madvise(addr, length, advice2madv(advice));
+  }
+  struct map *self = (struct map *)malloc(sizeof(*self));
+  if (self) {
+    static const char empty[1];
+    *pself = &self->super.super;
+    self->super.super.vtable = &g_map_vtable;
+    self->super.cur = self->super.beg = addr ? (const char *)addr : empty;
+    self->super.end = self->super.beg + length;
+    self->addr = addr;
+    self->length = length;
+    return 0;
+  }
+  if (addr) {
+    munmap(addr, length);
+  }
+  *pself = NULL;
+  return -1;
+}
+#else
+int dicm_src_mmap_create(struct dicm_src **pself, int fd, int advice) {
+  (void)fd;
+  (void)advice;
+  *pself = NULL;
+  return -1;
+}
+#endif
+
+#ifdef DICM_HAVE_PREAD
+struct fd {
+  struct dicm_src super;
+  /* data */
+  int fd;
+  /* own position, the file position of fd is neither used nor changed */
+  int64_t pos;
+};
+
+static DICM_CHECK_RETURN int fd_destroy(struct object *) DICM_NONNULL();
+static DICM_CHECK_RETURN int64_t fd_read(struct dicm_src *, void *, size_t)
+    DICM_NONNULL();
+static DICM_CHECK_RETURN int64_t fd_seek(struct dicm_src *, int64_t, int)
+    DICM_NONNULL();
+
+static struct dicm_src_vtable const g_fd_vtable = {
+    .obj = {.fp_destroy = fd_destroy},
+    .src = {.fp_read = fd_read, .fp_seek = fd_seek}};
+
+int fd_destroy(struct object *obj) {
+  struct fd *self = (struct fd *)obj;
+  free(self);
+  return 0;
+}
+
+int64_t fd_read(struct dicm_src *const src, void *buf, size_t size) {
+  assert(size <= DICM_SIZE_MAX);
+  struct fd *self = (struct fd *)src;
+  assert(is_aligned(buf, 4));
+  char *out = buf;
+  size_t done = 0;
+  /* short reads are retried, only the end of file stops early */
+  while (done < size) {
+    const ssize_t ret = pread(self->fd, out + done, size - done,
+                              (off_t)(self->pos + (int64_t)done));
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -1;
+    }
+    if (ret == 0) {
+      break;
+    }
+    done += (size_t)ret;
+  }
+  self->pos += (int64_t)done;
+  return (int64_t)done;
+}
+
+int64_t fd_seek(struct dicm_src *const src, int64_t offset, int whence) {
+  struct fd *self = (struct fd *)src;
+  int64_t base = 0;
+  struct stat st;
+  switch (whence) {
+  case SEEK_SET:
+    break;
+  case SEEK_CUR:
+    base = self->pos;
+    break;
+  case SEEK_END:
+    if (fstat(self->fd, &st) != 0) {
+      return -1;
+    }
+    base = (int64_t)st.st_size;
+    break;
+  default:
+    return -1;
+  }
+  if (base + offset < 0) {
+    return -1;
+  }
+  self->pos = base + offset;
+  return self->pos;
+}
+
+#ifdef DICM_HAVE_POSIX_FADVISE
+static inline int advice2fadv(const enum dicm_advice_type advice) {
+  switch (advice) {
+  case DICM_ADVICE_SEQUENTIAL:
+    return POSIX_FADV_SEQUENTIAL;
+  case DICM_ADVICE_WILLNEED:
+    return POSIX_FADV_WILLNEED;
+  default:;
+  }
+  return POSIX_FADV_NORMAL;
+}
+#endif
+
+int dicm_src_fd_create(struct dicm_src **pself, int fd, int64_t offset,
+                       int advice) {
+  struct stat st;
+  if (offset < 0 || fstat(fd, &st) != 0 ||
+      !(S_ISREG(st.st_mode) || S_ISBLK(st.st_mode))) {
+    *pself = NULL;
+    return -1;
+  }
+  struct fd *self = (struct fd *)malloc(sizeof(*self));
+  if (self) {
+    *pself = &self->super;
+    self->super.vtable = &g_fd_vtable;
+    self->fd = fd;
+    self->pos = offset;
+#ifdef DICM_HAVE_POSIX_FADVISE
+    /* this is only a hint, ignore failure */
+    (void)posix_fadvise(fd, (off_t)offset, 0, advice2fadv(advice));
+#else
+    (void)advice;
+#endif
+    return 0;
+  }
+  *pself = NULL;
+  return -1;
+}
+#else
+int dicm_src_fd_create(struct dicm_src **pself, int fd, int64_t offset,
+                       int advice) {
+  (void)fd;
+  (void)offset;
+  (void)advice;
+  *pself = NULL;
+  return -1;
+}
+#endif
+
+#ifdef DICM_HAVE_IO_URING
+/* block waited for or being consumed */
+#define URING_PENDING INT32_MIN
+
+struct uring_src {
+  struct dicm_src super;
+  /* data */
+  int fd;
+  struct uring ring;
+  /* depth blocks, read in order and reused round-robin */
+  char *buf;
+  size_t block_size;
+  unsigned depth;
+  struct iovec *iovs;
+  /* bytes read in each block, URING_PENDING while in flight */
+  int32_t *lens;
+  unsigned inflight;
+  /* current block, its valid bytes are [cur, end) once ready */
+  unsigned head;
+  bool ready;
+  size_t cur;
+  size_t end;
+  /* file offset of the next block to read, no more reads after a short one */
+  int64_t next;
+  bool eof;
+  /* logical position (as seen by the caller) */
+  int64_t pos;
+};
+
+static DICM_CHECK_RETURN int uring_destroy(struct object *) DICM_NONNULL();
+static DICM_CHECK_RETURN int64_t uring_read(struct dicm_src *, void *, size_t)
+    DICM_NONNULL();
+static DICM_CHECK_RETURN int64_t uring_seek(struct dicm_src *, int64_t, int)
+    DICM_NONNULL();
+
+static struct dicm_src_vtable const g_uring_vtable = {
+    .obj = {.fp_destroy = uring_destroy},
+    .src = {.fp_read = uring_read, .fp_seek = uring_seek}};
+
+/* queue the read of block i at the next file offset */
+static int uring_src_queue(struct uring_src *self, const unsigned i) {
+  struct io_uring_sqe *sqe = uring_get_sqe(&self->ring);
+  if (!sqe) {
+    return -1;
+  }
+  sqe->opcode = IORING_OP_READV;
+  sqe->fd = self->fd;
+  sqe->addr = (uint64_t)(uintptr_t)&self->iovs[i];
+  sqe->len = 1;
+  sqe->off = (uint64_t)self->next;
+  sqe->user_data = i;
+  self->lens[i] = URING_PENDING;
+  self->next += (int64_t)self->block_size;
+  ++self->inflight;
+  return 0;
+}
+
+/* wait for all reads in flight, their buffers are written by the kernel */
+static int uring_src_drain(struct uring_src *self) {
+  while (self->inflight != 0) {
+    int32_t res;
+    uint64_t user_data;
+    if (uring_wait(&self->ring, &res, &user_data) < 0) {
+      return -1;
+    }
+    self->lens[user_data] = res;
+    --self->inflight;
+  }
+  return 0;
+}
+
+/* (re)start reading ahead at file offset pos */
+static int uring_src_start(struct uring_src *self, const int64_t pos) {
+  if (uring_src_drain(self) < 0) {
+    return -1;
+  }
+  self->next = pos;
+  self->head = 0;
+  self->ready = false;
+  self->eof = false;
+  for (unsigned i = 0; i < self->depth; ++i) {
+    if (uring_src_queue(self, i) < 0) {
+      return -1;
+    }
+  }
+  return uring_submit(&self->ring);
+}
+
+/* wait for the current block */
+static int uring_src_acquire(struct uring_src *self) {
+  const unsigned head = self->head;
+  while (self->lens[head] == URING_PENDING) {
+    int32_t res;
+    uint64_t user_data;
+    if (uring_wait(&self->ring, &res, &user_data) < 0) {
+      return -1;
+    }
+    self->lens[user_data] = res;
+    --self->inflight;
+  }
+  const int32_t len = self->lens[head];
+  if (len < 0) {
+    return -1;
+  }
+  self->cur = 0;
+  self->end = (size_t)len;
+  self->ready = true;
+  if (self->end < self->block_size) {
+    /* end of file: blocks after this one are not read again */
+    self->eof = true;
+  }
+  return 0;
+}
+
+/* move on to the next block, the current one is read again further ahead */
+static int uring_src_release(struct uring_src *self) {
+  const unsigned head = self->head;
+  self->ready = false;
+  self->head = (head + 1) % self->depth;
+  if (self->eof) {
+    self->lens[head] = 0;
+    return 0;
+  }
+  if (uring_src_queue(self, head) < 0) {
+    return -1;
+  }
+  return uring_submit(&self->ring);
+}
+
+/* copy (or skip when out is NULL) up to size bytes */
+static int64_t uring_src_consume(struct uring_src *self, char *out,
+                                 size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    if (!self->ready && uring_src_acquire(self) < 0) {
+      break;
+    }
+    const size_t avail = self->end - self->cur;
+    if (avail == 0) {
+      if (self->end < self->block_size) {
+        /* end of file */
+        break;
+      }
+      if (uring_src_release(self) < 0) {
+        break;
+      }
+      continue;
+    }
+    const size_t remaining = size - done;
+    const size_t len = avail < remaining ? avail : remaining;
+    if (out) {
+      memcpy(out + done,
+             self->buf + (size_t)self->head * self->block_size + self->cur,
+             len);
+    }
+    self->cur += len;
+    done += len;
+  }
+  self->pos += (int64_t)done;
+  if (done < size && !(self->ready && self->end < self->block_size)) {
+    /* not the end of file */
+    return done != 0 ? (int64_t)done : -1;
+  }
+  return (int64_t)done;
+}
+
+int uring_destroy(struct object *obj) {
+  struct uring_src *self = (struct uring_src *)obj;
+  const int ret = uring_src_drain(self);
+  uring_exit(&self->ring);
+  free(self->lens);
+  free(self->iovs);
+  free(self->buf);
+  free(self);
+  return ret;
+}
+
+int64_t uring_read(struct dicm_src *const src, void *buf, size_t size) {
+  struct uring_src *self = (struct uring_src *)src;
+  assert(is_aligned(buf, 4));
+  return uring_src_consume(self, buf, size);
+}
+
+int64_t uring_seek(struct dicm_src *const src, int64_t offset, int whence) {
+  struct uring_src *self = (struct uring_src *)src;
+  int64_t target = offset;
+  struct stat st;
+  switch (whence) {
+  case SEEK_SET:
+    break;
+  case SEEK_CUR:
+    target += self->pos;
+    break;
+  case SEEK_END:
+    if (fstat(self->fd, &st) != 0) {
+      return -1;
+    }
+    target += (int64_t)st.st_size;
+    break;
+  default:
+    return -1;
+  }
+  if (target < 0) {
+    return -1;
+  }
+  if (target >= self->pos && target < self->next) {
+    /* forward seek within the blocks read ahead */
+    const int64_t skip = target - self->pos;
+    if (uring_src_consume(self, NULL, (size_t)skip) != skip) {
+      return -1;
+    }
+    return self->pos;
+  }
+  if (uring_src_start(self, target) < 0) {
+    return -1;
+  }
+  self->pos = target;
+  return self->pos;
+}
+
+enum { URING_DEFAULT_DEPTH = 8, URING_DEFAULT_BLOCK_SIZE = 262144 };
+
+static int uring_src_create(struct dicm_src **pself, int fd, int64_t offset,
+                            unsigned depth, size_t block_size) {
+  struct uring_src *self = (struct uring_src *)malloc(sizeof(*self));
+  if (!self) {
+    return -1;
+  }
+  self->depth = depth != 0 ? depth : URING_DEFAULT_DEPTH;
+  self->block_size = block_size != 0 ? block_size : URING_DEFAULT_BLOCK_SIZE;
+  if (self->block_size > DICM_SIZE_MAX ||
+      uring_init(&self->ring, self->depth) < 0) {
+    free(self);
+    return -1;
+  }
+  self->buf = malloc(self->depth * self->block_size);
+  self->iovs = malloc(self->depth * sizeof *self->iovs);
+  self->lens = malloc(self->depth * sizeof *self->lens);
+  self->fd = fd;
+  self->inflight = 0;
+  self->pos = offset;
+  if (self->buf && self->iovs && self->lens) {
+    for (unsigned i = 0; i < self->depth; ++i) {
+      self->iovs[i].iov_base = self->buf + (size_t)i * self->block_size;
+      self->iovs[i].iov_len = self->block_size;
+    }
+    if (uring_src_start(self, offset) == 0) {
+      *pself = &self->super;
+      self->super.vtable = &g_uring_vtable;
+      return 0;
+    }
+  }
+  (void)uring_src_drain(self);
+  uring_exit(&self->ring);
+  free(self->lens);
+  free(self->iovs);
+  free(self->buf);
+  free(self);
+  return -1;
+}
+#endif
+
+int dicm_src_uring_create(struct dicm_src **pself, int fd, int64_t offset,
+                          unsigned depth, size_t block_size) {
+#ifdef DICM_HAVE_IO_URING
+  struct stat st;
+  if (offset < 0 || fstat(fd, &st) != 0 ||
+      !(S_ISREG(st.st_mode) || S_ISBLK(st.st_mode))) {
+    *pself = NULL;
+    return -1;
+  }
+  if (uring_src_create(pself, fd, offset, depth, block_size) == 0) {
+    return 0;
+  }
+#else
+  (void)depth;
+  (void)block_size;
+#endif
+  /* io_uring not available */
+  return dicm_src_fd_create(pself, fd, offset, DICM_ADVICE_SEQUENTIAL);
+}
+
+struct buffered {
+  struct dicm_src super;
+  /* data */
+  struct dicm_src *src;
+  /* read-ahead window (size + 4 bytes), valid bytes are [cur, end) */
+  char *buf;
+  size_t size;
+  size_t cur;
+  size_t end;
+  /* logical position (as seen by the caller) */
+  int64_t pos;
+};
+
+static DICM_CHECK_RETURN int buffered_destroy(struct object *) DICM_NONNULL();
+static DICM_CHECK_RETURN int64_t buffered_read(struct dicm_src *, void *,
+                                               size_t) DICM_NONNULL();
+static DICM_CHECK_RETURN int64_t buffered_seek(struct dicm_src *, int64_t, int)
+    DICM_NONNULL();
+static DICM_CHECK_RETURN int64_t buffered_borrow(struct dicm_src *,
+                                                 const void **, size_t)
+    DICM_NONNULL();
+
+static struct dicm_src_vtable const g_buffered_vtable = {
+    .obj = {.fp_destroy = buffered_destroy},
+    .src = {.fp_read = buffered_read,
+            .fp_seek = buffered_seek,
+            .fp_borrow = buffered_borrow}};
+
+static struct dicm_src_vtable const g_buffered_stream_vtable = {
+    .obj = {.fp_destroy = buffered_destroy},
+    .src = {.fp_read = buffered_read,
+            .fp_seek = NULL,
+            .fp_borrow = buffered_borrow}};
+
+int buffered_destroy(struct object *obj) {
+  struct buffered *self = (struct buffered *)obj;
+  /* give back what was read ahead, so that src can be used again */
+  const size_t avail = self->end - self->cur;
+  int ret = 0;
+  if (avail != 0 && self->src->vtable->src.fp_seek &&
+      dicm_src_seek(self->src, -(int64_t)avail, SEEK_CUR) < 0) {
+    ret = -1;
+  }
+  free(self->buf);
+  free(self);
+  return ret;
+}
+
+/* move pending bytes to the front and fill the window until at least `want`
+ * bytes are available (or EOF). Sources require 4-bytes aligned buffers, so
+ * pending bytes are shifted so that the write position stays aligned. */
+static int64_t buffered_fill(struct buffered *self, size_t want) {
+  assert(want <= self->size);
+  size_t avail = self->end - self->cur;
+  while (avail < want) {
+    const size_t shift = (4 - avail % 4) % 4;
+    if (self->cur != shift) {
+      memmove(self->buf + shift, self->buf + self->cur, avail);
+      self->cur = shift;
+      self->end = shift + avail;
+    }
+    const size_t room = self->size + sizeof(uint32_t) - self->end;
+    const int64_t ssize = dicm_src_read(self->src, self->buf + self->end, room);
+    if (ssize < 0) {
+      return -1;
+    }
+    if (ssize == 0) {
+      break;
+    }
+    self->end += (size_t)ssize;
+    avail += (size_t)ssize;
+  }
+  return (int64_t)avail;
+}
+
+int64_t buffered_read(struct dicm_src *const src, void *buf, size_t size) {
+  struct buffered *self = (struct buffered *)src;
+  char *out = buf;
+  const size_t avail = self->end - self->cur;
+  if (likely(size <= avail)) {
+    /* fast path: served from the window */
+    memcpy(out, self->buf + self->cur, size);
+    self->cur += size;
+    self->pos += (int64_t)size;
+    return (int64_t)size;
+  }
+  /* drain the window */
+  memcpy(out, self->buf + self->cur, avail);
+  self->cur = self->end = 0;
+  size_t done = avail;
+  while (done < size) {
+    const size_t remaining = size - done;
+    int64_t ssize;
+    if (remaining >= self->size && is_aligned(out + done, 4)) {
+      /* large read: bypass the window */
+      ssize = dicm_src_read(self->src, out + done, remaining);
+    } else {
+      ssize = buffered_fill(self, remaining < self->size ? remaining : 1);
+      if (ssize > 0) {
+        const size_t len =
+            (size_t)ssize < remaining ? (size_t)ssize : remaining;
+        memcpy(out + done, self->buf + self->cur, len);
+        self->cur += len;
+        ssize = (int64_t)len;
+      }
+    }
+    if (ssize < 0) {
+      self->pos += (int64_t)done;
+      return done != 0 ? (int64_t)done : -1;
+    }
+    if (ssize == 0) {
+      break;
+    }
+    done += (size_t)ssize;
+  }
+  self->pos += (int64_t)done;
+  return (int64_t)done;
+}
+
+int64_t buffered_seek(struct dicm_src *const src, int64_t offset, int whence) {
+  struct buffered *self = (struct buffered *)src;
+  const int64_t avail = (int64_t)(self->end - self->cur);
+  if (whence == SEEK_CUR && offset >= 0 && offset <= avail) {
+    /* forward seek within the window, no need to discard it */
+    self->cur += (size_t)offset;
+    self->pos += offset;
+    return self->pos;
+  }
+  /* underlying position is ahead of the logical one */
+  const int64_t ret = dicm_src_seek(
+      self->src, whence == SEEK_CUR ? offset - avail : offset, whence);
+  if (ret < 0) {
+    return ret;
+  }
+  self->cur = self->end = 0;
+  self->pos = ret;
+  return ret;
+}
+
+int64_t buffered_borrow(struct dicm_src *const src, const void **pptr,
+                        size_t size) {
+  struct buffered *self = (struct buffered *)src;
+  if (size > self->size) {
+    /* the window keeps its size: at most a window full, the caller copies
+     * the rest */
+    size = self->size;
+  }
+  int64_t avail = (int64_t)(self->end - self->cur);
+  if ((size_t)avail < size) {
+    avail = buffered_fill(self, size);
+    if (avail < 0) {
+      return -1;
+    }
+  }
+  const size_t len = (size_t)avail < size ? (size_t)avail : size;
+  *pptr = self->buf + self->cur;
+  self->cur += len;
+  self->pos += (int64_t)len;
+  return (int64_t)len;
+}
+
+enum { BUFFERED_DEFAULT_SIZE = 65536 };
+
+int dicm_src_buffered_create(struct dicm_src **pself, struct dicm_src *src,
+                             size_t size) {
+  struct buffered *self = (struct buffered *)malloc(sizeof(*self));
+  if (self) {
+    self->size = size != 0 ? size : BUFFERED_DEFAULT_SIZE;
+    /* extra room to keep reads aligned, see buffered_fill */
+    self->buf = malloc(self->size + sizeof(uint32_t));
+    if (self->buf) {
+      const bool seekable = src->vtable->src.fp_seek != NULL;
+      *pself = &self->super;
+      self->super.vtable =
+          seekable ? &g_buffered_vtable : &g_buffered_stream_vtable;
+      self->src = src;
+      self->cur = self->end = 0;
+      const int64_t pos = seekable ? dicm_src_seek(src, 0, SEEK_CUR) : 0;
+      self->pos = pos > 0 ? pos : 0;
+      return 0;
+    }
+    free(self);
+  }
+  *pself = NULL;
+  return -1;
+}
+
+struct push {
+  struct dicm_src super;
+  /* data */
+  /* bytes fed so far, pending bytes are [cur, end) */
+  char *buf;
+  size_t size;
+  size_t cur;
+  size_t end;
+  /* rollback point of an interrupted read */
+  size_t mark;
+  /* no more bytes will be fed */
+  bool final;
+  /* a read could not be served from the pending bytes */
+  bool starved;
+};
+
+static DICM_CHECK_RETURN int push_destroy(struct object *) DICM_NONNULL();
+static DICM_CHECK_RETURN int64_t push_read(struct dicm_src *, void *, size_t)
+    DICM_NONNULL();
+static DICM_CHECK_RETURN int64_t push_borrow(struct dicm_src *, const void **,
+                                             size_t) DICM_NONNULL();
+
+/* not seekable: bytes before the mark are dropped on the next feed */
+static struct dicm_src_vtable const g_push_vtable = {
+    .obj = {.fp_destroy = push_destroy},
+    .src = {.fp_read = push_read, .fp_seek = NULL, .fp_borrow = push_borrow}};
+
+int push_destroy(struct object *obj) {
+  struct push *self = (struct push *)obj;
+  free(self->buf);
+  free(self);
+  return 0;
+}
+
+/* serve up to size pending bytes, a short read is only an EOF once the input
+ * is final */
+static inline size_t push_take(struct push *self, size_t size) {
+  const size_t avail = self->end - self->cur;
+  if (avail < size) {
+    self->starved = !self->final;
+    size = avail;
+  }
+  self->cur += size;
+  return size;
+}
+
+int64_t push_read(struct dicm_src *const src, void *buf, size_t size) {
+  struct push *self = (struct push *)src;
+  const char *ptr = self->buf + self->cur;
+  const size_t read = push_take(self, size);
+  memcpy(buf, ptr, read);
+  return (int64_t)read;
+}
+
+int64_t push_borrow(struct dicm_src *const src, const void **pptr,
+                    size_t size) {
+  struct push *self = (struct push *)src;
+  *pptr = self->buf + self->cur;
+  return (int64_t)push_take(self, size);
+}
+
+enum { PUSH_DEFAULT_SIZE = 4096 };
+
+int src_push_create(struct dicm_src **pself) {
+  struct push *self = (struct push *)malloc(sizeof(*self));
+  if (self) {
+    self->size = PUSH_DEFAULT_SIZE;
+    self->buf = malloc(self->size);
+    if (self->buf) {
+      *pself = &self->super;
+      self->super.vtable = &g_push_vtable;
+      self->cur = self->end = self->mark = 0;
+      self->final = false;
+      self->starved = false;
+      return 0;
+    }
+    free(self);
+  }
+  *pself = NULL;
+  return -1;
+}
+
+int src_push_feed(struct dicm_src *src, const void *ptr, size_t len) {
+  struct push *self = (struct push *)src;
+  if (self->final) {
+    return -1;
+  }
+  if (len == 0) {
+    self->final = true;
+    return 0;
+  }
+  /* drop consumed bytes, then grow if needed */
+  const size_t pending = self->end - self->mark;
+  if (self->mark != 0) {
+    memmove(self->buf, self->buf + self->mark, pending);
+    self->cur -= self->mark;
+    self->end = pending;
+    self->mark = 0;
+  }
+  if (pending + len > self->size) {
+    size_t size = self->size;
+    while (size < pending + len) {
+      size *= 2;
+    }
+    char *buf = realloc(self->buf, size);
+    if (!buf) {
+      return -1;
+    }
+    self->buf = buf;
+    self->size = size;
+  }
+  memcpy(self->buf + self->end, ptr, len);
+  self->end += len;
+  return 0;
+}
+
+size_t src_push_peek(const struct dicm_src *src, const void **pptr) {
+  const struct push *self = (const struct push *)src;
+  *pptr = self->buf + self->cur;
+  return self->final ? SIZE_MAX : self->end - self->cur;
+}
+
+void src_push_set_starved(struct dicm_src *src) {
+  struct push *self = (struct push *)src;
+  self->starved = !self->final;
+}
+
+void src_push_set_mark(struct dicm_src *src) {
+  struct push *self = (struct push *)src;
+  self->mark = self->cur;
+  self->starved = false;
+}
+
+bool src_push_rewind(struct dicm_src *src) {
+  struct push *self = (struct push *)src;
+  const bool starved = self->starved;
+  if (starved) {
+    self->cur = self->mark;
+    self->starved = false;
+  }
+  return starved;
+}
+
 static DICM_CHECK_RETURN int user_destroy(struct object *) DICM_NONNULL();
 int user_destroy(struct object *obj) {
   struct dicm_src_user *self = (struct dicm_src_user *)obj;
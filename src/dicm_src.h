@@ -10,6 +10,12 @@ struct src_prv_vtable {
       DICM_NONNULL();
   DICM_CHECK_RETURN int64_t (*fp_seek)(struct dicm_src *, int64_t, int)
       DICM_NONNULL();
+  /* optional, zero-copy access to the next bytes of contiguous sources */
+  DICM_CHECK_RETURN int64_t (*fp_borrow)(struct dicm_src *, const void **,
+                                         size_t) DICM_NONNULL();
+  /* borrowed bytes stay valid until the source is deleted (the whole input
+   * is in memory), not only until the next call */
+  bool stable;
 };
 
 struct dicm_src_vtable {
@@ -20,5 +26,25 @@ struct dicm_src_vtable {
 /* common src interface */
 #define dicm_src_read(t, b, s) ((t)->vtable->src.fp_read((t), (b), (s)))
 #define dicm_src_seek(t, b, s) ((t)->vtable->src.fp_seek((t), (b), (s)))
+#define dicm_src_borrow(t, p, s) ((t)->vtable->src.fp_borrow((t), (p), (s)))
+#define dicm_src_can_borrow(t) ((t)->vtable->src.fp_borrow != NULL)
+#define dicm_src_is_stable(t) ((t)->vtable->src.stable)
+
+/* push source, bytes are fed by the application (see dicm_parser_feed) */
+DICM_CHECK_RETURN int src_push_create(struct dicm_src **pself) DICM_NONNULL();
+/* append len bytes, len 0 marks the end of the input */
+DICM_CHECK_RETURN int src_push_feed(struct dicm_src *src, const void *ptr,
+                                    size_t len) DICM_NONNULL(1);
+/* pending bytes, unbounded once the input is final */
+size_t src_push_peek(const struct dicm_src *src, const void **pptr)
+    DICM_NONNULL();
+/* a read would run out of bytes, as if it was attempted */
+void src_push_set_starved(struct dicm_src *src) DICM_NONNULL();
+/* start of a read that may be interrupted, borrowed bytes before the mark
+ * are released on the next feed */
+void src_push_set_mark(struct dicm_src *src) DICM_NONNULL();
+/* when a read ran out of bytes since the mark, move back to the mark and
+ * return true */
+bool src_push_rewind(struct dicm_src *src) DICM_NONNULL();
 
 #endif /* DICM_SRC_H */
@@ -0,0 +1,73 @@
+#include "dicm_swap.h"
+
+#include "dicm_private.h"
+
+#include <string.h> /* memcpy */
+
+/*
+ * Portable kernels: numbers are swapped 8 bytes at a time with 64-bit
+ * integer operations (SWAR), which compilers also turn into vector code when
+ * available. Loads and stores go through memcpy, any alignment is fine.
+ */
+
+static inline uint64_t load64(const unsigned char *p) {
+  uint64_t v;
+  memcpy(&v, p, sizeof v);
+  return v;
+}
+
+static inline void store64(unsigned char *p, const uint64_t v) {
+  memcpy(p, &v, sizeof v);
+}
+
+static void swap16(void *ptr, size_t len) {
+  const uint64_t mask = UINT64_C(0x00ff00ff00ff00ff);
+  unsigned char *p = ptr;
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    const uint64_t v = load64(p + i);
+    store64(p + i, (v & mask) << 8u | (v >> 8u & mask));
+  }
+  for (; i < len; i += 2) {
+    const unsigned char c = p[i];
+    p[i] = p[i + 1];
+    p[i + 1] = c;
+  }
+}
+
+static void swap32(void *ptr, size_t len) {
+  unsigned char *p = ptr;
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8) {
+    /* both halves reversed, then put back in place */
+    const uint64_t v = bswap_64(load64(p + i));
+    store64(p + i, v << 32u | v >> 32u);
+  }
+  if (i < len) {
+    uint32_t v;
+    memcpy(&v, p + i, sizeof v);
+    v = bswap_32(v);
+    memcpy(p + i, &v, sizeof v);
+  }
+}
+
+static void swap64(void *ptr, size_t len) {
+  unsigned char *p = ptr;
+  for (size_t i = 0; i < len; i += 8) {
+    store64(p + i, bswap_64(load64(p + i)));
+  }
+}
+
+swap_kernel_t swap_get_kernel(const unsigned size) {
+  switch (size) {
+  case 2:
+    return swap16;
+  case 4:
+    return swap32;
+  case 8:
+    return swap64;
+  default:
+    assert(0);
+    return NULL;
+  }
+}
@@ -0,0 +1,13 @@
+#ifndef DICM_SWAP_H
+#define DICM_SWAP_H
+
+#include <stddef.h> /* size_t */
+
+/* reverse the bytes of each number in place, len is a multiple of the number
+ * size */
+typedef void (*swap_kernel_t)(void *ptr, size_t len);
+
+/* kernel for numbers of 2, 4 or 8 bytes */
+swap_kernel_t swap_get_kernel(unsigned size);
+
+#endif /* DICM_SWAP_H */
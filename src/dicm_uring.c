@@ -0,0 +1,130 @@
+#define _DEFAULT_SOURCE
+
+#include "dicm_uring.h"
+
+#include <errno.h>       /* EINTR */
+#include <string.h>      /* memset */
+#include <sys/mman.h>    /* mmap */
+#include <sys/syscall.h> /* __NR_io_uring_setup */
+#include <unistd.h>      /* syscall */
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params *p) {
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit,
+                              unsigned min_complete, unsigned flags) {
+  return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                      NULL, (size_t)0);
+}
+
+/* ring indexes are shared with the kernel */
+static inline unsigned load_acquire(const unsigned *p) {
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline void store_release(unsigned *p, const unsigned v) {
+  __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+int uring_init(struct uring *ring, unsigned entries) {
+  struct io_uring_params p;
+  memset(&p, 0, sizeof p);
+  memset(ring, 0, sizeof *ring);
+  ring->fd = sys_io_uring_setup(entries, &p);
+  if (ring->fd < 0) {
+    return -1;
+  }
+  /* map the queues separately, whether or not the kernel has
+   * IORING_FEAT_SINGLE_MMAP */
+  ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  ring->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+  ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+  ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+  void *sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+  if (ring->sq_ptr == MAP_FAILED || ring->cq_ptr == MAP_FAILED ||
+      sqes == MAP_FAILED) {
+    ring->sqes = sqes == MAP_FAILED ? NULL : sqes;
+    uring_exit(ring);
+    return -1;
+  }
+  char *sq = ring->sq_ptr;
+  ring->sq_khead = (unsigned *)(sq + p.sq_off.head);
+  ring->sq_ktail = (unsigned *)(sq + p.sq_off.tail);
+  ring->sq_mask = *(unsigned *)(sq + p.sq_off.ring_mask);
+  ring->sq_array = (unsigned *)(sq + p.sq_off.array);
+  ring->sq_entries = p.sq_entries;
+  ring->sq_tail = *ring->sq_ktail;
+  ring->sqes = sqes;
+  char *cq = ring->cq_ptr;
+  ring->cq_khead = (unsigned *)(cq + p.cq_off.head);
+  ring->cq_ktail = (unsigned *)(cq + p.cq_off.tail);
+  ring->cq_mask = *(unsigned *)(cq + p.cq_off.ring_mask);
+  ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+  return 0;
+}
+
+void uring_exit(struct uring *ring) {
+  if (ring->sqes) {
+    munmap(ring->sqes, ring->sqes_size);
+  }
+  if (ring->cq_ptr && ring->cq_ptr != MAP_FAILED) {
+    munmap(ring->cq_ptr, ring->cq_size);
+  }
+  if (ring->sq_ptr && ring->sq_ptr != MAP_FAILED) {
+    munmap(ring->sq_ptr, ring->sq_size);
+  }
+  close(ring->fd);
+}
+
+struct io_uring_sqe *uring_get_sqe(struct uring *ring) {
+  const unsigned head = load_acquire(ring->sq_khead);
+  if (ring->sq_tail - head == ring->sq_entries) {
+    return NULL;
+  }
+  const unsigned index = ring->sq_tail & ring->sq_mask;
+  struct io_uring_sqe *sqe = &ring->sqes[index];
+  memset(sqe, 0, sizeof *sqe);
+  ring->sq_array[index] = index;
+  ++ring->sq_tail;
+  return sqe;
+}
+
+/* publish new entries, return the count of entries not consumed by the
+ * kernel yet */
+static unsigned uring_flush(struct uring *ring) {
+  store_release(ring->sq_ktail, ring->sq_tail);
+  return ring->sq_tail - load_acquire(ring->sq_khead);
+}
+
+int uring_submit(struct uring *ring) {
+  unsigned count;
+  while ((count = uring_flush(ring)) != 0) {
+    if (sys_io_uring_enter(ring->fd, count, 0, 0) < 0 && errno != EINTR) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int uring_wait(struct uring *ring, int32_t *res, uint64_t *user_data) {
+  for (;;) {
+    const unsigned head = *ring->cq_khead;
+    if (head != load_acquire(ring->cq_ktail)) {
+      const struct io_uring_cqe *cqe = &ring->cqes[head & ring->cq_mask];
+      *res = cqe->res;
+      *user_data = cqe->user_data;
+      store_release(ring->cq_khead, head + 1);
+      return 0;
+    }
+    const unsigned count = uring_flush(ring);
+    if (sys_io_uring_enter(ring->fd, count, 1, IORING_ENTER_GETEVENTS) < 0 &&
+        errno != EINTR) {
+      return -1;
+    }
+  }
+}
@@ -0,0 +1,53 @@
+#ifndef DICM_URING_H
+#define DICM_URING_H
+
+#include <linux/io_uring.h>
+
+#include <stddef.h> /* size_t */
+#include <stdint.h> /* uint64_t */
+
+/*
+ * Minimal io_uring ring on top of the raw system calls, no liburing. A ring
+ * is used by a single thread.
+ */
+struct uring {
+  int fd;
+  /* submission queue, entries up to sq_tail are not submitted yet */
+  unsigned *sq_khead;
+  unsigned *sq_ktail;
+  unsigned sq_mask;
+  unsigned *sq_array;
+  struct io_uring_sqe *sqes;
+  unsigned sq_tail;
+  unsigned sq_entries;
+  /* completion queue */
+  unsigned *cq_khead;
+  unsigned *cq_ktail;
+  unsigned cq_mask;
+  struct io_uring_cqe *cqes;
+  /* mappings */
+  void *sq_ptr;
+  size_t sq_size;
+  void *cq_ptr;
+  size_t cq_size;
+  size_t sqes_size;
+};
+
+/* set up a ring of at least entries submission entries, -1 when io_uring is
+ * not available (old kernel, seccomp) */
+int uring_init(struct uring *ring, unsigned entries);
+
+void uring_exit(struct uring *ring);
+
+/* next free submission entry, cleared. NULL when the queue is full */
+struct io_uring_sqe *uring_get_sqe(struct uring *ring);
+
+/* hand pending entries to the kernel */
+int uring_submit(struct uring *ring);
+
+/* wait for the next completion, submitting pending entries first. Return
+ * the result and the user data of the request, -1 on error of the ring
+ * itself */
+int uring_wait(struct uring *ring, int32_t *res, uint64_t *user_data);
+
+#endif /* DICM_URING_H */
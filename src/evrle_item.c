@@ -1,57 +1,11 @@
 #include "dicm_item.h"
 
 #include "dicm_dst.h"
+#include "dicm_reader.h"
 #include "dicm_src.h"
 
 #include <assert.h>
 
-static inline bool _tag_is_valid(const dicm_tag_t tag) {
-  // The following cases have been handled by design:
-  assert(tag != TAG_STARTITEM && tag != TAG_ENDITEM && tag != TAG_ENDSQITEM);
-  // FIXME: valid for DataSet but not CommandSet
-  return dicm_tag_get_group(tag) >= 0x0008;
-}
-
-static inline bool _tag_is_creator(const dicm_tag_t tag) {
-  const uint_fast16_t element = dicm_tag_get_element(tag);
-  return dicm_tag_is_private(tag) && (element > 0x0 && element <= 0xff);
-}
-
-static inline bool _vr_is_valid(const dicm_vr_t vr) {
-  if ((vr & 0xffff0000) != 0x0) {
-    return false;
-  }
-  const char *str = dicm_vr_get_string(vr);
-  return str[0] >= 'A' && str[0] <= 'Z' && str[1] >= 'A' && str[1] <= 'Z';
-}
-
-static inline bool vl_is_valid(const dicm_vl_t vl) {
-  return dicm_vl_is_undefined(vl) || vl % 2 == 0;
-}
-
-static inline bool _attribute_is_valid(const struct key_info *da) {
-  // 1. check triplet separately:
-  const bool valid =
-      _tag_is_valid(da->tag) && _vr_is_valid(da->vr) && vl_is_valid(da->vl);
-  if (!valid) {
-    return false;
-  }
-  // 2. handle finer cases here:
-  if (dicm_vl_is_undefined(da->vl) && da->vr != VR_SQ) {
-    if (!dicm_attribute_is_encapsulated_pixel_data(da)) {
-      return false;
-    }
-  }
-  if (dicm_tag_is_group_length(da->tag)) {
-    if (da->vr != VR_UL)
-      return false;
-  } else if (_tag_is_creator(da->tag)) {
-    if (da->vr != VR_LO)
-      return false;
-  }
-  return true;
-}
-
 #define level_parser_key_token(t, src)                                         \
   ((t)->vtable->reader.fp_key_token((t), (src)))
 #define level_parser_value_token(t, src)                                       \
@@ -62,163 +16,12 @@ static inline bool _attribute_is_valid(const struct key_info *da) {
 #define level_emitter_value_token(t, dst, tok)                                 \
   ((t)->vtable->level_emitter.fp_value_token((t), (dst), (tok)))
 
-#define SWAP_TAG(x) ((((x)&0x0000ffff) << 16u) | (((x)&0xffff0000) >> 16u))
-
-static inline uint32_t evrle2tag(const uint32_t tag_bytes) {
-  return SWAP_TAG(tag_bytes);
-}
-
-enum EVRLE_SPECIAL_TAGS {
-  EVRLE_TAG_STARTITEM = SWAP_TAG(TAG_STARTITEM),
-  EVRLE_TAG_ENDITEM = SWAP_TAG(TAG_ENDITEM),
-  EVRLE_TAG_ENDSQITEM = SWAP_TAG(TAG_ENDSQITEM),
-};
-
 static const struct ivr evrle_start_item = {.tag = EVRLE_TAG_STARTITEM,
                                             .vl = VL_UNDEFINED};
 static const struct ivr evrle_end_item = {.tag = EVRLE_TAG_ENDITEM, .vl = 0};
 static const struct ivr evrle_end_sq_item = {.tag = EVRLE_TAG_ENDSQITEM,
                                              .vl = 0};
 
-static enum token evrle_level_parser_read_key(struct level_parser *self,
-                                              struct dicm_src *src) {
-  struct dual dual;
-  int64_t ssize = dicm_src_read(src, &dual.ivr, 8);
-  if (ssize != 8) {
-    return ssize == 0 ? TOKEN_EOF : TOKEN_INVALID_DATA;
-  }
-
-  const uint32_t tag = evrle2tag(dual.ivr.tag);
-  self->da.tag = tag;
-  {
-    const uint32_t ide_vl = dual.ivr.vl;
-    switch (tag) {
-    case TAG_STARTITEM:
-      /* FIXME: no bswap needed at this point */
-      assert(dual.ivr.tag == EVRLE_TAG_STARTITEM);
-      self->da.vr = VR_NONE;
-      self->da.vl = ide_vl;
-      return vl_is_valid(ide_vl) ? TOKEN_STARTITEM : TOKEN_INVALID_DATA;
-    case TAG_ENDITEM:
-      assert(dual.ivr.tag == EVRLE_TAG_ENDITEM);
-      self->da.vr = VR_NONE;
-      self->da.vl = ide_vl;
-      return ide_vl == 0 ? TOKEN_ENDITEM : TOKEN_INVALID_DATA;
-    case TAG_ENDSQITEM:
-      assert(dual.ivr.tag == EVRLE_TAG_ENDSQITEM);
-      self->da.vr = VR_NONE;
-      self->da.vl = ide_vl;
-      return ide_vl == 0 ? TOKEN_ENDSQITEM : TOKEN_INVALID_DATA;
-    }
-  }
-
-  const uint32_t vr = dual.evr.vr16;
-  self->da.vr = vr;
-  if (_is_vr16(vr)) {
-    const uint32_t vl = dual.evr.vl16;
-    self->da.vl = vl;
-  } else {
-    ssize = dicm_src_read(src, &dual.evr.vl32, 4);
-    if (ssize != 4) {
-      return TOKEN_INVALID_DATA;
-    }
-    const uint32_t vl = dual.evr.vl32;
-    self->da.vl = vl;
-  }
-
-  if (!_attribute_is_valid(&self->da)) {
-    assert(0);
-    return TOKEN_INVALID_DATA;
-  }
-
-  return TOKEN_KEY;
-}
-
-static enum token evrle_level_parser_read_value(struct level_parser *self,
-                                                struct dicm_src *src) {
-  assert(src);
-  const dicm_vr_t vr = self->da.vr;
-  if (vr == VR_SQ) {
-    assert(dicm_vl_is_undefined(self->da.vl)); // for now
-    return TOKEN_STARTSEQUENCE;
-  } else {
-    assert(!dicm_vl_is_undefined(self->da.vl));
-    return TOKEN_VALUE;
-  }
-}
-
-static enum state evrle_ds_reader_next_event(struct level_parser *self,
-                                             const enum state current_state,
-                                             struct dicm_src *src) {
-  enum token next;
-  enum state new_state = STATE_INVALID;
-  switch (current_state) {
-  case STATE_STARTDOCUMENT: /* enter state */
-    next = level_parser_key_token(self, src);
-    /* empty document is an error */
-    new_state = next == TOKEN_KEY ? STATE_KEY : STATE_INVALID;
-    break;
-  case STATE_KEY:
-    next = level_parser_value_token(self, src);
-    assert(next == TOKEN_VALUE || next == TOKEN_STARTSEQUENCE);
-    new_state = next == TOKEN_VALUE
-                    ? STATE_VALUE
-                    : (next == TOKEN_STARTSEQUENCE ? STATE_STARTSEQUENCE
-                                                   : STATE_INVALID);
-    break;
-  case STATE_VALUE:
-  case STATE_ENDSEQUENCE: // re-enter case
-    next = level_parser_key_token(self, src);
-    if (next == TOKEN_EOF) {
-      new_state = STATE_ENDDOCUMENT;
-    } else {
-      assert(next == TOKEN_KEY);
-      new_state = next == TOKEN_KEY ? STATE_KEY : STATE_INVALID;
-    }
-    break;
-  default:
-    assert(0);
-  }
-  return new_state;
-}
-
-static enum state evrle_level_parser_next_event(struct level_parser *self,
-                                                const enum state current_state,
-                                                struct dicm_src *src) {
-  enum token next;
-  enum state new_state = STATE_INVALID;
-  switch (current_state) {
-  case STATE_STARTSEQUENCE: /* enter state */
-  case STATE_ENDITEM:
-    next = level_parser_key_token(self, src);
-    assert(next == TOKEN_STARTITEM || next == TOKEN_ENDSQITEM);
-    new_state =
-        next == TOKEN_STARTITEM
-            ? STATE_STARTITEM
-            : (next == TOKEN_ENDSQITEM ? STATE_ENDSEQUENCE : STATE_INVALID);
-    break;
-  case STATE_KEY:
-    next = level_parser_value_token(self, src);
-    assert(next == TOKEN_VALUE || next == TOKEN_STARTSEQUENCE);
-    new_state = next == TOKEN_VALUE
-                    ? STATE_VALUE
-                    : (next == TOKEN_STARTSEQUENCE ? STATE_STARTSEQUENCE
-                                                   : STATE_INVALID);
-    break;
-  case STATE_VALUE:
-  case STATE_ENDSEQUENCE:
-  case STATE_STARTITEM:
-    next = level_parser_key_token(self, src);
-    assert(next == TOKEN_KEY || next == TOKEN_ENDITEM);
-    new_state = next == TOKEN_KEY
-                    ? STATE_KEY
-                    : (next == TOKEN_ENDITEM ? STATE_ENDITEM : STATE_INVALID);
-    break;
-  default:;
-  }
-  return new_state;
-}
-
 static enum state evrle_level_emitter_write_key(struct level_emitter *self,
                                                 struct dicm_dst *dst,
                                                 const enum token token) {
@@ -343,29 +146,36 @@ static struct level_parser
 evrle_level_parser_next_level(struct level_parser *level_parser,
                               const enum state current_state);
 
-static struct level_parser_vtable const evrle_ds_vtable = {
-    /* ds reader interface */
+static struct level_parser_vtable const evrle_vtable = {
+    /* ds and item reader interface */
     .reader = {.fp_key_token = evrle_level_parser_read_key,
                .fp_value_token = evrle_level_parser_read_value,
                .fp_next_level = evrle_level_parser_next_level,
-               .fp_next_event = evrle_ds_reader_next_event}};
-static struct level_parser_vtable const evrle_item_vtable = {
-    /* item reader interface */
-    .reader = {.fp_key_token = evrle_level_parser_read_key,
+               .fp_next_event = evrle_level_parser_next_event}};
+static struct level_parser_vtable const evrle_meta_vtable = {
+    /* meta reader interface */
+    .reader = {.fp_key_token = evrle_meta_parser_read_key,
                .fp_value_token = evrle_level_parser_read_value,
                .fp_next_level = evrle_level_parser_next_level,
-               .fp_next_event = evrle_level_parser_next_event}};
+               .fp_next_event = evrle_meta_parser_next_event}};
 
 struct level_parser
 evrle_level_parser_next_level(struct level_parser *level_parser,
                               const enum state current_state) {
   assert(STATE_STARTSEQUENCE == current_state);
-  struct level_parser new_item = {.vtable = &evrle_item_vtable};
+  struct level_parser new_item = {.kind = LEVEL_ITEM,
+                                  .vtable = &evrle_vtable};
   return new_item;
 }
 
 struct level_parser get_new_evrle_reader_ds() {
-  struct level_parser new_item = {.vtable = &evrle_ds_vtable};
+  struct level_parser new_item = {.kind = LEVEL_ROOT, .vtable = &evrle_vtable};
+  return new_item;
+}
+
+struct level_parser get_new_evrle_reader_meta() {
+  struct level_parser new_item = {.kind = LEVEL_ROOT,
+                                  .vtable = &evrle_meta_vtable};
   return new_item;
 }
 
@@ -1,30 +1,11 @@
 #include "dicm_item.h"
 
 #include "dicm_dst.h"
+#include "dicm_reader.h"
 #include "dicm_src.h"
 
 #include <assert.h>
 
-static inline bool _tag_is_valid(const dicm_tag_t tag) {
-  // The following cases have been handled by design:
-  assert(tag != TAG_STARTITEM && tag != TAG_ENDITEM && tag != TAG_ENDSQITEM);
-  // FIXME: valid for DataSet but not CommandSet
-  return dicm_tag_get_group(tag) >= 0x0008;
-}
-
-static inline bool vl_is_valid(const dicm_vl_t vl) {
-  return dicm_vl_is_undefined(vl) || vl % 2 == 0;
-}
-
-static inline bool _attribute_is_valid(const struct key_info *da) {
-  // 1. check triplet separately:
-  const bool valid = _tag_is_valid(da->tag) && vl_is_valid(da->vl);
-  if (!valid) {
-    return false;
-  }
-  return true;
-}
-
 #define level_parser_key_token(t, src)                                         \
   ((t)->vtable->reader.fp_key_token((t), (src)))
 #define level_parser_value_token(t, src)                                       \
@@ -35,151 +16,12 @@ static inline bool _attribute_is_valid(const struct key_info *da) {
 #define level_emitter_value_token(t, dst, tok)                                 \
   ((t)->vtable->level_emitter.fp_value_token((t), (dst), (tok)))
 
-#define SWAP_TAG(x) ((((x)&0x0000ffff) << 16u) | (((x)&0xffff0000) >> 16u))
-
-static inline uint32_t ivrle2tag(const uint32_t tag_bytes) {
-  return SWAP_TAG(tag_bytes);
-}
-
-enum IVRLE_SPECIAL_TAGS {
-  IVRLE_TAG_STARTITEM = SWAP_TAG(TAG_STARTITEM),
-  IVRLE_TAG_ENDITEM = SWAP_TAG(TAG_ENDITEM),
-  IVRLE_TAG_ENDSQITEM = SWAP_TAG(TAG_ENDSQITEM),
-};
-
 static const struct ivr ivrle_start_item = {.tag = IVRLE_TAG_STARTITEM,
                                             .vl = VL_UNDEFINED};
 static const struct ivr ivrle_end_item = {.tag = IVRLE_TAG_ENDITEM, .vl = 0};
 static const struct ivr ivrle_end_sq_item = {.tag = IVRLE_TAG_ENDSQITEM,
                                              .vl = 0};
 
-static enum token ivrle_level_parser_read_key(struct level_parser *self,
-                                              struct dicm_src *src) {
-  struct dual dual;
-  int64_t ssize = dicm_src_read(src, &dual.ivr, 8);
-  if (ssize != 8) {
-    return ssize == 0 ? TOKEN_EOF : TOKEN_INVALID_DATA;
-  }
-
-  const uint32_t tag = ivrle2tag(dual.ivr.tag);
-  self->da.tag = tag;
-  {
-    const uint32_t ide_vl = dual.ivr.vl;
-    self->da.vl = ide_vl;
-    self->da.vr = VR_NONE;
-    switch (tag) {
-    case TAG_STARTITEM:
-      /* FIXME: no bswap needed at this point */
-      assert(dual.ivr.tag == IVRLE_TAG_STARTITEM);
-      self->da.vr = VR_NONE;
-      self->da.vl = ide_vl;
-      return vl_is_valid(ide_vl) ? TOKEN_STARTITEM : TOKEN_INVALID_DATA;
-    case TAG_ENDITEM:
-      assert(dual.ivr.tag == IVRLE_TAG_ENDITEM);
-      self->da.vr = VR_NONE;
-      self->da.vl = ide_vl;
-      return ide_vl == 0 ? TOKEN_ENDITEM : TOKEN_INVALID_DATA;
-    case TAG_ENDSQITEM:
-      assert(dual.ivr.tag == IVRLE_TAG_ENDSQITEM);
-      self->da.vr = VR_NONE;
-      self->da.vl = ide_vl;
-      return ide_vl == 0 ? TOKEN_ENDSQITEM : TOKEN_INVALID_DATA;
-    }
-  }
-
-  if (!_attribute_is_valid(&self->da)) {
-    assert(0);
-    return TOKEN_INVALID_DATA;
-  }
-
-  return TOKEN_KEY;
-}
-
-static enum token ivrle_level_parser_read_value(struct level_parser *self,
-                                                struct dicm_src *src) {
-  assert(src);
-  const dicm_vr_t vr = self->da.vr;
-  if (dicm_vl_is_undefined(self->da.vl)) {
-    assert(vr == VR_NONE);
-    return TOKEN_STARTSEQUENCE;
-  } else {
-    assert(!dicm_vl_is_undefined(self->da.vl));
-    return TOKEN_VALUE;
-  }
-}
-
-static enum state ivrle_ds_reader_next_event(struct level_parser *self,
-                                             const enum state current_state,
-                                             struct dicm_src *src) {
-  enum token next;
-  enum state new_state = STATE_INVALID;
-  switch (current_state) {
-  case STATE_STARTDOCUMENT: /* enter state */
-    next = level_parser_key_token(self, src);
-    /* empty document is an error */
-    new_state = next == TOKEN_KEY ? STATE_KEY : STATE_INVALID;
-    break;
-  case STATE_KEY:
-    next = level_parser_value_token(self, src);
-    assert(next == TOKEN_VALUE || next == TOKEN_STARTSEQUENCE);
-    new_state = next == TOKEN_VALUE
-                    ? STATE_VALUE
-                    : (next == TOKEN_STARTSEQUENCE ? STATE_STARTSEQUENCE
-                                                   : STATE_INVALID);
-    break;
-  case STATE_VALUE:
-  case STATE_ENDSEQUENCE: // re-enter case
-    next = level_parser_key_token(self, src);
-    if (next == TOKEN_EOF) {
-      new_state = STATE_ENDDOCUMENT;
-    } else {
-      assert(next == TOKEN_KEY);
-      new_state = next == TOKEN_KEY ? STATE_KEY : STATE_INVALID;
-    }
-    break;
-  default:
-    assert(0);
-  }
-  return new_state;
-}
-
-static enum state ivrle_level_parser_next_event(struct level_parser *self,
-                                                const enum state current_state,
-                                                struct dicm_src *src) {
-  enum token next;
-  enum state new_state = STATE_INVALID;
-  switch (current_state) {
-  case STATE_STARTSEQUENCE: /* enter state */
-  case STATE_ENDITEM:
-    next = level_parser_key_token(self, src);
-    assert(next == TOKEN_STARTITEM || next == TOKEN_ENDSQITEM);
-    new_state =
-        next == TOKEN_STARTITEM
-            ? STATE_STARTITEM
-            : (next == TOKEN_ENDSQITEM ? STATE_ENDSEQUENCE : STATE_INVALID);
-    break;
-  case STATE_KEY:
-    next = level_parser_value_token(self, src);
-    assert(next == TOKEN_VALUE || next == TOKEN_STARTSEQUENCE);
-    new_state = next == TOKEN_VALUE
-                    ? STATE_VALUE
-                    : (next == TOKEN_STARTSEQUENCE ? STATE_STARTSEQUENCE
-                                                   : STATE_INVALID);
-    break;
-  case STATE_VALUE:
-  case STATE_ENDSEQUENCE:
-  case STATE_STARTITEM:
-    next = level_parser_key_token(self, src);
-    assert(next == TOKEN_KEY || next == TOKEN_ENDITEM);
-    new_state = next == TOKEN_KEY
-                    ? STATE_KEY
-                    : (next == TOKEN_ENDITEM ? STATE_ENDITEM : STATE_INVALID);
-    break;
-  default:;
-  }
-  return new_state;
-}
-
 static enum state ivrle_level_emitter_write_key(struct level_emitter *self,
                                                 struct dicm_dst *dst,
                                                 const enum token token) {
@@ -305,14 +147,8 @@ static struct level_parser
 ivrle_level_parser_next_level(struct level_parser *level_parser,
                               const enum state current_state);
 
-static struct level_parser_vtable const ivrle_ds_vtable = {
-    /* ds reader interface */
-    .reader = {.fp_key_token = ivrle_level_parser_read_key,
-               .fp_value_token = ivrle_level_parser_read_value,
-               .fp_next_level = ivrle_level_parser_next_level,
-               .fp_next_event = ivrle_ds_reader_next_event}};
-static struct level_parser_vtable const ivrle_item_vtable = {
-    /* item reader interface */
+static struct level_parser_vtable const ivrle_vtable = {
+    /* ds and item reader interface */
     .reader = {.fp_key_token = ivrle_level_parser_read_key,
                .fp_value_token = ivrle_level_parser_read_value,
                .fp_next_level = ivrle_level_parser_next_level,
@@ -322,12 +158,13 @@ struct level_parser
 ivrle_level_parser_next_level(struct level_parser *level_parser,
                               const enum state current_state) {
   assert(STATE_STARTSEQUENCE == current_state);
-  struct level_parser new_item = {.vtable = &ivrle_item_vtable};
+  struct level_parser new_item = {.kind = LEVEL_ITEM,
+                                  .vtable = &ivrle_vtable};
   return new_item;
 }
 
 struct level_parser get_new_ivrle_reader_ds() {
-  struct level_parser new_item = {.vtable = &ivrle_ds_vtable};
+  struct level_parser new_item = {.kind = LEVEL_ROOT, .vtable = &ivrle_vtable};
   return new_item;
 }
 
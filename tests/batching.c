@@ -0,0 +1,217 @@
+#include "common.h"
+
+#include <stdio.h>  /* FILE* */
+#include <stdlib.h> /* EXIT_SUCCESS */
+#include <string.h> /* memcmp */
+
+/* compact trace of a parse */
+struct record {
+  int event;
+  uint32_t tag;
+  int depth;
+};
+
+enum { MAX_RECORDS = 4096, BATCH_SIZE = 5, INLINE_MAX = 16 };
+
+/* reference trace, one event at a time */
+static int collect(struct dicm_src *src, int structure,
+                   struct record *records) {
+  struct dicm_parser *parser;
+  struct dicm_key key;
+  int n = 0;
+  int depth = 0;
+  int done = 0;
+  if (dicm_parser_create(&parser) < 0) {
+    return -1;
+  }
+  if (dicm_parser_set_input(parser, structure, src) < 0) {
+    goto error;
+  }
+  while (!done && n < MAX_RECORDS) {
+    const int next = dicm_parser_next_event(parser);
+    if (next < 0) {
+      goto error;
+    }
+    struct record *record = &records[n++];
+    record->event = next;
+    record->tag = 0;
+    if (next == DICM_SEQUENCE_END_EVENT) {
+      --depth;
+    }
+    record->depth = depth;
+    switch (next) {
+    case DICM_KEY_EVENT:
+      if (dicm_parser_get_key(parser, &key) < 0) {
+        goto error;
+      }
+      record->tag = key.tag;
+      break;
+    case DICM_VALUE_EVENT:
+      if (dicm_parser_skip_value(parser) < 0) {
+        goto error;
+      }
+      break;
+    case DICM_SEQUENCE_START_EVENT:
+      ++depth;
+      break;
+    default:;
+    }
+    done = next == DICM_DOCUMENT_END_EVENT;
+  }
+  dicm_delete(parser);
+  return n;
+
+error:
+  dicm_delete(parser);
+  return -1;
+}
+
+/* check one event against the reference and the input bytes */
+static int check_event(const struct dicm_event *event,
+                       const struct record *record, const struct dicm_event *key,
+                       const unsigned char *buf, size_t size) {
+  if (event->type != record->event || event->depth != (uint32_t)record->depth) {
+    return -1;
+  }
+  switch (event->type) {
+  case DICM_KEY_EVENT:
+    return event->tag == record->tag ? 0 : -1;
+  case DICM_VALUE_EVENT:
+    if (event->offset + event->vl > size) {
+      return -1;
+    }
+    if (key && (key->tag != event->tag || key->offset != event->offset)) {
+      return -1;
+    }
+    if (event->vl <= INLINE_MAX) {
+      return event->value &&
+                     memcmp(event->value, buf + event->offset, event->vl) == 0
+                 ? 0
+                 : -1;
+    }
+    return event->value == NULL ? 0 : -1;
+  default:;
+  }
+  return 0;
+}
+
+/* compare batches of events with the reference trace */
+static int check(struct dicm_src *src, int structure, const unsigned char *buf,
+                 size_t size, const struct record *ref, int nref) {
+  struct dicm_parser *parser;
+  struct dicm_event events[BATCH_SIZE];
+  struct dicm_event key = {0};
+  int i = 0;
+  int ret = -1;
+  if (dicm_parser_create(&parser) < 0) {
+    return -1;
+  }
+  if (dicm_parser_set_input(parser, structure, src) < 0) {
+    goto end;
+  }
+  for (;;) {
+    const int n = dicm_parser_next_events(parser, events, BATCH_SIZE,
+                                          INLINE_MAX);
+    if (n < 0) {
+      goto end;
+    }
+    if (n == 0) {
+      break;
+    }
+    for (int j = 0; j < n; ++j, ++i) {
+      const struct dicm_event *event = &events[j];
+      /* fragments have no key */
+      const int has_key = i > 0 && ref[i - 1].event == DICM_KEY_EVENT;
+      if (i == nref ||
+          check_event(event, &ref[i], has_key ? &key : NULL, buf, size) < 0) {
+        goto end;
+      }
+      if (event->type == DICM_KEY_EVENT) {
+        key = *event;
+      }
+    }
+  }
+  ret = i == nref ? 0 : -1;
+
+end:
+  dicm_delete(parser);
+  return ret;
+}
+
+int batching(int argc, char *argv[]) {
+  if (argc < 3)
+    return EXIT_FAILURE;
+  static struct record ref[MAX_RECORDS];
+  const int structure = get_structure(argv[1]);
+  const char *infilename = argv[2];
+  FILE *in = fopen(infilename, "rb");
+  if (!in || structure < 0) {
+    return EXIT_FAILURE;
+  }
+  int ret = EXIT_FAILURE;
+  unsigned char *buf = NULL;
+  struct dicm_src *src = NULL;
+  fseek(in, 0, SEEK_END);
+  const long size = ftell(in);
+  rewind(in);
+  buf = malloc(size + 1);
+  if (!buf || fread(buf, 1, size, in) != (size_t)size) {
+    goto end;
+  }
+
+  if (dicm_src_mem_create(&src, buf, size) < 0) {
+    goto end;
+  }
+  const int nref = collect(src, structure, ref);
+  dicm_delete(src);
+  if (nref < 1) {
+    goto end;
+  }
+
+  /* values borrowed from a contiguous source */
+  if (dicm_src_mem_create(&src, buf, size) < 0) {
+    goto end;
+  }
+  if (check(src, structure, buf, size, ref, nref) < 0) {
+    fprintf(stderr, "batching: mem mismatch\n");
+    dicm_delete(src);
+    goto end;
+  }
+  dicm_delete(src);
+
+  /* values copied out of a small read-ahead window, refilled within a
+   * batch */
+  struct dicm_src *base;
+  if (dicm_src_mem_create(&base, buf, size) < 0) {
+    goto end;
+  }
+  if (dicm_src_buffered_create(&src, base, 64) < 0) {
+    dicm_delete(base);
+    goto end;
+  }
+  const int mismatch = check(src, structure, buf, size, ref, nref) < 0;
+  dicm_delete(src);
+  dicm_delete(base);
+  if (mismatch) {
+    fprintf(stderr, "batching: buffered mismatch\n");
+    goto end;
+  }
+
+  /* values copied from a stream */
+  struct memstream memstream = {buf, (size_t)size, 0};
+  if (dicm_src_stream_create(&src, &memstream, memstream_read, NULL) < 0) {
+    goto end;
+  }
+  if (check(src, structure, buf, size, ref, nref) < 0) {
+    fprintf(stderr, "batching: stream mismatch\n");
+    dicm_delete(src);
+    goto end;
+  }
+  dicm_delete(src);
+  ret = EXIT_SUCCESS;
+
+end:
+  free(buf);
+  fclose(in);
+  return ret;
+}
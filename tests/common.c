@@ -0,0 +1,26 @@
+#include "common.h"
+
+#include <string.h> /* strcmp, memcpy */
+
+int get_structure(const char *structure) {
+  if (strcmp("evrle_encapsulated", structure) == 0) {
+    return DICM_STRUCTURE_ENCAPSULATED;
+  } else if (strcmp("ivrle_raw", structure) == 0) {
+    return DICM_STRUCTURE_IMPLICIT;
+  } else if (strcmp("evrle_raw", structure) == 0) {
+    return DICM_STRUCTURE_EXPLICIT_LE;
+  } else if (strcmp("evrbe_raw", structure) == 0) {
+    return DICM_STRUCTURE_EXPLICIT_BE;
+  }
+  return -1;
+}
+
+int64_t memstream_read(struct dicm_src *const src, void *buf, size_t size) {
+  struct dicm_src_user *self = (struct dicm_src_user *)src;
+  struct memstream *stream = self->data;
+  const size_t avail = stream->size - stream->pos;
+  const size_t len = size < avail ? size : avail;
+  memcpy(buf, stream->ptr + stream->pos, len);
+  stream->pos += len;
+  return (int64_t)len;
+}
@@ -0,0 +1,22 @@
+#ifndef DICM_TEST_COMMON_H
+#define DICM_TEST_COMMON_H
+
+#include "dicm.h"
+
+#include <stddef.h> /* size_t */
+
+/* map a test structure name (eg. "evrle_raw") to a DICM_STRUCTURE_* value,
+ * -1 when unknown */
+int get_structure(const char *structure);
+
+/* in memory stream, to be used as the data of dicm_src_stream_create */
+struct memstream {
+  const unsigned char *ptr;
+  size_t size;
+  size_t pos;
+};
+
+/* dicm_src_stream_create read callback for a struct memstream */
+int64_t memstream_read(struct dicm_src *src, void *buf, size_t size);
+
+#endif /* DICM_TEST_COMMON_H */
@@ -0,0 +1,66 @@
+#include "dicm.h"
+
+#include <stdio.h>  /* fprintf */
+#include <stdlib.h> /* EXIT_SUCCESS */
+#include <string.h> /* strcmp */
+
+struct expected {
+  uint32_t tag;
+  const char *vr;
+  const char *vm;
+  const char *keyword;
+};
+
+static const struct expected expected[] = {
+    {0x00020010, "UI", "1", "TransferSyntaxUID"},
+    {0x00080005, "CS", "1-n", "SpecificCharacterSet"},
+    {0x00081140, "SQ", "1", "ReferencedImageSequence"},
+    {0x00100010, "PN", "1", "PatientName"},
+    {0x00200037, "DS", "6", "ImageOrientationPatient"},
+    {0x7fe00010, "OW", "1", "PixelData"},
+    {0xfffcfffc, "OB", "1", "DataSetTrailingPadding"},
+    /* command, directory, retired and multiple VR attributes */
+    {0x00000100, "US", "1", "CommandField"},
+    {0x00041220, "SQ", "1", "DirectoryRecordSequence"},
+    {0x00181030, "LO", "1", "ProtocolName"},
+    {0x00280106, "US", "1", "SmallestImagePixelValue"},
+    {0x00283006, "OW", "1-n", "LUTData"},
+    {0x00404001, "CS", "1", "GeneralPurposeScheduledProcedureStepStatus"},
+    {0x0066002f, "SQ", "1", "AlgorithmFamilyCodeSequence"},
+    {0x00720030, "SQ", "1", "TimeBasedImageSetsSequence"}};
+
+static int check(const struct expected *exp,
+                 const struct dicm_dict_entry *entry) {
+  return entry->tag == exp->tag &&
+                 strcmp((const char *)&entry->vr, exp->vr) == 0 &&
+                 strcmp(entry->vm, exp->vm) == 0 &&
+                 strcmp(entry->keyword, exp->keyword) == 0
+             ? 0
+             : -1;
+}
+
+int dictionary(int argc, char *argv[]) {
+  struct dicm_dict_entry entry;
+  for (size_t i = 0; i < sizeof expected / sizeof *expected; ++i) {
+    const struct expected *exp = &expected[i];
+    if (dicm_dict_find_tag(exp->tag, &entry) < 0 || check(exp, &entry) < 0) {
+      fprintf(stderr, "dictionary: tag %08x mismatch\n", exp->tag);
+      return EXIT_FAILURE;
+    }
+    if (dicm_dict_find_keyword(exp->keyword, &entry) < 0 ||
+        check(exp, &entry) < 0) {
+      fprintf(stderr, "dictionary: keyword %s mismatch\n", exp->keyword);
+      return EXIT_FAILURE;
+    }
+  }
+  /* private, group length, unknown and attributes without a keyword */
+  if (dicm_dict_find_tag(0x00090010, &entry) == 0 ||
+      dicm_dict_find_tag(0x00080000, &entry) == 0 ||
+      dicm_dict_find_tag(0x00080202, &entry) == 0 ||
+      dicm_dict_find_keyword("PatientNam", &entry) == 0 ||
+      dicm_dict_find_keyword("", &entry) == 0) {
+    fprintf(stderr, "dictionary: unexpected entry\n");
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
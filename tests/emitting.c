@@ -1,3 +1,5 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "dicm.h"
 
 #include <assert.h> /* assert() */
@@ -29,7 +31,7 @@ int emitting(int argc, char *argv[]) {
   if (argc < 4)
     return EXIT_FAILURE;
   struct dicm_emitter *emitter;
-  struct dicm_dst *dst;
+  struct dicm_dst *dst, *base = NULL;
   struct dicm_key key;
   /* value */
   char buf[4096];
@@ -38,12 +40,34 @@ int emitting(int argc, char *argv[]) {
   const char *structure = argv[1];
   const char *infilename = argv[2];
   const char *outfilename = argv[3];
+  const char *destination = argc > 4 ? argv[4] : "file";
   FILE *in = fopen(infilename, "r");
   FILE *out = fopen(outfilename, "wb");
 
   dicm_configure_log_msg(my_log);
 
-  dicm_dst_file_create(&dst, out);
+  if (strcmp("file", destination) == 0) {
+    res = dicm_dst_file_create(&dst, out);
+  } else if (strcmp("buffered", destination) == 0) {
+    /* use a tiny buffer to stress buffer boundaries */
+    res = dicm_dst_file_create(&base, out);
+    if (res == 0) {
+      res = dicm_dst_buffered_create(&dst, base, 12);
+    }
+  } else if (strcmp("fd", destination) == 0) {
+    res = dicm_dst_fd_create(&dst, fileno(out), 0);
+  } else if (strcmp("uring", destination) == 0) {
+    /* use tiny blocks to stress block boundaries */
+    res = dicm_dst_uring_create(&dst, fileno(out), 0, 4, 12);
+  } else {
+    fprintf(stderr, "Invalid destination: %s\n", destination);
+    exit(1);
+  }
+  if (res < 0) {
+    fprintf(stderr, "emitting: failed to initialize "
+                    "destination\n");
+    exit(1);
+  }
 
   if (dicm_emitter_create(&emitter) < 0) {
     fprintf(stderr, "dummy: failed to initialize "
@@ -107,7 +131,13 @@ int emitting(int argc, char *argv[]) {
   }
 
   dicm_delete(emitter);
-  dicm_delete(dst);
+  /* buffered: pending bytes are written here */
+  if (dicm_delete(dst) < 0) {
+    ret = EXIT_FAILURE;
+  }
+  if (base) {
+    dicm_delete(base);
+  }
   fclose(in);
   fclose(out);
   return ret;
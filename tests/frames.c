@@ -0,0 +1,191 @@
+#include "common.h"
+
+#include <stdio.h>  /* fprintf */
+#include <stdlib.h> /* EXIT_SUCCESS */
+#include <string.h> /* memcmp */
+
+enum { BUFFER_SIZE = 512, NUM_FRAMES = 3 };
+
+/* hand written encapsulated Pixel Data: frame 1 is made of two fragments,
+ * frames start with a JPEG or JPEG 2000 marker */
+#define FRAME0 "\xff\xd8\xff\xe0"
+#define FRAME1 "\xff\x4f\xff\x51"
+#define FRAME2 "\xff\xd8\xff\xdb"
+static const char *const fragments[] = {FRAME0, FRAME1, "F1bb", FRAME2};
+static const uint32_t frame_offsets[NUM_FRAMES] = {0, 12, 36};
+
+enum offset_table { BASIC_TABLE, EXTENDED_TABLE, NO_TABLE };
+
+struct writer {
+  unsigned char buf[BUFFER_SIZE];
+  size_t n;
+};
+
+static void put16(struct writer *w, uint32_t v) {
+  w->buf[w->n++] = v & 0xff;
+  w->buf[w->n++] = (v >> 8) & 0xff;
+}
+
+static void put32(struct writer *w, uint32_t v) {
+  put16(w, v & 0xffff);
+  put16(w, v >> 16);
+}
+
+static void put_tag(struct writer *w, uint32_t tag) {
+  put16(w, tag >> 16);
+  put16(w, tag & 0xffff);
+}
+
+static void put_long_key(struct writer *w, uint32_t tag, const char *vr,
+                         uint32_t vl) {
+  put_tag(w, tag);
+  memcpy(w->buf + w->n, vr, 2);
+  w->n += 2;
+  put16(w, 0);
+  put32(w, vl);
+}
+
+static void build(struct writer *w, enum offset_table table) {
+  const int with_bot = table == BASIC_TABLE;
+  w->n = 0;
+  /* (0028,0008) Number of Frames */
+  put_tag(w, 0x00280008);
+  memcpy(w->buf + w->n, "IS\2\0" "3 ", 6);
+  w->n += 6;
+  if (table == EXTENDED_TABLE) {
+    put_long_key(w, 0x7fe00001, "OV", NUM_FRAMES * 8);
+    for (int i = 0; i < NUM_FRAMES; ++i) {
+      put32(w, frame_offsets[i]);
+      put32(w, 0);
+    }
+  }
+  put_long_key(w, 0x7fe00010, "OB", 0xffffffff);
+  put_tag(w, 0xfffee000);
+  put32(w, with_bot ? NUM_FRAMES * 4 : 0);
+  for (int i = 0; with_bot && i < NUM_FRAMES; ++i) {
+    put32(w, frame_offsets[i]);
+  }
+  for (size_t i = 0; i < sizeof fragments / sizeof *fragments; ++i) {
+    put_tag(w, 0xfffee000);
+    put32(w, 4);
+    memcpy(w->buf + w->n, fragments[i], 4);
+    w->n += 4;
+  }
+  put_tag(w, 0xfffee0dd);
+  put32(w, 0);
+}
+
+/* move to the Pixel Data fragments */
+static int start_fragments(struct dicm_parser *parser) {
+  struct dicm_key key;
+  for (;;) {
+    const int next = dicm_parser_next_event(parser);
+    switch (next) {
+    case DICM_KEY_EVENT:
+      if (dicm_parser_get_key(parser, &key) < 0) {
+        return -1;
+      }
+      break;
+    case DICM_VALUE_EVENT:
+      if (dicm_parser_skip_value(parser) < 0) {
+        return -1;
+      }
+      break;
+    case DICM_SEQUENCE_START_EVENT:
+      return key.tag == 0x7fe00010 ? 0 : -1;
+    case DICM_DOCUMENT_START_EVENT:
+      break;
+    default:
+      return -1;
+    }
+  }
+}
+
+/* read the next fragment and compare it */
+static int read_fragment(struct dicm_parser *parser, const char *expected) {
+  char buf[4];
+  uint32_t size;
+  if (dicm_parser_next_event(parser) != DICM_FRAGMENT_EVENT ||
+      dicm_parser_next_event(parser) != DICM_VALUE_EVENT ||
+      dicm_parser_get_size(parser, &size) < 0 || size != 4 ||
+      dicm_parser_read_bytes(parser, buf, size) < 0) {
+    return -1;
+  }
+  return memcmp(buf, expected, 4) == 0 ? 0 : -1;
+}
+
+/* random frame access, backward seeks need a seekable source */
+static int check(const struct writer *w, int stream) {
+  uint64_t offsets[NUM_FRAMES];
+  struct memstream memstream = {w->buf, w->n, 0};
+  struct dicm_parser *parser;
+  struct dicm_src *src;
+  uint32_t count;
+  int ret = -1;
+  const int res =
+      stream ? dicm_src_stream_create(&src, &memstream, memstream_read, NULL)
+             : dicm_src_mem_create(&src, w->buf, w->n);
+  if (res < 0) {
+    return -1;
+  }
+  if (dicm_parser_create(&parser) < 0) {
+    dicm_delete(src);
+    return -1;
+  }
+  if (dicm_parser_set_input(parser, DICM_STRUCTURE_ENCAPSULATED, src) < 0 ||
+      start_fragments(parser) < 0 ||
+      dicm_parser_get_frame_count(parser, &count) < 0 ||
+      count != NUM_FRAMES ||
+      dicm_parser_get_frame_offsets(parser, offsets, count) < 0) {
+    goto end;
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    if (offsets[i] != frame_offsets[i]) {
+      goto end;
+    }
+  }
+  if (dicm_parser_seek_frame(parser, 1) < 0 ||
+      read_fragment(parser, FRAME1) < 0) {
+    goto end;
+  }
+  if (!stream && (dicm_parser_seek_frame(parser, 0) < 0 ||
+                  read_fragment(parser, FRAME0) < 0)) {
+    goto end;
+  }
+  if (dicm_parser_seek_frame(parser, NUM_FRAMES) == 0 ||
+      dicm_parser_seek_frame(parser, 2) < 0 ||
+      read_fragment(parser, FRAME2) < 0 ||
+      dicm_parser_next_event(parser) != DICM_SEQUENCE_END_EVENT ||
+      dicm_parser_next_event(parser) != DICM_DOCUMENT_END_EVENT) {
+    goto end;
+  }
+  ret = 0;
+
+end:
+  dicm_delete(parser);
+  dicm_delete(src);
+  return ret;
+}
+
+int frames(int argc, char *argv[]) {
+  static struct writer w;
+  (void)argc;
+  (void)argv;
+  build(&w, BASIC_TABLE);
+  if (check(&w, 0) < 0 || check(&w, 1) < 0) {
+    fprintf(stderr, "frames: basic offset table\n");
+    return EXIT_FAILURE;
+  }
+  /* the fallbacks read back or ahead, only on a seekable source */
+  build(&w, EXTENDED_TABLE);
+  if (check(&w, 0) < 0 || check(&w, 1) == 0) {
+    fprintf(stderr, "frames: extended offset table\n");
+    return EXIT_FAILURE;
+  }
+  build(&w, NO_TABLE);
+  if (check(&w, 0) < 0 || check(&w, 1) == 0) {
+    fprintf(stderr, "frames: recovered frames\n");
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
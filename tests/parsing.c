@@ -1,9 +1,11 @@
+#define _POSIX_C_SOURCE 200112L
+
 #include "dicm.h"
 
 #include <assert.h> /* assert() */
 #include <stdio.h>  /* FILE* */
 #include <stdlib.h> /* EXIT_SUCCESS */
-#include <string.h> /* strcmp */
+#include <string.h> /* strcmp, memcpy */
 
 static const char *events[] = {
     "document-start", "document-end",   "key",
@@ -43,9 +45,18 @@ static void my_log(int log_level, const char *msg) {
   }
 }
 
+static int64_t my_read(struct dicm_src *const src, void *buf, size_t size) {
+  struct dicm_src_user *self = (struct dicm_src_user *)src;
+  FILE *stream = self->data;
+  const size_t read = fread(buf, 1, size, stream);
+  return (int64_t)read;
+}
+
 int parsing(int argc, char *argv[]) {
   struct dicm_parser *parser;
   struct dicm_src *src;
+  /* underlying source of a layered source */
+  struct dicm_src *base = NULL;
   struct dicm_key key;
   int done = 0;
   /* value */
@@ -56,11 +67,40 @@ int parsing(int argc, char *argv[]) {
   const char *structure = argv[1];
   const char *infilename = argv[2];
   const char *outfilename = argv[3];
+  const char *source = argc > 4 ? argv[4] : "file";
+  /* read values using dicm_parser_read_bytes or dicm_parser_borrow_bytes */
+  int borrow = 1;
   FILE *in = fopen(infilename, "rb");
 
   dicm_configure_log_msg(my_log);
 
-  dicm_src_file_create(&src, in);
+  if (strcmp("file", source) == 0) {
+    res = dicm_src_file_create(&src, in);
+    borrow = 0;
+  } else if (strcmp("stream", source) == 0) {
+    res = dicm_src_stream_create(&src, in, my_read, NULL);
+  } else if (strcmp("buffered", source) == 0) {
+    /* use a tiny window to stress window boundaries */
+    res = dicm_src_file_create(&base, in);
+    if (res == 0) {
+      res = dicm_src_buffered_create(&src, base, 12);
+    }
+  } else if (strcmp("fd", source) == 0) {
+    res = dicm_src_fd_create(&src, fileno(in), 0, DICM_ADVICE_SEQUENTIAL);
+  } else if (strcmp("uring", source) == 0) {
+    /* use tiny blocks to stress block boundaries */
+    res = dicm_src_uring_create(&src, fileno(in), 0, 4, 12);
+  } else if (strcmp("mmap", source) == 0) {
+    res = dicm_src_mmap_create(&src, fileno(in), DICM_ADVICE_SEQUENTIAL);
+  } else {
+    fprintf(stderr, "Invalid source: %s\n", source);
+    exit(1);
+  }
+  if (res < 0) {
+    fprintf(stderr, "parsing: failed to initialize "
+                    "source\n");
+    exit(1);
+  }
   FILE *out = fopen(outfilename, "w");
 
   if (dicm_parser_create(&parser) < 0) {
@@ -115,7 +155,15 @@ int parsing(int argc, char *argv[]) {
        * value_length is exactly 0) */
       do {
         const size_t len = size < buflen ? size : buflen;
-        res = dicm_parser_read_bytes(parser, buf, len);
+        if (borrow) {
+          const void *ptr;
+          res = dicm_parser_borrow_bytes(parser, &ptr, len);
+          if (res == 0 && len != 0) {
+            memcpy(buf, ptr, len);
+          }
+        } else {
+          res = dicm_parser_read_bytes(parser, buf, len);
+        }
         if (res != 0) {
           goto error;
         }
@@ -144,6 +192,8 @@ int parsing(int argc, char *argv[]) {
   /* Destroy the Parser object. */
   dicm_delete(parser);
   dicm_delete(src);
+  if (base)
+    dicm_delete(base);
   fclose(in);
   fclose(out);
   if (log_count.error != 0) {
@@ -154,6 +204,8 @@ int parsing(int argc, char *argv[]) {
 error:
   dicm_delete(parser);
   dicm_delete(src);
+  if (base)
+    dicm_delete(base);
   fclose(in);
   fclose(out);
   return EXIT_FAILURE;
@@ -0,0 +1,349 @@
+#include "dicm.h"
+
+#include <stdio.h>  /* FILE* */
+#include <stdlib.h> /* EXIT_SUCCESS */
+#include <string.h> /* strcmp, memcpy */
+
+/* compact trace of a parse */
+struct record {
+  int event;
+  uint32_t tag;
+};
+
+enum { MAX_RECORDS = 4096, PREAMBLE_SIZE = 128 };
+
+static const char *get_transfer_syntax(const char *structure, int *type) {
+  if (strcmp("evrle_encapsulated", structure) == 0) {
+    *type = DICM_STRUCTURE_ENCAPSULATED;
+    return "1.2.840.10008.1.2.4.50"; /* JPEG Baseline */
+  } else if (strcmp("ivrle_raw", structure) == 0) {
+    *type = DICM_STRUCTURE_IMPLICIT;
+    return "1.2.840.10008.1.2";
+  } else if (strcmp("evrle_raw", structure) == 0) {
+    *type = DICM_STRUCTURE_EXPLICIT_LE;
+    return "1.2.840.10008.1.2.1";
+  } else if (strcmp("evrbe_raw", structure) == 0) {
+    *type = DICM_STRUCTURE_EXPLICIT_BE;
+    return "1.2.840.10008.1.2.2";
+  }
+  return NULL;
+}
+
+static size_t put_le16(unsigned char *p, uint32_t v) {
+  p[0] = v & 0xff;
+  p[1] = (v >> 8) & 0xff;
+  return 2;
+}
+
+static size_t put_le32(unsigned char *p, uint32_t v) {
+  put_le16(p, v & 0xffff);
+  put_le16(p + 2, v >> 16);
+  return 4;
+}
+
+static size_t put_key(unsigned char *p, uint32_t tag, const char *vr) {
+  put_le16(p, tag >> 16);
+  put_le16(p + 2, tag & 0xffff);
+  memcpy(p + 4, vr, 2);
+  return 6;
+}
+
+/* preamble, prefix and a minimal File Meta Information. Return its size */
+static size_t build_header(unsigned char *p, const char *ts) {
+  const size_t ts_len = strlen(ts);
+  const size_t ts_vl = ts_len + ts_len % 2;
+  unsigned char *meta;
+  size_t n = 0;
+  memset(p, 0, PREAMBLE_SIZE);
+  n += PREAMBLE_SIZE;
+  memcpy(p + n, "DICM", 4);
+  n += 4;
+  n += put_key(p + n, 0x00020000, "UL");
+  n += put_le16(p + n, 4);
+  meta = p + n;
+  n += 4;
+  /* (0002,0001) OB 00\01 */
+  n += put_key(p + n, 0x00020001, "OB");
+  n += put_le16(p + n, 0);
+  n += put_le32(p + n, 2);
+  p[n++] = 0;
+  p[n++] = 1;
+  /* (0002,0010) UI, padded with NUL */
+  n += put_key(p + n, 0x00020010, "UI");
+  n += put_le16(p + n, (uint32_t)ts_vl);
+  memcpy(p + n, ts, ts_len);
+  p[n + ts_len] = 0;
+  n += ts_vl;
+  put_le32(meta, (uint32_t)(p + n - meta - 4));
+  return n;
+}
+
+/* parse the whole document, return the number of records or -1 on error */
+static int collect(struct dicm_src *src, int structure, struct record *records,
+                   char *ts, struct dicm_index *index) {
+  struct dicm_parser *parser;
+  struct dicm_key key = {0};
+  const void *ptr;
+  uint32_t size;
+  int n = 0;
+  int done = 0;
+  if (dicm_parser_create(&parser) < 0) {
+    return -1;
+  }
+  if (dicm_parser_set_input(parser, structure, src) < 0) {
+    goto error;
+  }
+  if (index && dicm_parser_set_index(parser, index) < 0) {
+    goto error;
+  }
+  while (!done && n < MAX_RECORDS) {
+    const int next = dicm_parser_next_event(parser);
+    if (next < 0) {
+      goto error;
+    }
+    struct record *record = &records[n++];
+    record->event = next;
+    record->tag = 0;
+    switch (next) {
+    case DICM_KEY_EVENT:
+      if (dicm_parser_get_key(parser, &key) < 0) {
+        goto error;
+      }
+      record->tag = key.tag;
+      break;
+    case DICM_VALUE_EVENT:
+      if (dicm_parser_get_size(parser, &size) < 0 ||
+          dicm_parser_borrow_bytes(parser, &ptr, size) < 0) {
+        goto error;
+      }
+      if (ts && key.tag == 0x00020010) {
+        memcpy(ts, ptr, size);
+        ts[size] = 0;
+      }
+      break;
+    default:;
+    }
+    done = next == DICM_DOCUMENT_END_EVENT;
+  }
+  dicm_delete(parser);
+  return n;
+
+error:
+  dicm_delete(parser);
+  return -1;
+}
+
+/* parse a File Meta Information followed by a one element, explicit little
+ * endian, data set */
+static int check_header(const char *ts, struct record *records) {
+  unsigned char buf[PREAMBLE_SIZE + 256];
+  struct dicm_src *src;
+  size_t n = build_header(buf, ts);
+  /* (0008,0016) UI */
+  n += put_key(buf + n, 0x00080016, "UI");
+  n += put_le16(buf + n, 4);
+  memcpy(buf + n, "1.2", 4);
+  n += 4;
+  if (dicm_src_mem_create(&src, buf, n) < 0) {
+    return -1;
+  }
+  const int ret = collect(src, DICM_STRUCTURE_PART10, records, NULL, NULL);
+  dicm_delete(src);
+  return ret;
+}
+
+/* feed the next byte, then the end of the input */
+static int feed_byte(struct dicm_parser *parser, const unsigned char *ptr,
+                     size_t size, size_t *pos) {
+  if (*pos > size) {
+    return -1;
+  }
+  const size_t len = *pos < size ? 1 : 0;
+  const int ret = dicm_parser_feed(parser, len ? ptr + *pos : ptr, len);
+  ++*pos;
+  return ret;
+}
+
+/* same as collect, the file is fed one byte at a time to a push parser */
+static int collect_push(const unsigned char *ptr, size_t size,
+                        struct record *records) {
+  struct dicm_parser *parser;
+  struct dicm_key key;
+  const void *value;
+  uint32_t len;
+  size_t pos = 0;
+  int n = 0;
+  int done = 0;
+  if (dicm_parser_create(&parser) < 0) {
+    return -1;
+  }
+  if (dicm_parser_set_push_input(parser, DICM_STRUCTURE_PART10) < 0) {
+    goto error;
+  }
+  while (!done && n < MAX_RECORDS) {
+    const int next = dicm_parser_next_event(parser);
+    if (next == DICM_NEED_MORE_DATA) {
+      if (feed_byte(parser, ptr, size, &pos) < 0) {
+        goto error;
+      }
+      continue;
+    }
+    if (next < 0) {
+      goto error;
+    }
+    struct record *record = &records[n++];
+    record->event = next;
+    record->tag = 0;
+    if (next == DICM_KEY_EVENT) {
+      if (dicm_parser_get_key(parser, &key) < 0) {
+        goto error;
+      }
+      record->tag = key.tag;
+    } else if (next == DICM_VALUE_EVENT) {
+      int ret;
+      if (dicm_parser_get_size(parser, &len) < 0) {
+        goto error;
+      }
+      while ((ret = dicm_parser_borrow_bytes(parser, &value, len)) ==
+             DICM_NEED_MORE_DATA) {
+        if (feed_byte(parser, ptr, size, &pos) < 0) {
+          goto error;
+        }
+      }
+      if (ret < 0) {
+        goto error;
+      }
+    }
+    done = next == DICM_DOCUMENT_END_EVENT;
+  }
+  dicm_delete(parser);
+  return n;
+
+error:
+  dicm_delete(parser);
+  return -1;
+}
+
+int part10(int argc, char *argv[]) {
+  if (argc < 3)
+    return EXIT_FAILURE;
+  static struct record ref[MAX_RECORDS];
+  static struct record records[MAX_RECORDS];
+  static const struct record meta[] = {
+      {DICM_DOCUMENT_START_EVENT, 0}, {DICM_KEY_EVENT, 0x00020000},
+      {DICM_VALUE_EVENT, 0},          {DICM_KEY_EVENT, 0x00020001},
+      {DICM_VALUE_EVENT, 0},          {DICM_KEY_EVENT, 0x00020010},
+      {DICM_VALUE_EVENT, 0}};
+  const int nmeta = sizeof meta / sizeof *meta;
+  struct dicm_src *src;
+  int structure;
+  const char *ts = get_transfer_syntax(argv[1], &structure);
+  const char *infilename = argv[2];
+  FILE *in = fopen(infilename, "rb");
+  if (!in || !ts) {
+    return EXIT_FAILURE;
+  }
+  int ret = EXIT_FAILURE;
+  unsigned char *buf = NULL;
+  char read_ts[65];
+  struct dicm_index *index = NULL;
+  struct dicm_index_entry entry;
+  const uint32_t ts_tag = 0x00020010;
+
+  /* DICOM File in memory: header followed by the data set */
+  fseek(in, 0, SEEK_END);
+  const long dataset_size = ftell(in);
+  rewind(in);
+  buf = malloc(PREAMBLE_SIZE + 256 + dataset_size);
+  if (!buf) {
+    goto end;
+  }
+  const size_t header_size = build_header(buf, ts);
+  if (fread(buf + header_size, 1, dataset_size, in) != (size_t)dataset_size) {
+    goto end;
+  }
+
+  /* reference: data set only */
+  if (dicm_src_mem_create(&src, buf + header_size, dataset_size) < 0) {
+    goto end;
+  }
+  const int nref = collect(src, structure, ref, NULL, NULL);
+  dicm_delete(src);
+  if (nref < 1) {
+    goto end;
+  }
+
+  /* File Meta Information then the same data set */
+  if (dicm_src_mem_create(&src, buf, header_size + dataset_size) < 0) {
+    goto end;
+  }
+  if (dicm_index_create(&index) < 0) {
+    dicm_delete(src);
+    goto end;
+  }
+  const int n = collect(src, DICM_STRUCTURE_PART10, records, read_ts, index);
+  dicm_delete(src);
+  if (n != nmeta + nref - 1 || strcmp(ts, read_ts) != 0) {
+    fprintf(stderr, "part10: unexpected trace\n");
+    goto end;
+  }
+  /* offsets are absolute in the file */
+  if (dicm_index_find(index, &ts_tag, 1, &entry) < 0 ||
+      memcmp(buf + entry.value_offset, ts, strlen(ts)) != 0) {
+    fprintf(stderr, "part10: unexpected offset\n");
+    goto end;
+  }
+  for (int i = 0; i < n; ++i) {
+    const struct record *expected = i < nmeta ? &meta[i] : &ref[i - nmeta + 1];
+    if (expected->event != records[i].event ||
+        expected->tag != records[i].tag) {
+      fprintf(stderr, "part10: mismatch at %d\n", i);
+      goto end;
+    }
+  }
+
+  /* same trace when the file arrives byte per byte */
+  if (collect_push(buf, header_size + dataset_size, records) != n) {
+    fprintf(stderr, "part10: unexpected push trace\n");
+    goto end;
+  }
+  for (int i = 0; i < n; ++i) {
+    const struct record *expected = i < nmeta ? &meta[i] : &ref[i - nmeta + 1];
+    if (expected->event != records[i].event ||
+        expected->tag != records[i].tag) {
+      fprintf(stderr, "part10: push mismatch at %d\n", i);
+      goto end;
+    }
+  }
+
+  /* missing "DICM" prefix is an error */
+  buf[PREAMBLE_SIZE] = 'X';
+  if (dicm_src_mem_create(&src, buf, header_size + dataset_size) < 0) {
+    goto end;
+  }
+  if (collect(src, DICM_STRUCTURE_PART10, records, NULL, NULL) >= 0) {
+    fprintf(stderr, "part10: invalid prefix accepted\n");
+    dicm_delete(src);
+    goto end;
+  }
+  dicm_delete(src);
+
+  /* deflated and private transfer syntaxes are errors */
+  if (check_header("1.2.840.10008.1.2.1", records) < 0 ||
+      check_header("1.2.840.10008.1.2.1.99", records) >= 0 ||
+      check_header("1.2.840.10008.1.2.4.95", records) >= 0 ||
+      check_header("1.2.840.10008.1.2.4.205", records) >= 0 ||
+      check_header("1.2.840.113619.5.2", records) >= 0) {
+    fprintf(stderr, "part10: unexpected transfer syntax handling\n");
+    goto end;
+  }
+  ret = EXIT_SUCCESS;
+
+end:
+  if (index) {
+    dicm_delete(index);
+  }
+  free(buf);
+  fclose(in);
+  return ret;
+}
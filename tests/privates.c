@@ -0,0 +1,243 @@
+#include "dicm.h"
+
+#include <stdio.h>  /* fprintf */
+#include <stdlib.h> /* EXIT_SUCCESS */
+#include <string.h> /* strcmp, memcpy */
+
+/* VR reported for a key */
+struct record {
+  uint32_t tag;
+  char vr[4];
+};
+
+enum { MAX_RECORDS = 32, BUFFER_SIZE = 512, IMAGE_SIZE = 1024 };
+
+/* hand written implicit VR little endian data set */
+struct writer {
+  unsigned char buf[BUFFER_SIZE];
+  size_t n;
+};
+
+static void put32(struct writer *w, uint32_t v) {
+  for (int i = 0; i < 4; ++i) {
+    w->buf[w->n++] = (v >> (8 * i)) & 0xff;
+  }
+}
+
+static void patch32(struct writer *w, size_t pos, uint32_t v) {
+  const size_t n = w->n;
+  w->n = pos;
+  put32(w, v);
+  w->n = n;
+}
+
+static void put_tag(struct writer *w, uint32_t tag) {
+  put32(w, (tag >> 16) | (tag & 0xffff) << 16);
+}
+
+static void put_element(struct writer *w, uint32_t tag, const char *value) {
+  const size_t len = strlen(value);
+  put_tag(w, tag);
+  put32(w, (uint32_t)len);
+  memcpy(w->buf + w->n, value, len);
+  w->n += len;
+}
+
+/* defined length sequence or item, return the position of the vl to patch */
+static size_t open_length(struct writer *w, uint32_t tag) {
+  put_tag(w, tag);
+  const size_t pos = w->n;
+  put32(w, 0);
+  return pos;
+}
+
+static void close_length(struct writer *w, size_t pos) {
+  patch32(w, pos, (uint32_t)(w->n - pos - 4));
+}
+
+struct memsink {
+  unsigned char *ptr;
+  size_t size;
+  size_t pos;
+};
+
+static int64_t my_write(struct dicm_dst *const dst, const void *buf,
+                        size_t size) {
+  struct dicm_dst_user *self = (struct dicm_dst_user *)dst;
+  struct memsink *sink = self->data;
+  if (size > sink->size - sink->pos) {
+    return -1;
+  }
+  memcpy(sink->ptr + sink->pos, buf, size);
+  sink->pos += size;
+  return (int64_t)size;
+}
+
+static void build(struct writer *w) {
+  size_t sq, item;
+  w->n = 0;
+  put_element(w, 0x00080016, "1.20");
+  put_element(w, 0x00090010, "ACME 1.0");
+  put_element(w, 0x00090011, "OTHER ");
+  put_element(w, 0x00091001, "AB");
+  sq = open_length(w, 0x00091002);
+  {
+    /* the item reserves its own block */
+    item = open_length(w, 0xfffee000);
+    put_element(w, 0x00090012, " ACME 1.0 ");
+    put_element(w, 0x00091201, "AB");
+    close_length(w, item);
+    /* reservations do not carry over to the next item */
+    item = open_length(w, 0xfffee000);
+    put_element(w, 0x00091201, "AB");
+    close_length(w, item);
+  }
+  close_length(w, sq);
+  put_element(w, 0x00091003, "1 ");
+  /* unknown creator, no creator */
+  put_element(w, 0x00091101, "AB");
+  put_element(w, 0x00111001, "AB");
+}
+
+static const struct record expected[] = {
+    {0x00080016, "UI"}, {0x00090010, "LO"}, {0x00090011, "LO"},
+    {0x00091001, "US"}, {0x00091002, "SQ"}, {0x00090012, "LO"},
+    {0x00091201, "US"}, {0x00091201, ""},   {0x00091003, "DS"},
+    {0x00091101, ""},   {0x00111001, ""}};
+
+/* keys of the whole document, values are read or skipped */
+static int collect(const struct writer *w, struct dicm_private_dict *dict,
+                   int skip, struct record *records) {
+  struct dicm_parser *parser;
+  struct dicm_src *src;
+  struct dicm_key key;
+  const void *ptr;
+  uint32_t size;
+  int n = 0;
+  int done = 0;
+  if (dicm_src_mem_create(&src, w->buf, w->n) < 0) {
+    return -1;
+  }
+  if (dicm_parser_create(&parser) < 0) {
+    dicm_delete(src);
+    return -1;
+  }
+  if (dicm_parser_set_input(parser, DICM_STRUCTURE_IMPLICIT, src) < 0 ||
+      dicm_parser_set_private_dict(parser, dict) < 0) {
+    goto error;
+  }
+  while (!done) {
+    const int next = dicm_parser_next_event(parser);
+    if (next < 0) {
+      goto error;
+    }
+    switch (next) {
+    case DICM_KEY_EVENT:
+      if (n == MAX_RECORDS || dicm_parser_get_key(parser, &key) < 0) {
+        goto error;
+      }
+      records[n].tag = key.tag;
+      memset(records[n].vr, 0, sizeof records[n].vr);
+      memcpy(records[n].vr, &key.vr, 2);
+      ++n;
+      break;
+    case DICM_VALUE_EVENT:
+      if (skip ? dicm_parser_skip_value(parser) < 0
+               : dicm_parser_get_size(parser, &size) < 0 ||
+                     dicm_parser_borrow_bytes(parser, &ptr, size) < 0) {
+        goto error;
+      }
+      break;
+    default:;
+    }
+    done = next == DICM_DOCUMENT_END_EVENT;
+  }
+  dicm_delete(parser);
+  dicm_delete(src);
+  return n;
+
+error:
+  dicm_delete(parser);
+  dicm_delete(src);
+  return -1;
+}
+
+static int check(const struct writer *w, struct dicm_private_dict *dict) {
+  struct record records[MAX_RECORDS];
+  const int nexpected = sizeof expected / sizeof *expected;
+  for (int skip = 0; skip <= 1; ++skip) {
+    const int n = collect(w, dict, skip, records);
+    if (n != nexpected) {
+      return -1;
+    }
+    for (int i = 0; i < n; ++i) {
+      if (expected[i].tag != records[i].tag ||
+          strcmp(expected[i].vr, records[i].vr) != 0) {
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
+
+int privates(int argc, char *argv[]) {
+  static struct writer w;
+  /* 8-byte aligned, as a memory mapping would be */
+  static uint64_t image[IMAGE_SIZE / 8];
+  struct dicm_private_dict *dict, *loaded;
+  struct dicm_dst *dst;
+  build(&w);
+
+  if (dicm_private_dict_create(&dict) < 0) {
+    return EXIT_FAILURE;
+  }
+  int ret = EXIT_FAILURE;
+  if (dicm_private_dict_add(dict, "ACME 1.0", 0x00091001, "US") < 0 ||
+      dicm_private_dict_add(dict, "ACME 1.0", 0x00091002, "SQ") < 0 ||
+      dicm_private_dict_add(dict, "ACME 1.0", 0x00091003, "DS") < 0 ||
+      dicm_private_dict_add(dict, "ACME 1.1", 0x00091001, "FL") < 0) {
+    goto end;
+  }
+  /* duplicate, standard group, bad VR */
+  if (dicm_private_dict_add(dict, "ACME 1.0 ", 0x00091101, "OB") == 0 ||
+      dicm_private_dict_add(dict, "ACME 1.0", 0x00101001, "US") == 0 ||
+      dicm_private_dict_add(dict, "ACME 1.0", 0x00091004, "us") == 0) {
+    fprintf(stderr, "privates: invalid entry added\n");
+    goto end;
+  }
+  if (check(&w, dict) < 0) {
+    fprintf(stderr, "privates: mismatch\n");
+    goto end;
+  }
+
+  /* same lookups on the binary image */
+  struct memsink sink = {(unsigned char *)image, sizeof image, 0};
+  if (dicm_dst_stream_create(&dst, &sink, my_write, NULL) < 0) {
+    goto end;
+  }
+  const int res = dicm_private_dict_write(dict, dst);
+  dicm_delete(dst);
+  if (res < 0 || dicm_private_dict_load(&loaded, image, sink.pos, 1) < 0) {
+    goto end;
+  }
+  const int mismatch = check(&w, loaded) < 0;
+  /* read-only */
+  const int added = dicm_private_dict_add(loaded, "ACME", 0x00091001, "US");
+  dicm_delete(loaded);
+  if (mismatch || added == 0) {
+    fprintf(stderr, "privates: image mismatch\n");
+    goto end;
+  }
+  /* corrupted image */
+  sink.ptr[sink.pos - 1] ^= 1;
+  if (dicm_private_dict_load(&loaded, image, sink.pos, 1) == 0) {
+    fprintf(stderr, "privates: corrupted image accepted\n");
+    dicm_delete(loaded);
+    goto end;
+  }
+  ret = EXIT_SUCCESS;
+
+end:
+  dicm_delete(dict);
+  return ret;
+}
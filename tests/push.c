@@ -0,0 +1,258 @@
+#include "common.h"
+
+#include <stdio.h>  /* FILE* */
+#include <stdlib.h> /* EXIT_SUCCESS */
+
+/* compact trace of a parse, values are hashed */
+struct record {
+  int event;
+  uint32_t tag;
+  uint32_t hash;
+};
+
+enum { MAX_RECORDS = 4096 };
+
+/* input fed in fixed size chunks */
+struct feeder {
+  const unsigned char *ptr;
+  size_t size;
+  size_t pos;
+  size_t chunk;
+};
+
+/* FNV-1a */
+static uint32_t hash(const void *ptr, size_t len) {
+  const unsigned char *p = ptr;
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; ++i) {
+    h = (h ^ p[i]) * 16777619u;
+  }
+  return h;
+}
+
+/* feed the next chunk, then the end of the input */
+static int feed(struct dicm_parser *parser, struct feeder *feeder) {
+  const size_t avail = feeder->size - feeder->pos;
+  const size_t len = avail < feeder->chunk ? avail : feeder->chunk;
+  if (feeder->pos > feeder->size) {
+    /* end of input was already signaled */
+    return -1;
+  }
+  feeder->pos += len != 0 ? len : 1;
+  return dicm_parser_feed(parser, feeder->ptr + feeder->pos - len, len);
+}
+
+enum { SKIP_NONE, SKIP_VALUES, SKIP_SEQUENCES };
+
+/* call until the input has been fed */
+static int retry(struct dicm_parser *parser, struct feeder *feeder,
+                 int (*fp)(struct dicm_parser *)) {
+  for (;;) {
+    const int ret = fp(parser);
+    if (ret != DICM_NEED_MORE_DATA) {
+      return ret;
+    }
+    if (feed(parser, feeder) < 0) {
+      return -1;
+    }
+  }
+}
+
+static int skip_value(struct dicm_parser *parser) {
+  return dicm_parser_skip_value(parser);
+}
+
+static int skip_sequence(struct dicm_parser *parser) {
+  return dicm_parser_skip_sequence(parser);
+}
+
+/* parse the whole document, return the number of records or -1 on error.
+ * Without a feeder the input is a memory source. With SKIP_SEQUENCES, defined
+ * length sequences are skipped as a whole */
+static int collect(const unsigned char *ptr, size_t size, int structure,
+                   struct feeder *feeder, int skip, struct record *records) {
+  struct dicm_parser *parser;
+  struct dicm_src *src = NULL;
+  struct dicm_key key;
+  const void *value;
+  uint32_t len;
+  int n = 0;
+  int done = 0;
+  if (dicm_parser_create(&parser) < 0) {
+    return -1;
+  }
+  if (feeder) {
+    if (dicm_parser_set_push_input(parser, structure) < 0) {
+      goto error;
+    }
+  } else if (dicm_src_mem_create(&src, ptr, size) < 0 ||
+             dicm_parser_set_input(parser, structure, src) < 0) {
+    goto error;
+  }
+  while (!done && n < MAX_RECORDS) {
+    const int next = dicm_parser_next_event(parser);
+    if (next == DICM_NEED_MORE_DATA) {
+      if (feed(parser, feeder) < 0) {
+        goto error;
+      }
+      continue;
+    }
+    if (next < 0) {
+      goto error;
+    }
+    struct record *record = &records[n++];
+    record->event = next;
+    record->tag = 0;
+    record->hash = 0;
+    switch (next) {
+    case DICM_KEY_EVENT:
+      if (dicm_parser_get_key(parser, &key) < 0) {
+        goto error;
+      }
+      record->tag = key.tag;
+      break;
+    case DICM_VALUE_EVENT:
+      if (dicm_parser_get_size(parser, &len) < 0) {
+        goto error;
+      }
+      if (skip != SKIP_NONE) {
+        if (retry(parser, feeder, skip_value) < 0) {
+          goto error;
+        }
+        break;
+      }
+      for (;;) {
+        const int ret = dicm_parser_borrow_bytes(parser, &value, len);
+        if (ret != DICM_NEED_MORE_DATA) {
+          if (ret < 0) {
+            goto error;
+          }
+          break;
+        }
+        if (feed(parser, feeder) < 0) {
+          goto error;
+        }
+      }
+      record->hash = hash(value, len);
+      break;
+    case DICM_SEQUENCE_START_EVENT:
+      /* -1 for undefined length sequences, then parsed as usual */
+      if (skip == SKIP_SEQUENCES) {
+        (void)retry(parser, feeder, skip_sequence);
+      }
+      break;
+    default:;
+    }
+    done = next == DICM_DOCUMENT_END_EVENT;
+  }
+  dicm_delete(parser);
+  if (src) {
+    dicm_delete(src);
+  }
+  return n;
+
+error:
+  dicm_delete(parser);
+  if (src) {
+    dicm_delete(src);
+  }
+  return -1;
+}
+
+static int compare(const struct record *ref, int nref,
+                   const struct record *records, int n, int skip) {
+  if (n != nref) {
+    return -1;
+  }
+  for (int i = 0; i < n; ++i) {
+    if (ref[i].event != records[i].event || ref[i].tag != records[i].tag ||
+        (!skip && ref[i].hash != records[i].hash)) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/* defined length sequence skipped while fed in chunks of 1 to 32 bytes */
+static int defined_sequence(void) {
+  static const unsigned char input[] = {
+      /* (0008,1140) SQ, 28 bytes */
+      0x08, 0x00, 0x40, 0x11, 'S', 'Q', 0x00, 0x00, 28, 0x00, 0x00, 0x00,
+      /* item, 20 bytes */
+      0xfe, 0xff, 0x00, 0xe0, 20, 0x00, 0x00, 0x00,
+      /* (0008,1150) UI */
+      0x08, 0x00, 0x50, 0x11, 'U', 'I', 12, 0x00, '1', '.', '2', '.', '8',
+      '4', '0', '.', '1', '2', '3', 0x00,
+      /* (0010,0010) PN */
+      0x10, 0x00, 0x10, 0x00, 'P', 'N', 4, 0x00, 'A', '^', 'B', ' '};
+  static struct record ref[MAX_RECORDS];
+  static struct record records[MAX_RECORDS];
+  const int nref = collect(input, sizeof input, DICM_STRUCTURE_EXPLICIT_LE,
+                           NULL, SKIP_SEQUENCES, ref);
+  /* document start, key, sequence start and end, key, value, document end */
+  if (nref != 7 || ref[3].event != DICM_SEQUENCE_END_EVENT ||
+      ref[4].tag != 0x00100010) {
+    fprintf(stderr, "push: sequence not skipped\n");
+    return EXIT_FAILURE;
+  }
+  for (size_t chunk = 1; chunk <= 32; ++chunk) {
+    struct feeder feeder = {input, sizeof input, 0, chunk};
+    const int n = collect(input, sizeof input, DICM_STRUCTURE_EXPLICIT_LE,
+                          &feeder, SKIP_SEQUENCES, records);
+    if (compare(ref, nref, records, n, SKIP_SEQUENCES) < 0) {
+      fprintf(stderr, "push: sequence skip mismatch with chunks of %zu bytes\n",
+              chunk);
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
+
+int push(int argc, char *argv[]) {
+  if (argc == 1) {
+    return defined_sequence();
+  }
+  if (argc < 3)
+    return EXIT_FAILURE;
+  static struct record ref[MAX_RECORDS];
+  static struct record records[MAX_RECORDS];
+  /* byte per byte, odd sized chunks, everything at once */
+  static const size_t chunks[] = {1, 7, 1 << 20};
+  const int structure = get_structure(argv[1]);
+  const char *infilename = argv[2];
+  FILE *in = fopen(infilename, "rb");
+  if (!in || structure < 0) {
+    return EXIT_FAILURE;
+  }
+  int ret = EXIT_FAILURE;
+  unsigned char *buf = NULL;
+  fseek(in, 0, SEEK_END);
+  const long size = ftell(in);
+  rewind(in);
+  buf = malloc(size + 1);
+  if (!buf || fread(buf, 1, size, in) != (size_t)size) {
+    goto end;
+  }
+
+  for (int skip = SKIP_NONE; skip <= SKIP_SEQUENCES; ++skip) {
+    const int nref = collect(buf, size, structure, NULL, skip, ref);
+    if (nref < 1) {
+      goto end;
+    }
+    for (size_t i = 0; i < sizeof chunks / sizeof *chunks; ++i) {
+      struct feeder feeder = {buf, (size_t)size, 0, chunks[i]};
+      const int n = collect(buf, size, structure, &feeder, skip, records);
+      if (compare(ref, nref, records, n, skip) < 0) {
+        fprintf(stderr, "push: mismatch with chunks of %zu bytes (skip %d)\n",
+                chunks[i], skip);
+        goto end;
+      }
+    }
+  }
+  ret = EXIT_SUCCESS;
+
+end:
+  free(buf);
+  fclose(in);
+  return ret;
+}
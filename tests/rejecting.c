@@ -0,0 +1,65 @@
+#include "common.h"
+
+#include <stdio.h>  /* fprintf */
+#include <stdlib.h> /* EXIT_SUCCESS */
+#include <string.h> /* strcmp */
+
+/* a structure value that is not part of enum dicm_structure_type */
+enum { INVALID_STRUCTURE = 42 };
+
+/* both the parser and the emitter must refuse the structure */
+static int check_rejected(const int structure) {
+  static const unsigned char input[] = {0};
+  unsigned char output[16];
+  int ret = -1;
+  struct dicm_src *src = NULL;
+  struct dicm_dst *dst = NULL;
+  struct dicm_parser *parser = NULL;
+  struct dicm_emitter *emitter = NULL;
+  if (dicm_src_mem_create(&src, input, sizeof input) < 0 ||
+      dicm_dst_mem_create(&dst, output, sizeof output) < 0 ||
+      dicm_parser_create(&parser) < 0 || dicm_emitter_create(&emitter) < 0) {
+    goto end;
+  }
+  if (dicm_parser_set_input(parser, structure, src) >= 0) {
+    goto end;
+  }
+  /* File Meta Information is parsed only */
+  if (structure != DICM_STRUCTURE_PART10 &&
+      dicm_emitter_set_output(emitter, structure, dst) >= 0) {
+    goto end;
+  }
+  ret = 0;
+
+end:
+  if (emitter)
+    dicm_delete(emitter);
+  if (parser)
+    dicm_delete(parser);
+  if (dst)
+    dicm_delete(dst);
+  if (src)
+    dicm_delete(src);
+  return ret;
+}
+
+/* arguments are the structures compiled out of the library */
+int rejecting(int argc, char *argv[]) {
+  if (check_rejected(INVALID_STRUCTURE) < 0) {
+    fprintf(stderr, "rejecting: invalid structure accepted\n");
+    return EXIT_FAILURE;
+  }
+  for (int i = 1; i < argc; ++i) {
+    const int structure = strcmp("part10", argv[i]) == 0
+                              ? DICM_STRUCTURE_PART10
+                              : get_structure(argv[i]);
+    if (structure < 0) {
+      return EXIT_FAILURE;
+    }
+    if (check_rejected(structure) < 0) {
+      fprintf(stderr, "rejecting: %s accepted\n", argv[i]);
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
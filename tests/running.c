@@ -0,0 +1,301 @@
+#include "common.h"
+
+#include <stdio.h>  /* FILE* */
+#include <stdlib.h> /* EXIT_SUCCESS */
+
+/* compact trace of a parse, values are hashed */
+struct record {
+  int event;
+  uint32_t tag;
+  uint32_t hash;
+};
+
+enum { MAX_RECORDS = 4096, FNV_BASIS = 2166136261u, STOP = 42 };
+
+struct trace {
+  struct record *records;
+  int n;
+  /* running hash of the current value */
+  uint32_t hash;
+  /* stop on the first key when set */
+  int stop;
+};
+
+/* FNV-1a */
+static uint32_t hash_update(uint32_t h, const void *ptr, size_t len) {
+  const unsigned char *p = ptr;
+  for (size_t i = 0; i < len; ++i) {
+    h = (h ^ p[i]) * 16777619u;
+  }
+  return h;
+}
+
+static int add(struct trace *trace, int event, uint32_t tag) {
+  if (trace->n == MAX_RECORDS) {
+    return -1;
+  }
+  struct record *record = &trace->records[trace->n++];
+  record->event = event;
+  record->tag = tag;
+  record->hash = 0;
+  return 0;
+}
+
+static int on_document_start(void *ctx) {
+  return add(ctx, DICM_DOCUMENT_START_EVENT, 0);
+}
+static int on_document_end(void *ctx) {
+  return add(ctx, DICM_DOCUMENT_END_EVENT, 0);
+}
+static int on_key(void *ctx, const struct dicm_key *key, uint32_t size) {
+  struct trace *trace = ctx;
+  (void)size;
+  return trace->stop ? STOP : add(trace, DICM_KEY_EVENT, key->tag);
+}
+static int on_fragment(void *ctx, uint32_t size) {
+  (void)size;
+  return add(ctx, DICM_FRAGMENT_EVENT, 0);
+}
+static int on_value(void *ctx, const void *ptr, size_t len,
+                    uint32_t remaining) {
+  struct trace *trace = ctx;
+  trace->hash = hash_update(trace->hash, ptr, len);
+  if (remaining != 0) {
+    return 0;
+  }
+  if (add(trace, DICM_VALUE_EVENT, 0) < 0) {
+    return -1;
+  }
+  trace->records[trace->n - 1].hash = trace->hash;
+  trace->hash = FNV_BASIS;
+  return 0;
+}
+static int on_item_start(void *ctx) {
+  return add(ctx, DICM_ITEM_START_EVENT, 0);
+}
+static int on_item_end(void *ctx) { return add(ctx, DICM_ITEM_END_EVENT, 0); }
+static int on_sequence_start(void *ctx) {
+  return add(ctx, DICM_SEQUENCE_START_EVENT, 0);
+}
+static int on_sequence_end(void *ctx) {
+  return add(ctx, DICM_SEQUENCE_END_EVENT, 0);
+}
+
+static const struct dicm_handlers handlers = {
+    .fp_document_start = on_document_start,
+    .fp_document_end = on_document_end,
+    .fp_key = on_key,
+    .fp_fragment = on_fragment,
+    .fp_value = on_value,
+    .fp_item_start = on_item_start,
+    .fp_item_end = on_item_end,
+    .fp_sequence_start = on_sequence_start,
+    .fp_sequence_end = on_sequence_end};
+
+/* reference trace, one event at a time */
+static int collect(struct dicm_src *src, int structure,
+                   struct record *records) {
+  struct dicm_parser *parser;
+  struct dicm_key key;
+  const void *ptr;
+  uint32_t size;
+  int n = 0;
+  int done = 0;
+  if (dicm_parser_create(&parser) < 0) {
+    return -1;
+  }
+  if (dicm_parser_set_input(parser, structure, src) < 0) {
+    goto error;
+  }
+  while (!done && n < MAX_RECORDS) {
+    const int next = dicm_parser_next_event(parser);
+    if (next < 0) {
+      goto error;
+    }
+    struct record *record = &records[n++];
+    record->event = next;
+    record->tag = 0;
+    record->hash = 0;
+    switch (next) {
+    case DICM_KEY_EVENT:
+      if (dicm_parser_get_key(parser, &key) < 0) {
+        goto error;
+      }
+      record->tag = key.tag;
+      break;
+    case DICM_VALUE_EVENT:
+      if (dicm_parser_get_size(parser, &size) < 0 ||
+          dicm_parser_borrow_bytes(parser, &ptr, size) < 0) {
+        goto error;
+      }
+      record->hash = hash_update(FNV_BASIS, ptr, size);
+      break;
+    default:;
+    }
+    done = next == DICM_DOCUMENT_END_EVENT;
+  }
+  dicm_delete(parser);
+  return n;
+
+error:
+  dicm_delete(parser);
+  return -1;
+}
+
+/* trace from callbacks. When chunk is not 0 the input is pushed in chunks of
+ * that size, otherwise it is read from src */
+static int run(struct dicm_src *src, int structure, const unsigned char *ptr,
+               size_t size, size_t chunk, struct trace *trace) {
+  struct dicm_parser *parser;
+  int ret = -1;
+  trace->n = 0;
+  trace->hash = FNV_BASIS;
+  if (dicm_parser_create(&parser) < 0) {
+    return -1;
+  }
+  if (chunk == 0) {
+    if (dicm_parser_set_input(parser, structure, src) < 0) {
+      goto end;
+    }
+    ret = dicm_parser_run(parser, &handlers, trace);
+    goto end;
+  }
+  if (dicm_parser_set_push_input(parser, structure) < 0) {
+    goto end;
+  }
+  for (size_t pos = 0; pos <= size; pos += chunk) {
+    const size_t len = size - pos < chunk ? size - pos : chunk;
+    /* a short chunk is the last one */
+    if (dicm_parser_feed(parser, ptr + pos, len) < 0 ||
+        (len != 0 && len != chunk && dicm_parser_feed(parser, ptr, 0) < 0)) {
+      goto end;
+    }
+    ret = dicm_parser_run(parser, &handlers, trace);
+    if (ret != DICM_NEED_MORE_DATA) {
+      break;
+    }
+  }
+
+end:
+  dicm_delete(parser);
+  return ret;
+}
+
+static int compare(const struct record *ref, int nref,
+                   const struct trace *trace) {
+  if (trace->n != nref) {
+    return -1;
+  }
+  for (int i = 0; i < nref; ++i) {
+    const struct record *record = &trace->records[i];
+    if (ref[i].event != record->event || ref[i].tag != record->tag ||
+        ref[i].hash != record->hash) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+int running(int argc, char *argv[]) {
+  if (argc < 3)
+    return EXIT_FAILURE;
+  static struct record ref[MAX_RECORDS];
+  static struct record records[MAX_RECORDS];
+  struct trace trace = {records, 0, FNV_BASIS, 0};
+  const int structure = get_structure(argv[1]);
+  const char *infilename = argv[2];
+  FILE *in = fopen(infilename, "rb");
+  if (!in || structure < 0) {
+    return EXIT_FAILURE;
+  }
+  int ret = EXIT_FAILURE;
+  unsigned char *buf = NULL;
+  struct dicm_src *src = NULL;
+  fseek(in, 0, SEEK_END);
+  const long size = ftell(in);
+  rewind(in);
+  buf = malloc(size + 1);
+  if (!buf || fread(buf, 1, size, in) != (size_t)size) {
+    goto end;
+  }
+
+  if (dicm_src_mem_create(&src, buf, size) < 0) {
+    goto end;
+  }
+  const int nref = collect(src, structure, ref);
+  dicm_delete(src);
+  if (nref < 1) {
+    goto end;
+  }
+
+  /* contiguous source: values borrowed in one chunk */
+  if (dicm_src_mem_create(&src, buf, size) < 0) {
+    goto end;
+  }
+  if (run(src, structure, NULL, 0, 0, &trace) != 0 ||
+      compare(ref, nref, &trace) < 0) {
+    fprintf(stderr, "running: mem mismatch\n");
+    dicm_delete(src);
+    goto end;
+  }
+  dicm_delete(src);
+
+  /* stream source: values read in the parser buffer */
+  struct memstream memstream = {buf, (size_t)size, 0};
+  if (dicm_src_stream_create(&src, &memstream, memstream_read, NULL) < 0) {
+    goto end;
+  }
+  if (run(src, structure, NULL, 0, 0, &trace) != 0 ||
+      compare(ref, nref, &trace) < 0) {
+    fprintf(stderr, "running: stream mismatch\n");
+    dicm_delete(src);
+    goto end;
+  }
+  dicm_delete(src);
+
+  /* non-seekable buffered source: values larger than the window are
+   * delivered in bounded chunks, skipped ones are discarded window by
+   * window */
+  struct dicm_src *base;
+  memstream.pos = 0;
+  if (dicm_src_stream_create(&base, &memstream, memstream_read, NULL) < 0) {
+    goto end;
+  }
+  if (dicm_src_buffered_create(&src, base, 12) < 0) {
+    dicm_delete(base);
+    goto end;
+  }
+  const int mismatch = run(src, structure, NULL, 0, 0, &trace) != 0 ||
+                       compare(ref, nref, &trace) < 0;
+  dicm_delete(src);
+  dicm_delete(base);
+  if (mismatch) {
+    fprintf(stderr, "running: buffered mismatch\n");
+    goto end;
+  }
+
+  /* push mode: resumed after each chunk, values split across chunks */
+  if (run(NULL, structure, buf, size, 7, &trace) != 0 ||
+      compare(ref, nref, &trace) < 0) {
+    fprintf(stderr, "running: push mismatch\n");
+    goto end;
+  }
+
+  /* a callback stops the parse */
+  trace.stop = 1;
+  if (dicm_src_mem_create(&src, buf, size) < 0) {
+    goto end;
+  }
+  const int stopped = run(src, structure, NULL, 0, 0, &trace);
+  dicm_delete(src);
+  if (stopped != STOP) {
+    fprintf(stderr, "running: not stopped\n");
+    goto end;
+  }
+  ret = EXIT_SUCCESS;
+
+end:
+  free(buf);
+  fclose(in);
+  return ret;
+}
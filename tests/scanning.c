@@ -0,0 +1,272 @@
+#include "common.h"
+
+#include <stdio.h>  /* FILE* */
+#include <stdlib.h> /* EXIT_SUCCESS */
+
+/* compact trace of a parse, values are not kept */
+struct record {
+  int event;
+  uint32_t tag;
+  int depth;
+};
+
+enum { MAX_RECORDS = 4096, MAX_WANTED = 64 };
+
+/* root level filter applied during collect */
+struct filter {
+  uint32_t max_tag;
+  const uint32_t *wanted;
+  size_t nwanted;
+};
+
+static int64_t my_read(struct dicm_src *const src, void *buf, size_t size) {
+  struct dicm_src_user *self = (struct dicm_src_user *)src;
+  FILE *stream = self->data;
+  const size_t read = fread(buf, 1, size, stream);
+  return (int64_t)read;
+}
+
+/* specialized entry points */
+static int set_input_fast(struct dicm_parser *parser, int structure,
+                          struct dicm_src *src) {
+  switch (structure) {
+  case DICM_STRUCTURE_ENCAPSULATED:
+    return dicm_parser_set_input_encap_fast(parser, src);
+  case DICM_STRUCTURE_IMPLICIT:
+    return dicm_parser_set_input_ivrle_fast(parser, src);
+  case DICM_STRUCTURE_EXPLICIT_LE:
+    return dicm_parser_set_input_evrle_fast(parser, src);
+  case DICM_STRUCTURE_EXPLICIT_BE:
+    return dicm_parser_set_input_evrbe_fast(parser, src);
+  }
+  return -1;
+}
+
+/* parse the whole document, either reading or skipping values. Return the
+ * number of records or -1 on error */
+static int collect(struct dicm_src *src, int structure, int skip, int fast,
+                   const struct filter *filter, struct record *records) {
+  struct dicm_parser *parser;
+  struct dicm_key key;
+  char buf[4096];
+  uint32_t size;
+  int n = 0;
+  int depth = 0;
+  int done = 0;
+  if (dicm_parser_create(&parser) < 0) {
+    return -1;
+  }
+  const int res = fast ? set_input_fast(parser, structure, src)
+                       : dicm_parser_set_input(parser, structure, src);
+  if (res < 0) {
+    goto error;
+  }
+  if (filter && (dicm_parser_set_max_tag(parser, filter->max_tag) < 0 ||
+                 dicm_parser_set_wanted_tags(parser, filter->wanted,
+                                             filter->nwanted) < 0)) {
+    goto error;
+  }
+  while (!done && n < MAX_RECORDS) {
+    const int next = dicm_parser_next_event(parser);
+    if (next < 0) {
+      goto error;
+    }
+    struct record *record = &records[n++];
+    record->event = next;
+    record->tag = 0;
+    if (next == DICM_SEQUENCE_END_EVENT) {
+      --depth;
+    }
+    record->depth = depth;
+    switch (next) {
+    case DICM_KEY_EVENT:
+      if (dicm_parser_get_key(parser, &key) < 0) {
+        goto error;
+      }
+      record->tag = key.tag;
+      break;
+    case DICM_VALUE_EVENT:
+      if (dicm_parser_get_size(parser, &size) < 0) {
+        goto error;
+      }
+      if (skip) {
+        if (dicm_parser_skip_value(parser) < 0) {
+          goto error;
+        }
+        break;
+      }
+      do {
+        const size_t len = size < sizeof buf ? size : sizeof buf;
+        if (dicm_parser_read_bytes(parser, buf, len) < 0) {
+          goto error;
+        }
+        size -= len;
+      } while (size != 0);
+      break;
+    case DICM_SEQUENCE_START_EVENT:
+      ++depth;
+      break;
+    default:;
+    }
+    done = next == DICM_DOCUMENT_END_EVENT;
+  }
+  dicm_delete(parser);
+  return n;
+
+error:
+  dicm_delete(parser);
+  return -1;
+}
+
+static int compare(const struct record *ref, int nref,
+                   const struct record *records, int n) {
+  if (n != nref) {
+    return -1;
+  }
+  for (int i = 0; i < n; ++i) {
+    if (ref[i].event != records[i].event || ref[i].tag != records[i].tag ||
+        ref[i].depth != records[i].depth) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static int is_root_key(const struct record *record) {
+  return record->event == DICM_KEY_EVENT && record->depth == 0;
+}
+
+/* compute the expected trace of a filtered parse from the reference one:
+ * root level elements past the limit end the document, unwanted elements
+ * followed directly by their value are dropped */
+static int apply_filter(const struct record *ref, int nref,
+                        const struct filter *filter, struct record *expected) {
+  const uint32_t last =
+      filter->nwanted ? filter->wanted[filter->nwanted - 1] : 0xffffffff;
+  int n = 0;
+  for (int i = 0; i < nref; ++i) {
+    if (is_root_key(&ref[i])) {
+      const uint32_t tag = ref[i].tag;
+      if (tag > filter->max_tag || tag > last) {
+        expected[n] = ref[nref - 1]; /* document end */
+        return n + 1;
+      }
+      int wanted = filter->nwanted == 0;
+      for (size_t j = 0; j < filter->nwanted; ++j) {
+        wanted |= filter->wanted[j] == tag;
+      }
+      if (!wanted && i + 1 < nref && ref[i + 1].event == DICM_VALUE_EVENT) {
+        ++i;
+        continue;
+      }
+    }
+    expected[n++] = ref[i];
+  }
+  return n;
+}
+
+static int check_filter(FILE *in, int structure, const struct record *ref,
+                        int nref, const struct filter *filter) {
+  static struct record expected[MAX_RECORDS];
+  static struct record records[MAX_RECORDS];
+  struct dicm_src *src;
+  const int nexpected = apply_filter(ref, nref, filter, expected);
+  rewind(in);
+  if (dicm_src_file_create(&src, in) < 0) {
+    return -1;
+  }
+  const int n = collect(src, structure, 1, 0, filter, records);
+  dicm_delete(src);
+  return compare(expected, nexpected, records, n);
+}
+
+int scanning(int argc, char *argv[]) {
+  if (argc < 3)
+    return EXIT_FAILURE;
+  static struct record ref[MAX_RECORDS];
+  static struct record records[MAX_RECORDS];
+  struct dicm_src *src;
+  const int structure = get_structure(argv[1]);
+  const char *infilename = argv[2];
+  FILE *in = fopen(infilename, "rb");
+  if (!in || structure < 0) {
+    return EXIT_FAILURE;
+  }
+  int ret = EXIT_FAILURE;
+
+  /* reference: read every value */
+  if (dicm_src_file_create(&src, in) < 0) {
+    goto end;
+  }
+  const int nref = collect(src, structure, 0, 0, NULL, ref);
+  dicm_delete(src);
+  if (nref < 0) {
+    goto end;
+  }
+
+  /* skip using seek */
+  rewind(in);
+  if (dicm_src_file_create(&src, in) < 0) {
+    goto end;
+  }
+  int n = collect(src, structure, 1, 0, NULL, records);
+  dicm_delete(src);
+  if (compare(ref, nref, records, n) < 0) {
+    fprintf(stderr, "scanning: seek skip mismatch\n");
+    goto end;
+  }
+
+  /* skip using discard (non-seekable) */
+  rewind(in);
+  if (dicm_src_stream_create(&src, in, my_read, NULL) < 0) {
+    goto end;
+  }
+  n = collect(src, structure, 1, 0, NULL, records);
+  dicm_delete(src);
+  if (compare(ref, nref, records, n) < 0) {
+    fprintf(stderr, "scanning: discard skip mismatch\n");
+    goto end;
+  }
+
+  /* specialized parser */
+  rewind(in);
+  if (dicm_src_file_create(&src, in) < 0) {
+    goto end;
+  }
+  n = collect(src, structure, 1, 1, NULL, records);
+  dicm_delete(src);
+  if (compare(ref, nref, records, n) < 0) {
+    fprintf(stderr, "scanning: specialized parser mismatch\n");
+    goto end;
+  }
+
+  /* root level filters: stop in the middle, keep every other element */
+  uint32_t wanted[MAX_WANTED];
+  size_t nwanted = 0;
+  int nroot = 0;
+  for (int i = 0; i < nref; ++i) {
+    if (is_root_key(&ref[i])) {
+      if (nroot % 2 == 0 && nwanted < MAX_WANTED) {
+        wanted[nwanted++] = ref[i].tag;
+      }
+      ++nroot;
+    }
+  }
+  struct filter filter = {0xffffffff, wanted, nwanted};
+  if (check_filter(in, structure, ref, nref, &filter) < 0) {
+    fprintf(stderr, "scanning: wanted tags mismatch\n");
+    goto end;
+  }
+  filter.wanted = NULL;
+  filter.nwanted = 0;
+  filter.max_tag = nwanted ? wanted[nwanted / 2] : 0;
+  if (check_filter(in, structure, ref, nref, &filter) < 0) {
+    fprintf(stderr, "scanning: max tag mismatch\n");
+    goto end;
+  }
+  ret = EXIT_SUCCESS;
+
+end:
+  fclose(in);
+  return ret;
+}
@@ -0,0 +1,439 @@
+#include "common.h"
+
+#include <stdio.h>  /* fprintf */
+#include <stdlib.h> /* EXIT_SUCCESS */
+#include <string.h> /* memcpy */
+
+/* compact trace of a parse */
+struct record {
+  int event;
+  uint32_t tag;
+};
+
+enum { MAX_RECORDS = 64, BUFFER_SIZE = 1024 };
+
+/* hand written data set, defined length sequences and items are not
+ * produced by the emitter */
+struct writer {
+  unsigned char buf[BUFFER_SIZE];
+  size_t n;
+  int big_endian;
+  int explicit_vr;
+};
+
+static void put16(struct writer *w, uint32_t v) {
+  w->buf[w->n + (w->big_endian ? 1 : 0)] = v & 0xff;
+  w->buf[w->n + (w->big_endian ? 0 : 1)] = (v >> 8) & 0xff;
+  w->n += 2;
+}
+
+static void put32(struct writer *w, uint32_t v) {
+  put16(w, w->big_endian ? v >> 16 : v & 0xffff);
+  put16(w, w->big_endian ? v & 0xffff : v >> 16);
+}
+
+static void patch32(struct writer *w, size_t pos, uint32_t v) {
+  const size_t n = w->n;
+  w->n = pos;
+  put32(w, v);
+  w->n = n;
+}
+
+static void put_tag(struct writer *w, uint32_t tag) {
+  put16(w, tag >> 16);
+  put16(w, tag & 0xffff);
+}
+
+/* short value of a 16-bit vl VR */
+static void put_element(struct writer *w, uint32_t tag, const char *vr,
+                        const char *value) {
+  const size_t len = strlen(value);
+  put_tag(w, tag);
+  if (w->explicit_vr) {
+    memcpy(w->buf + w->n, vr, 2);
+    w->n += 2;
+    put16(w, (uint32_t)len);
+  } else {
+    put32(w, (uint32_t)len);
+  }
+  memcpy(w->buf + w->n, value, len);
+  w->n += len;
+}
+
+/* return the position of the vl to patch */
+static size_t open_sequence(struct writer *w, uint32_t tag, int defined) {
+  put_tag(w, tag);
+  if (w->explicit_vr) {
+    memcpy(w->buf + w->n, "SQ\0\0", 4);
+    w->n += 4;
+  }
+  const size_t pos = w->n;
+  put32(w, defined ? 0 : 0xffffffff);
+  return pos;
+}
+
+static size_t open_item(struct writer *w, int defined) {
+  put_tag(w, 0xfffee000);
+  const size_t pos = w->n;
+  put32(w, defined ? 0 : 0xffffffff);
+  return pos;
+}
+
+static void close_length(struct writer *w, size_t pos, int defined,
+                         uint32_t delimiter) {
+  if (defined) {
+    patch32(w, pos, (uint32_t)(w->n - pos - 4));
+  } else {
+    put_tag(w, delimiter);
+    put32(w, 0);
+  }
+}
+
+static void close_sequence(struct writer *w, size_t pos, int defined) {
+  close_length(w, pos, defined, 0xfffee0dd);
+}
+
+static void close_item(struct writer *w, size_t pos, int defined) {
+  close_length(w, pos, defined, 0xfffee00d);
+}
+
+/* implicit VR: defined length sequences are known from the dictionary */
+static void build(struct writer *w) {
+  const int sq_defined = 1;
+  size_t sq, item, nested;
+  w->n = 0;
+  put_element(w, 0x00080016, "UI", "1.20");
+  sq = open_sequence(w, 0x00081140, sq_defined);
+  {
+    item = open_item(w, 1);
+    put_element(w, 0x00081150, "UI", "1.20");
+    put_element(w, 0x00081155, "UI", "1.30");
+    close_item(w, item, 1);
+    item = open_item(w, 0);
+    put_element(w, 0x00081150, "UI", "1.20");
+    close_item(w, item, 0);
+    item = open_item(w, 1);
+    nested = open_sequence(w, 0x00400100, sq_defined);
+    close_sequence(w, nested, sq_defined);
+    close_item(w, item, 1);
+  }
+  close_sequence(w, sq, sq_defined);
+  put_element(w, 0x00100010, "PN", "A^B ");
+  sq = open_sequence(w, 0x00100020, 0);
+  {
+    item = open_item(w, 1);
+    put_element(w, 0x00100030, "DA", "20230101");
+    close_item(w, item, 1);
+  }
+  close_sequence(w, sq, 0);
+  put_element(w, 0x0020000d, "UI", "1.20");
+}
+
+static const struct record expected_full[] = {
+    {DICM_DOCUMENT_START_EVENT, 0},
+    {DICM_KEY_EVENT, 0x00080016},
+    {DICM_VALUE_EVENT, 0},
+    {DICM_KEY_EVENT, 0x00081140},
+    {DICM_SEQUENCE_START_EVENT, 0},
+    {DICM_ITEM_START_EVENT, 0},
+    {DICM_KEY_EVENT, 0x00081150},
+    {DICM_VALUE_EVENT, 0},
+    {DICM_KEY_EVENT, 0x00081155},
+    {DICM_VALUE_EVENT, 0},
+    {DICM_ITEM_END_EVENT, 0},
+    {DICM_ITEM_START_EVENT, 0},
+    {DICM_KEY_EVENT, 0x00081150},
+    {DICM_VALUE_EVENT, 0},
+    {DICM_ITEM_END_EVENT, 0},
+    {DICM_ITEM_START_EVENT, 0},
+    {DICM_KEY_EVENT, 0x00400100},
+    {DICM_SEQUENCE_START_EVENT, 0},
+    {DICM_SEQUENCE_END_EVENT, 0},
+    {DICM_ITEM_END_EVENT, 0},
+    {DICM_SEQUENCE_END_EVENT, 0},
+    {DICM_KEY_EVENT, 0x00100010},
+    {DICM_VALUE_EVENT, 0},
+    {DICM_KEY_EVENT, 0x00100020},
+    {DICM_SEQUENCE_START_EVENT, 0},
+    {DICM_ITEM_START_EVENT, 0},
+    {DICM_KEY_EVENT, 0x00100030},
+    {DICM_VALUE_EVENT, 0},
+    {DICM_ITEM_END_EVENT, 0},
+    {DICM_SEQUENCE_END_EVENT, 0},
+    {DICM_KEY_EVENT, 0x0020000d},
+    {DICM_VALUE_EVENT, 0},
+    {DICM_DOCUMENT_END_EVENT, 0}};
+
+/* (0008,1140) skipped as a whole */
+static const struct record expected_skip[] = {
+    {DICM_DOCUMENT_START_EVENT, 0},
+    {DICM_KEY_EVENT, 0x00080016},
+    {DICM_VALUE_EVENT, 0},
+    {DICM_KEY_EVENT, 0x00081140},
+    {DICM_SEQUENCE_START_EVENT, 0},
+    {DICM_SEQUENCE_END_EVENT, 0},
+    {DICM_KEY_EVENT, 0x00100010},
+    {DICM_VALUE_EVENT, 0},
+    {DICM_KEY_EVENT, 0x00100020},
+    {DICM_SEQUENCE_START_EVENT, 0},
+    {DICM_ITEM_START_EVENT, 0},
+    {DICM_KEY_EVENT, 0x00100030},
+    {DICM_VALUE_EVENT, 0},
+    {DICM_ITEM_END_EVENT, 0},
+    {DICM_SEQUENCE_END_EVENT, 0},
+    {DICM_KEY_EVENT, 0x0020000d},
+    {DICM_VALUE_EVENT, 0},
+    {DICM_DOCUMENT_END_EVENT, 0}};
+
+/* root level filter on (0008,0016) and (0010,0010) */
+static const uint32_t wanted[] = {0x00080016, 0x00100010};
+static const struct record expected_filter[] = {
+    {DICM_DOCUMENT_START_EVENT, 0}, {DICM_KEY_EVENT, 0x00080016},
+    {DICM_VALUE_EVENT, 0},          {DICM_KEY_EVENT, 0x00100010},
+    {DICM_VALUE_EVENT, 0},          {DICM_DOCUMENT_END_EVENT, 0}};
+
+enum mode { MODE_FULL, MODE_SKIP, MODE_FILTER };
+
+/* parse the whole document, return the number of records or -1 on error */
+static int collect(struct dicm_src *src, int structure, enum mode mode,
+                   struct dicm_index *index, struct record *records) {
+  struct dicm_parser *parser;
+  struct dicm_key key = {0};
+  int n = 0;
+  int done = 0;
+  if (dicm_parser_create(&parser) < 0) {
+    return -1;
+  }
+  if (dicm_parser_set_input(parser, structure, src) < 0) {
+    goto error;
+  }
+  if (index && dicm_parser_set_index(parser, index) < 0) {
+    goto error;
+  }
+  if (mode == MODE_FILTER &&
+      dicm_parser_set_wanted_tags(parser, wanted,
+                                  sizeof wanted / sizeof *wanted) < 0) {
+    goto error;
+  }
+  while (!done && n < MAX_RECORDS) {
+    const int next = dicm_parser_next_event(parser);
+    if (next < 0) {
+      goto error;
+    }
+    struct record *record = &records[n++];
+    record->event = next;
+    record->tag = 0;
+    switch (next) {
+    case DICM_KEY_EVENT:
+      if (dicm_parser_get_key(parser, &key) < 0) {
+        goto error;
+      }
+      record->tag = key.tag;
+      break;
+    case DICM_VALUE_EVENT:
+      if (dicm_parser_skip_value(parser) < 0) {
+        goto error;
+      }
+      break;
+    case DICM_SEQUENCE_START_EVENT:
+      if (mode == MODE_SKIP) {
+        const int res = dicm_parser_skip_sequence(parser);
+        /* only defined length sequences can be skipped */
+        if ((key.tag == 0x00081140) != (res == 0)) {
+          goto error;
+        }
+      }
+      break;
+    default:;
+    }
+    done = next == DICM_DOCUMENT_END_EVENT;
+  }
+  dicm_delete(parser);
+  return n;
+
+error:
+  dicm_delete(parser);
+  return -1;
+}
+
+static int check(const struct writer *w, int structure, enum mode mode,
+                 int stream, const struct record *expected, int nexpected) {
+  struct record records[MAX_RECORDS];
+  struct memstream memstream = {w->buf, w->n, 0};
+  struct dicm_src *src;
+  const int res =
+      stream ? dicm_src_stream_create(&src, &memstream, memstream_read, NULL)
+             : dicm_src_mem_create(&src, w->buf, w->n);
+  if (res < 0) {
+    return -1;
+  }
+  const int n = collect(src, structure, mode, NULL, records);
+  dicm_delete(src);
+  if (n != nexpected) {
+    return -1;
+  }
+  for (int i = 0; i < n; ++i) {
+    if (expected[i].event != records[i].event ||
+        expected[i].tag != records[i].tag) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/* value of a data element located through the offset index */
+static int check_value(const struct writer *w, const struct dicm_index *index,
+                       const uint32_t *path, size_t len, const char *value) {
+  struct dicm_index_entry entry;
+  if (dicm_index_find(index, path, len, &entry) < 0) {
+    return -1;
+  }
+  const size_t vl = strlen(value);
+  const size_t key_size = entry.value_offset - entry.key_offset;
+  if (entry.vl != vl || entry.value_offset + vl > w->n ||
+      (key_size != 8 && key_size != 12)) {
+    return -1;
+  }
+  return memcmp(w->buf + entry.value_offset, value, vl) == 0 ? 0 : -1;
+}
+
+static int check_entries(const struct writer *w, const struct dicm_index *index,
+                         size_t nkeys) {
+  static const uint32_t first[] = {0x00081140, 0, 0x00081155};
+  static const uint32_t second[] = {0x00081140, 1, 0x00081150};
+  static const uint32_t nested[] = {0x00100020, 0, 0x00100030};
+  static const uint32_t root[] = {0x00100010};
+  static const uint32_t missing[] = {0x00081140, 3, 0x00081150};
+  struct dicm_index_entry entry;
+  size_t count;
+  /* one entry per data element */
+  if (dicm_index_get_count(index, &count) < 0 || count != nkeys) {
+    return -1;
+  }
+  if (check_value(w, index, first, 3, "1.30") < 0 ||
+      check_value(w, index, second, 3, "1.20") < 0 ||
+      check_value(w, index, nested, 3, "20230101") < 0 ||
+      check_value(w, index, root, 1, "A^B ") < 0 ||
+      dicm_index_find(index, missing, 3, &entry) == 0) {
+    return -1;
+  }
+  return 0;
+}
+
+/* sidecar identity: same bytes, last byte changed, one byte shorter */
+static int check_source(const struct writer *w,
+                        const struct dicm_index *index) {
+  static unsigned char copy[BUFFER_SIZE];
+  struct dicm_src *src;
+  memcpy(copy, w->buf, w->n);
+  copy[w->n - 1] ^= 0xff;
+  const struct {
+    const unsigned char *ptr;
+    size_t size;
+    int expected;
+  } cases[] = {{w->buf, w->n, 0}, {copy, w->n, -1}, {w->buf, w->n - 1, -1}};
+  for (size_t i = 0; i < sizeof cases / sizeof *cases; ++i) {
+    if (dicm_src_mem_create(&src, cases[i].ptr, cases[i].size) < 0) {
+      return -1;
+    }
+    const int ret = dicm_index_check_source(index, src);
+    dicm_delete(src);
+    if (ret != cases[i].expected) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+static int check_index(const struct writer *w, int structure) {
+  static uint64_t image[BUFFER_SIZE];
+  struct record records[MAX_RECORDS];
+  struct dicm_index *index, *loaded;
+  struct dicm_src *src;
+  struct dicm_dst *dst;
+  size_t nkeys = 0;
+  int ret = -1;
+  if (dicm_index_create(&index) < 0) {
+    return -1;
+  }
+  if (dicm_src_mem_create(&src, w->buf, w->n) < 0) {
+    goto end;
+  }
+  const int n = collect(src, structure, MODE_FULL, index, records);
+  const int identity = dicm_index_set_source(index, src);
+  dicm_delete(src);
+  for (int i = 0; i < n; ++i) {
+    nkeys += records[i].event == DICM_KEY_EVENT;
+  }
+  if (n < 0 || identity < 0 || check_entries(w, index, nkeys) < 0) {
+    goto end;
+  }
+
+  /* sidecar image round trip */
+  if (dicm_dst_mem_create(&dst, image, sizeof image) < 0) {
+    goto end;
+  }
+  const int res = dicm_index_write(index, dst);
+  dicm_delete(dst);
+  if (res < 0 || dicm_index_load(&loaded, image, sizeof image, 1) < 0) {
+    goto end;
+  }
+  const int loaded_res =
+      check_entries(w, loaded, nkeys) < 0 ? -1 : check_source(w, loaded);
+  dicm_delete(loaded);
+  if (loaded_res < 0) {
+    goto end;
+  }
+  /* checksum mismatch is only detected on request */
+  unsigned char *payload = (unsigned char *)image + 56; /* past header */
+  payload[0] ^= 0xff;
+  if (dicm_index_load(&loaded, image, sizeof image, 1) == 0) {
+    dicm_delete(loaded);
+    goto end;
+  }
+  if (dicm_index_load(&loaded, image, sizeof image, 0) < 0) {
+    goto end;
+  }
+  dicm_delete(loaded);
+  ret = 0;
+
+end:
+  dicm_delete(index);
+  return ret;
+}
+
+#define CHECK(w, structure, mode, stream, expected)                            \
+  check((w), (structure), (mode), (stream), (expected),                        \
+        sizeof(expected) / sizeof(*(expected)))
+
+int sequences(int argc, char *argv[]) {
+  if (argc < 2)
+    return EXIT_FAILURE;
+  static struct writer w;
+  const int structure = get_structure(argv[1]);
+  if (structure < 0)
+    return EXIT_FAILURE;
+  w.big_endian = structure == DICM_STRUCTURE_EXPLICIT_BE;
+  w.explicit_vr = structure != DICM_STRUCTURE_IMPLICIT;
+  build(&w);
+
+  if (check_index(&w, structure) < 0) {
+    fprintf(stderr, "sequences: offset index mismatch\n");
+    return EXIT_FAILURE;
+  }
+  for (int stream = 0; stream < 2; ++stream) {
+    if (CHECK(&w, structure, MODE_FULL, stream, expected_full) < 0) {
+      fprintf(stderr, "sequences: full parse mismatch\n");
+      return EXIT_FAILURE;
+    }
+    if (CHECK(&w, structure, MODE_SKIP, stream, expected_skip) < 0) {
+      fprintf(stderr, "sequences: skip sequence mismatch\n");
+      return EXIT_FAILURE;
+    }
+    if (CHECK(&w, structure, MODE_FILTER, stream, expected_filter) < 0) {
+      fprintf(stderr, "sequences: filter mismatch\n");
+      return EXIT_FAILURE;
+    }
+  }
+  return EXIT_SUCCESS;
+}
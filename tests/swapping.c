@@ -0,0 +1,145 @@
+#include "common.h"
+
+#include <stdio.h>  /* FILE* */
+#include <stdlib.h> /* EXIT_SUCCESS */
+#include <string.h> /* memcmp, memcpy, memset */
+
+enum { CHUNK_SIZE = 3, MAX_VALUE = 1 << 20 };
+
+/* size of the numbers of a VR, 1 for bytes and strings */
+static size_t get_number_size(const char vr[2]) {
+  static const char *const sizes[] = {"ATOWSSUS", "FLOFOLSLUL", "FDODOVSVUV"};
+  for (size_t i = 0; i < sizeof sizes / sizeof *sizes; ++i) {
+    for (const char *s = sizes[i]; *s; s += 2) {
+      if (memcmp(s, vr, 2) == 0) {
+        return (size_t)2 << i;
+      }
+    }
+  }
+  return 1;
+}
+
+/* raw value converted to host byte order */
+static void to_host(unsigned char *buf, size_t len, size_t size,
+                    int big_endian) {
+  const int host_big_endian = __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;
+  if (big_endian == host_big_endian || len % size != 0) {
+    return;
+  }
+  for (size_t i = 0; i < len; i += size) {
+    for (size_t j = 0; j < size / 2; ++j) {
+      const unsigned char c = buf[i + j];
+      buf[i + j] = buf[i + size - 1 - j];
+      buf[i + size - 1 - j] = c;
+    }
+  }
+}
+
+/* read a value in chunks of at most chunk bytes */
+static int read_value(struct dicm_parser *parser, unsigned char *buf,
+                      size_t len, size_t chunk) {
+  /* the parser wants aligned buffers */
+  static uint64_t tmp[MAX_VALUE / 8];
+  for (size_t pos = 0; pos < len; pos += chunk) {
+    const size_t n = len - pos < chunk ? len - pos : chunk;
+    if (dicm_parser_read_bytes(parser, tmp, n) < 0) {
+      return -1;
+    }
+    memcpy(buf + pos, tmp, n);
+  }
+  return 0;
+}
+
+/* compare values read in host order in chunks with raw values converted by
+ * hand, both parsers run side by side */
+static int check(const unsigned char *ptr, size_t size, int structure,
+                 size_t chunk) {
+  static unsigned char raw[MAX_VALUE], host[MAX_VALUE];
+  struct dicm_src *src1 = NULL, *src2 = NULL;
+  struct dicm_parser *parser1 = NULL, *parser2 = NULL;
+  struct dicm_key key;
+  char vr[2] = {0};
+  uint32_t len;
+  int ret = -1;
+  int done = 0;
+  if (dicm_src_mem_create(&src1, ptr, size) < 0 ||
+      dicm_src_mem_create(&src2, ptr, size) < 0 ||
+      dicm_parser_create(&parser1) < 0 || dicm_parser_create(&parser2) < 0) {
+    goto end;
+  }
+  if (dicm_parser_set_input(parser1, structure, src1) < 0 ||
+      dicm_parser_set_input(parser2, structure, src2) < 0 ||
+      dicm_parser_set_host_byte_order(parser2, 1) < 0) {
+    goto end;
+  }
+  while (!done) {
+    const int next = dicm_parser_next_event(parser1);
+    if (next < 0 || dicm_parser_next_event(parser2) != next) {
+      goto end;
+    }
+    switch (next) {
+    case DICM_KEY_EVENT:
+      if (dicm_parser_get_key(parser1, &key) < 0) {
+        goto end;
+      }
+      memcpy(vr, &key.vr, 2);
+      break;
+    case DICM_VALUE_EVENT:
+      if (dicm_parser_get_size(parser1, &len) < 0 || len > MAX_VALUE ||
+          read_value(parser1, raw, len, len) < 0 ||
+          read_value(parser2, host, len, chunk) < 0) {
+        goto end;
+      }
+      to_host(raw, len, get_number_size(vr),
+              structure == DICM_STRUCTURE_EXPLICIT_BE);
+      if (memcmp(raw, host, len) != 0) {
+        goto end;
+      }
+      /* fragments have no key */
+      memset(vr, 0, sizeof vr);
+      break;
+    default:;
+    }
+    done = next == DICM_DOCUMENT_END_EVENT;
+  }
+  ret = 0;
+
+end:
+  dicm_delete(parser1);
+  dicm_delete(parser2);
+  dicm_delete(src1);
+  dicm_delete(src2);
+  return ret;
+}
+
+int swapping(int argc, char *argv[]) {
+  if (argc < 3)
+    return EXIT_FAILURE;
+  const int structure = get_structure(argv[1]);
+  const char *infilename = argv[2];
+  FILE *in = fopen(infilename, "rb");
+  if (!in || structure < 0) {
+    return EXIT_FAILURE;
+  }
+  int ret = EXIT_FAILURE;
+  unsigned char *buf = NULL;
+  fseek(in, 0, SEEK_END);
+  const long size = ftell(in);
+  rewind(in);
+  buf = malloc(size + 1);
+  if (!buf || fread(buf, 1, size, in) != (size_t)size) {
+    goto end;
+  }
+  /* whole values, then numbers split across calls */
+  if (check(buf, size, structure, MAX_VALUE) < 0 ||
+      check(buf, size, structure, CHUNK_SIZE) < 0) {
+    fprintf(stderr, "swapping: mismatch\n");
+    goto end;
+  }
+  ret = EXIT_SUCCESS;
+
+end:
+  free(buf);
+  fclose(in);
+  return ret;
+}